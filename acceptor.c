@@ -0,0 +1,407 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            acceptor.c
+--
+-- PROGRAM:                server.out
+--
+-- FUNCTIONS:
+--                         void createAcceptor(struct acceptor *acc, const int listenSocket, const int nWorkers,
+--                                             const int socketLimit)
+--                         void startAcceptor(struct acceptor *acc)
+--                         void *acceptorLoop(void *args)
+--                         struct handoff_queue *leastLoadedQueue(struct acceptor *acc)
+--                         bool handOffSocket(struct handoff_queue *queue, const int sock)
+--                         void clearHandoffWake(struct handoff_queue *queue)
+--                         bool takeHandedOffSocket(struct handoff_queue *queue, int *sock)
+--                         void stopAcceptor(struct acceptor *acc, const int action)
+--                         void destroyAcceptor(struct acceptor *acc)
+--
+-- DATE:                   Oct 18, 2026
+--
+-- REVISIONS:              Oct 18, 2026 - Accept every socket without blocking.
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- The acceptor thread of select and poll mode and the queues it hands connections to the workers by.
+--
+-- A single acceptor thread blocks in accept and hands each new socket to the worker with the fewest
+-- clients through a small single producer, single consumer ring, then wakes the worker with its
+-- eventfd. The workers only see the queue of their own, the backends keep the clients themselves.
+-- Every socket is accepted non-blocking, the workers read what is there and wait for writes.
+---------------------------------------------------------------------------------------*/
+#define _REENTRANT
+#define DCE_COMPAT
+
+#include "acceptor.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "control.h"
+#include "metrics.h"
+#include "stats.h"
+#include "tools.h"
+#include "net.h"
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                createAcceptor
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void createAcceptor(struct acceptor *acc, const int listenSocket, const int nWorkers,
+--                                              const int socketLimit)
+--                              struct acceptor *acc: The acceptor to set up.
+--                              const int listenSocket: The listening socket.
+--                              const int nWorkers: The number of workers to hand connections to.
+--                              const int socketLimit: Sockets at or above it are refused, 0 for no limit.
+--
+-- NOTES:
+-- Creates an empty queue and the eventfd of each worker, which the workers must watch before the
+-- acceptor is started. Bounds the accepts, so that the acceptor can stop between two of them when
+-- the server drains.
+--------------------------------------------------------------------------------------------------*/
+void createAcceptor(struct acceptor *acc, const int listenSocket, const int nWorkers, const int socketLimit)
+{
+    acc->listenSocket = listenSocket;
+    acc->socketLimit = socketLimit;
+    acc->nWorkers = nWorkers;
+
+    if ((acc->queues = calloc(nWorkers, sizeof(struct handoff_queue))) == NULL)
+    {
+        systemFatal("calloc");
+    }
+
+    for (int i = 0; i < nWorkers; i++)
+    {
+        if ((acc->queues[i].wakeFd = eventfd(0, EFD_NONBLOCK)) == -1)
+        {
+            systemFatal("eventfd");
+        }
+    }
+
+    if (!setSocketTimeout(0, ACCEPTOR_WAIT_MS * 1000, listenSocket))
+    {
+        systemFatal("setSocketTimeout");
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                startAcceptor
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void startAcceptor(struct acceptor *acc)
+--                              struct acceptor *acc: The acceptor to start.
+--
+-- NOTES:
+-- Spawns the acceptor thread.
+--------------------------------------------------------------------------------------------------*/
+void startAcceptor(struct acceptor *acc)
+{
+    if (pthread_create(&acc->thread, NULL, acceptorLoop, (void *)acc))
+    {
+        systemFatal("pthread_create");
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                acceptorLoop
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void *acceptorLoop(void *args)
+--                              void *args: An acceptor struct.
+--
+-- RETURNS:                 NULL - unused.
+--
+-- NOTES:
+-- The main function of the acceptor thread. Blocks on accept and hands every new connection to the
+-- least loaded worker, waiting for the workers when all of their queues are full. Sockets past the
+-- limit are closed. The time from accepting a connection to having handed it off is recorded in the
+-- acceptor's metrics. Returns once the server drains, accept times out often enough to notice.
+--------------------------------------------------------------------------------------------------*/
+void *acceptorLoop(void *args)
+{
+    struct acceptor *acc = (struct acceptor *)args;
+
+    while (!serverDraining())
+    {
+        int newSocket = -1;
+        struct sockaddr_in newClient;
+        uint64_t start;
+
+        if (!acceptNewConnection(acc->listenSocket, &newSocket, &newClient, SOCK_NONBLOCK | SOCK_CLOEXEC))
+        {
+            if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                perror("acceptNewConnection");
+                statsAdd(STAT_ERRORS, 1);
+            }
+            continue;
+        }
+        start = metricsNow();
+
+        if (acc->socketLimit && newSocket >= acc->socketLimit)
+        {
+            fprintf(stderr, "Too many clients, cannot accept\n");
+            statsAdd(STAT_ERRORS, 1);
+            close(newSocket);
+            continue;
+        }
+
+        // every queue is full, let the workers catch up while the backlog holds the next connects
+        while (!handOffSocket(leastLoadedQueue(acc), newSocket))
+        {
+            statsAdd(STAT_EAGAINS, 1);
+            usleep(100);
+        }
+
+        metricsRecord(METRIC_ACCEPT, metricsNow() - start);
+    }
+
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                leastLoadedQueue
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               struct handoff_queue *leastLoadedQueue(struct acceptor *acc)
+--                              struct acceptor *acc: The acceptor.
+--
+-- RETURNS:                 The queue of the worker with the fewest clients.
+--
+-- NOTES:
+-- Counts the connections that were handed to a worker but not yet adopted as its clients, so that a
+-- burst of connects is spread out before the workers get to run.
+--------------------------------------------------------------------------------------------------*/
+struct handoff_queue *leastLoadedQueue(struct acceptor *acc)
+{
+    struct handoff_queue *best = NULL;
+    unsigned int bestLoad = 0;
+
+    for (int i = 0; i < acc->nWorkers; i++)
+    {
+        struct handoff_queue *queue = acc->queues + i;
+        unsigned int load = __atomic_load_n(&queue->clientCount, __ATOMIC_RELAXED)
+                            + (queue->tail - __atomic_load_n(&queue->head, __ATOMIC_RELAXED));
+
+        if (best == NULL || load < bestLoad)
+        {
+            best = queue;
+            bestLoad = load;
+        }
+    }
+
+    return best;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                handOffSocket
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool handOffSocket(struct handoff_queue *queue, const int sock)
+--                              struct handoff_queue *queue: The queue of the worker to give the socket to.
+--                              const int sock: The new socket.
+--
+-- RETURNS:                 True if the socket was queued, false if the queue is full.
+--
+-- NOTES:
+-- Queues the socket for the worker and wakes it. Only the acceptor writes the tail of the queue and
+-- only the worker writes the head, so the release on the tail is all the worker needs to see the
+-- socket.
+--------------------------------------------------------------------------------------------------*/
+bool handOffSocket(struct handoff_queue *queue, const int sock)
+{
+    uint64_t wake = 1;
+    unsigned int tail = queue->tail;
+
+    if (tail - __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) == ACCEPTOR_HANDOFF_SIZE)
+    {
+        return false;
+    }
+
+    queue->sockets[tail & (ACCEPTOR_HANDOFF_SIZE - 1)] = sock;
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+
+    if (write(queue->wakeFd, &wake, sizeof(wake)) == -1 && errno != EAGAIN)
+    {
+        perror("write");
+    }
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                clearHandoffWake
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void clearHandoffWake(struct handoff_queue *queue)
+--                              struct handoff_queue *queue: The queue of the worker.
+--
+-- NOTES:
+-- Clears the eventfd of the worker. Must be called before the queue is emptied, so that a socket
+-- queued meanwhile wakes the worker again.
+--------------------------------------------------------------------------------------------------*/
+void clearHandoffWake(struct handoff_queue *queue)
+{
+    uint64_t wakes;
+
+    if (read(queue->wakeFd, &wakes, sizeof(wakes)) == -1 && errno != EAGAIN)
+    {
+        perror("read");
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                takeHandedOffSocket
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool takeHandedOffSocket(struct handoff_queue *queue, int *sock)
+--                              struct handoff_queue *queue: The queue of the worker.
+--                              int *sock: Set to the oldest socket in the queue.
+--
+-- RETURNS:                 True if a socket was taken, false if the queue is empty.
+--
+-- NOTES:
+-- Only called by the worker the queue belongs to.
+--------------------------------------------------------------------------------------------------*/
+bool takeHandedOffSocket(struct handoff_queue *queue, int *sock)
+{
+    unsigned int head = queue->head;
+
+    if (head == __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE))
+    {
+        return false;
+    }
+
+    *sock = queue->sockets[head & (ACCEPTOR_HANDOFF_SIZE - 1)];
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                stopAcceptor
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void stopAcceptor(struct acceptor *acc, const int action)
+--                              struct acceptor *acc: The acceptor.
+--                              const int action: CONTROL_STOP or CONTROL_DRAIN.
+--
+-- NOTES:
+-- Stopping cancels the acceptor, the backend cancels its workers after it. Draining waits for the
+-- acceptor to notice, at the latest when its accept times out, and then wakes every worker with its
+-- queue marked draining to adopt what the acceptor queued last and finish up.
+--------------------------------------------------------------------------------------------------*/
+void stopAcceptor(struct acceptor *acc, const int action)
+{
+    uint64_t wake = 1;
+
+    // a connection accepted as the acceptor is cancelled is lost, so a drain lets it return instead
+    if (action == CONTROL_STOP)
+    {
+        pthread_cancel(acc->thread);
+    }
+    pthread_join(acc->thread, NULL);
+
+    if (action == CONTROL_STOP)
+    {
+        return;
+    }
+
+    for (int i = 0; i < acc->nWorkers; i++)
+    {
+        __atomic_store_n(&acc->queues[i].draining, true, __ATOMIC_RELEASE);
+        if (write(acc->queues[i].wakeFd, &wake, sizeof(wake)) == -1 && errno != EAGAIN)
+        {
+            perror("write");
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                destroyAcceptor
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void destroyAcceptor(struct acceptor *acc)
+--                              struct acceptor *acc: A stopped acceptor.
+--
+-- NOTES:
+-- Closes the eventfds and frees the queues. The workers must have exited.
+--------------------------------------------------------------------------------------------------*/
+void destroyAcceptor(struct acceptor *acc)
+{
+    for (int i = 0; i < acc->nWorkers; i++)
+    {
+        close(acc->queues[i].wakeFd);
+    }
+
+    free(acc->queues);
+}
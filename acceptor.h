@@ -0,0 +1,45 @@
+#ifndef ACCEPTOR_H
+#define ACCEPTOR_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+// must be a power of two
+#define ACCEPTOR_HANDOFF_SIZE 256
+
+// how often an acceptor blocked in accept checks whether the server drains
+#define ACCEPTOR_WAIT_MS 100
+
+// the sockets handed to one worker, only the acceptor writes tail and only the worker writes head
+struct handoff_queue
+{
+    int wakeFd;
+    bool draining;
+    // written by the worker, read by the acceptor to find the least loaded worker
+    int clientCount;
+    unsigned int head;
+    unsigned int tail;
+    int sockets[ACCEPTOR_HANDOFF_SIZE];
+};
+
+struct acceptor
+{
+    pthread_t thread;
+    int listenSocket;
+    // sockets at or above it are refused, 0 for no limit
+    int socketLimit;
+    int nWorkers;
+    struct handoff_queue *queues;
+};
+
+void createAcceptor(struct acceptor *acc, const int listenSocket, const int nWorkers, const int socketLimit);
+void startAcceptor(struct acceptor *acc);
+void *acceptorLoop(void *args);
+struct handoff_queue *leastLoadedQueue(struct acceptor *acc);
+bool handOffSocket(struct handoff_queue *queue, const int sock);
+void clearHandoffWake(struct handoff_queue *queue);
+bool takeHandedOffSocket(struct handoff_queue *queue, int *sock);
+void stopAcceptor(struct acceptor *acc, const int action);
+void destroyAcceptor(struct acceptor *acc);
+
+#endif // ACCEPTOR_H
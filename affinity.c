@@ -0,0 +1,281 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            affinity.c
+--
+-- PROGRAM:                server.out
+--
+-- FUNCTIONS:
+--                         int *assignWorkerCpus(const char *list, int *workers, int *cpuCount)
+--                         bool parseCpuList(const char *list, cpu_set_t *cpus)
+--                         bool pinWorker(const int cpu)
+--                         int cpuNode(const int cpu)
+--
+-- DATE:                   Oct 17, 2026
+--
+-- REVISIONS:              N/A
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- Placement of the workers on cpus and of their memory on numa nodes.
+--
+-- Every worker is given one cpu before it starts and pins itself to it as the first thing it does.
+-- It then prefers the memory of the numa node of that cpu, so everything it allocates or first
+-- touches afterwards, its epoll set, its buffers, its pool slabs and its stats slot, is placed on
+-- the node it runs on instead of wherever the scheduler happened to run it first. The policy is only
+-- a preference, a full node still falls back to the others.
+---------------------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+
+#include "affinity.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                assignWorkerCpus
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int *assignWorkerCpus(const char *list, int *workers, int *cpuCount)
+--                              const char *list: The cpus to run on, as for taskset -c. NULL for
+--                                                the cpus the server was started on.
+--                              int *workers: The number of workers, 0 for one per cpu. Set to the
+--                                            number picked.
+--                              int *cpuCount: Set to the number of cpus in the list.
+--
+-- RETURNS:                 The cpu of each worker, to be freed by the caller. NULL with errno set
+--                          to EINVAL if the list names no valid cpu.
+--
+-- NOTES:
+-- Hands out the cpus in ascending order, wrapping around when there are more workers than cpus.
+-- Without a list the affinity mask of the process is used, so a server started under taskset keeps
+-- to the cpus it was given.
+--------------------------------------------------------------------------------------------------*/
+int *assignWorkerCpus(const char *list, int *workers, int *cpuCount)
+{
+    cpu_set_t cpus;
+    int *workerCpus;
+    int cpu = -1;
+
+    if (list != NULL)
+    {
+        if (!parseCpuList(list, &cpus))
+        {
+            errno = EINVAL;
+            return NULL;
+        }
+    }
+    else if (sched_getaffinity(0, sizeof(cpu_set_t), &cpus) == -1)
+    {
+        return NULL;
+    }
+
+    if ((*cpuCount = CPU_COUNT(&cpus)) == 0)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (*workers == 0)
+    {
+        *workers = *cpuCount;
+    }
+
+    if ((workerCpus = malloc(*workers * sizeof(int))) == NULL)
+    {
+        return NULL;
+    }
+
+    for (int i = 0; i < *workers; i++)
+    {
+        do
+        {
+            cpu = (cpu + 1) % CPU_SETSIZE;
+        } while (!CPU_ISSET(cpu, &cpus));
+
+        workerCpus[i] = cpu;
+    }
+
+    return workerCpus;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                parseCpuList
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool parseCpuList(const char *list, cpu_set_t *cpus)
+--                              const char *list: Comma separated cpus and ranges, like 0-3,8.
+--                              cpu_set_t *cpus: The set to fill.
+--
+-- RETURNS:                 True if the list was valid and named at least one cpu, false otherwise.
+--------------------------------------------------------------------------------------------------*/
+bool parseCpuList(const char *list, cpu_set_t *cpus)
+{
+    const char *p = list;
+
+    CPU_ZERO(cpus);
+
+    while (*p)
+    {
+        char *end;
+        long first;
+        long last;
+
+        first = strtol(p, &end, 10);
+        if (end == p)
+        {
+            return false;
+        }
+
+        last = first;
+        if (*end == '-')
+        {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p)
+            {
+                return false;
+            }
+        }
+
+        if (first < 0 || last < first || last >= CPU_SETSIZE)
+        {
+            return false;
+        }
+
+        for (long cpu = first; cpu <= last; cpu++)
+        {
+            CPU_SET(cpu, cpus);
+        }
+
+        if (*end == ',')
+        {
+            end++;
+        }
+        else if (*end)
+        {
+            return false;
+        }
+        p = end;
+    }
+
+    return CPU_COUNT(cpus) > 0;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                pinWorker
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool pinWorker(const int cpu)
+--                              const int cpu: The cpu of the worker.
+--
+-- RETURNS:                 True if the calling thread was pinned, false otherwise.
+--
+-- NOTES:
+-- Pins the calling thread to cpu and makes it prefer the memory of the node of cpu. Must run before
+-- the thread allocates anything it wants to have local. On a machine without numa information only
+-- the pinning is done.
+--------------------------------------------------------------------------------------------------*/
+bool pinWorker(const int cpu)
+{
+    cpu_set_t cpus;
+    unsigned long nodes[AFFINITY_MAX_NODES / (8 * sizeof(unsigned long))];
+    int node;
+
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus))
+    {
+        return false;
+    }
+
+    if ((node = cpuNode(cpu)) == -1 || node >= AFFINITY_MAX_NODES)
+    {
+        return true;
+    }
+
+    memset(nodes, 0, sizeof(nodes));
+    nodes[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+
+    // the kernel reads one bit less than maxnode
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodes, AFFINITY_MAX_NODES + 1) == -1)
+    {
+        perror("set_mempolicy");
+    }
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                cpuNode
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int cpuNode(const int cpu)
+--                              const int cpu: The cpu to look up.
+--
+-- RETURNS:                 The numa node of cpu, -1 if it is not known.
+--
+-- NOTES:
+-- Sysfs links every cpu to its node as a nodeN entry of the directory of the cpu.
+--------------------------------------------------------------------------------------------------*/
+int cpuNode(const int cpu)
+{
+    char path[64];
+    DIR *dir;
+    struct dirent *entry;
+    int node = -1;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    if ((dir = opendir(path)) == NULL)
+    {
+        return -1;
+    }
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (sscanf(entry->d_name, "node%d", &node) == 1)
+        {
+            break;
+        }
+        node = -1;
+    }
+
+    closedir(dir);
+    return node;
+}
@@ -0,0 +1,15 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <sched.h>
+#include <stdbool.h>
+
+// the most numa nodes a memory policy can name
+#define AFFINITY_MAX_NODES 1024
+
+int *assignWorkerCpus(const char *list, int *workers, int *cpuCount);
+bool parseCpuList(const char *list, cpu_set_t *cpus);
+bool pinWorker(const int cpu);
+int cpuNode(const int cpu);
+
+#endif // AFFINITY_H
@@ -0,0 +1,447 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            bufpool.c
+--
+-- PROGRAM:                server.out
+--
+-- FUNCTIONS:
+--                         void startBufferPool(const size_t budget, const bool hugePages)
+--                         char *poolAcquire(const size_t size, size_t *capacity)
+--                         void poolRelease(char *buffer, const size_t capacity)
+--                         bool poolOverBudget()
+--                         size_t poolAttached()
+--                         int poolClass(const size_t size)
+--                         bool poolMapSlab(const int cls)
+--                         char *poolMapLarge(const size_t size, size_t *capacity)
+--                         void poolCharge(const size_t capacity)
+--                         void poolUncharge(const size_t capacity)
+--                         void poolSettle()
+--
+-- DATE:                   Oct 17, 2026
+--
+-- REVISIONS:              Oct 18, 2026 - Map buffers larger than the largest class on their own.
+--                         Oct 18, 2026 - Charge the budget a slab at a time.
+--                         Oct 18, 2026 - Keep at most a buffer charged past what is held, settle when idle.
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- A per thread slab pool of fixed size buffers for the data connections hold on to.
+--
+-- A connection only holds a buffer while it has data it could not write yet and gives it back as
+-- soon as it is flushed, so the memory of the server follows the traffic that is backed up rather
+-- than the number of connections. Every worker has its own free list per size class and never
+-- locks. Slabs are mapped for one class at a time, backed by huge pages if asked for, and buffers
+-- are cut from the slab only when the free list is empty, so no page is touched before it is used. Once a class has POOL_WARM_BUFFERS free buffers, the pages of any further buffer returned
+-- to it are handed back to the kernel with MADV_DONTNEED, which keeps the buffer but not its memory.
+--
+-- A buffer larger than the largest class is mapped on its own, rounded up to a power of two so that
+-- a connection whose output keeps growing moves it a few times only, and is unmapped once it is
+-- released. Those are rare, a connection only needs one while it has more than POOL_MAX_BUFFER
+-- waiting, so they are not worth keeping around.
+--
+-- The bytes held by connections across all workers are counted against a global budget. Every worker
+-- counts what its own connections hold and charges the global count with what it holds, but keeps
+-- the charge of the last buffer it gave back, so a connection that takes and returns the same buffer
+-- over and over never touches a cache line shared with the other workers. A worker settles its
+-- charge to exactly what it holds before it waits for events. The budget is soft: a connection over
+-- it stops reading once it has output pending, but what it has already read is always queued, so the
+-- budget can be exceeded by a read per connection, and it is reached early by up to a buffer of the
+-- largest class per busy worker.
+---------------------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+
+#include "bufpool.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static size_t poolBudget = 0;
+static bool poolHugePages = false;
+static size_t chargedBytes = 0;
+static __thread struct buffer_pool localPool;
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                startBufferPool
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void startBufferPool(const size_t budget, const bool hugePages)
+--                              const size_t budget: The most bytes connections may hold, 0 for no limit.
+--                              const bool hugePages: Whether to back the slabs with huge pages.
+--
+-- NOTES:
+-- Configures the pools. Must be called before any worker starts.
+--------------------------------------------------------------------------------------------------*/
+void startBufferPool(const size_t budget, const bool hugePages)
+{
+    poolBudget = budget;
+    poolHugePages = hugePages;
+    chargedBytes = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                poolAcquire
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Map a buffer of its own for sizes past the largest class.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               char *poolAcquire(const size_t size, size_t *capacity)
+--                              const size_t size: The number of bytes needed.
+--                              size_t *capacity: Set to the size of the buffer returned.
+--
+-- RETURNS:                 A buffer of at least size bytes, NULL if no memory could be mapped for it.
+--
+-- NOTES:
+-- Takes a buffer of the smallest class that fits from the pool of the calling thread, from the free
+-- list if it has one and from the unused part of the slab otherwise, and counts it against the budget.
+-- Larger buffers are mapped by poolMapLarge.
+--------------------------------------------------------------------------------------------------*/
+char *poolAcquire(const size_t size, size_t *capacity)
+{
+    int cls = poolClass(size);
+    char *buffer;
+
+    if (cls < 0)
+    {
+        if ((buffer = poolMapLarge(size, capacity)) != NULL)
+        {
+            poolCharge(*capacity);
+        }
+        return buffer;
+    }
+
+    *capacity = (size_t)1 << (POOL_MIN_SHIFT + cls * POOL_CLASS_SHIFT);
+
+    if (localPool.free[cls] != NULL)
+    {
+        buffer = (char *)localPool.free[cls];
+        localPool.free[cls] = localPool.free[cls]->next;
+        localPool.freeCount[cls]--;
+    }
+    else if (localPool.unused[cls] != localPool.slabEnd[cls] || poolMapSlab(cls))
+    {
+        buffer = localPool.unused[cls];
+        localPool.unused[cls] += *capacity;
+    }
+    else
+    {
+        return NULL;
+    }
+
+    poolCharge(*capacity);
+
+    return buffer;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                poolRelease
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Unmap buffers larger than the largest class.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void poolRelease(char *buffer, const size_t capacity)
+--                              char *buffer: A buffer from poolAcquire of the calling thread.
+--                              const size_t capacity: The capacity poolAcquire returned with it.
+--
+-- NOTES:
+-- Returns a buffer to the pool of the calling thread. Past POOL_WARM_BUFFERS free buffers of the class,
+-- all but the first page of the buffer are given back to the kernel. Huge pages are never split up
+-- that way. A buffer larger than the largest class is unmapped.
+--------------------------------------------------------------------------------------------------*/
+void poolRelease(char *buffer, const size_t capacity)
+{
+    int cls = poolClass(capacity);
+    long page = sysconf(_SC_PAGESIZE);
+    struct pool_buffer *free = (struct pool_buffer *)buffer;
+
+    poolUncharge(capacity);
+
+    if (cls < 0)
+    {
+        munmap(buffer, capacity);
+        return;
+    }
+
+    if (localPool.freeCount[cls] >= POOL_WARM_BUFFERS && !poolHugePages && capacity > (size_t)page)
+    {
+        madvise(buffer + page, capacity - page, MADV_DONTNEED);
+    }
+
+    free->next = localPool.free[cls];
+    localPool.free[cls] = free;
+    localPool.freeCount[cls]++;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                poolOverBudget
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Compare what the workers charged.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool poolOverBudget()
+--
+-- RETURNS:                 True if connections hold more than the budget, false otherwise.
+--------------------------------------------------------------------------------------------------*/
+bool poolOverBudget()
+{
+    return poolBudget > 0 && __atomic_load_n(&chargedBytes, __ATOMIC_RELAXED) >= poolBudget;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                poolAttached
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Return what the workers charged.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               size_t poolAttached()
+--
+-- RETURNS:                 The bytes of buffers held by connections across all workers, plus up to a
+--                          buffer per busy worker.
+--------------------------------------------------------------------------------------------------*/
+size_t poolAttached()
+{
+    return __atomic_load_n(&chargedBytes, __ATOMIC_RELAXED);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                poolClass
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int poolClass(const size_t size)
+--                              const size_t size: The number of bytes needed.
+--
+-- RETURNS:                 The smallest class holding size bytes, -1 if none does.
+--------------------------------------------------------------------------------------------------*/
+int poolClass(const size_t size)
+{
+    for (int cls = 0; cls < POOL_CLASSES; cls++)
+    {
+        if (size <= (size_t)1 << (POOL_MIN_SHIFT + cls * POOL_CLASS_SHIFT))
+        {
+            return cls;
+        }
+    }
+
+    return -1;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                poolMapSlab
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool poolMapSlab(const int cls)
+--                              const int cls: The class to make buffers for.
+--
+-- RETURNS:                 True if a new slab was mapped, false otherwise.
+--
+-- NOTES:
+-- Maps a new slab for the class to cut buffers from. With huge pages a MAP_HUGETLB mapping is tried
+-- first, falling back to asking for transparent huge pages when none are reserved. Slabs are never
+-- unmapped, their buffers are reused instead.
+--------------------------------------------------------------------------------------------------*/
+bool poolMapSlab(const int cls)
+{
+    char *slab = MAP_FAILED;
+
+    if (poolHugePages)
+    {
+        slab = mmap(NULL, POOL_SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+
+    if (slab == MAP_FAILED)
+    {
+        if ((slab = mmap(NULL, POOL_SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0))
+            == MAP_FAILED)
+        {
+            perror("mmap");
+            return false;
+        }
+
+        if (poolHugePages)
+        {
+            madvise(slab, POOL_SLAB_SIZE, MADV_HUGEPAGE);
+        }
+    }
+
+    localPool.unused[cls] = slab;
+    localPool.slabEnd[cls] = slab + POOL_SLAB_SIZE;
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                poolMapLarge
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               char *poolMapLarge(const size_t size, size_t *capacity)
+--                              const size_t size: The number of bytes needed, more than POOL_MAX_BUFFER.
+--                              size_t *capacity: Set to the size of the buffer returned.
+--
+-- RETURNS:                 A buffer of at least size bytes, NULL if it could not be mapped.
+--
+-- NOTES:
+-- Maps a buffer of the smallest power of two that holds size bytes. Only the pages written to are
+-- ever backed, so rounding up costs address space rather than memory.
+--------------------------------------------------------------------------------------------------*/
+char *poolMapLarge(const size_t size, size_t *capacity)
+{
+    char *buffer;
+
+    *capacity = POOL_MAX_BUFFER;
+    while (*capacity < size)
+    {
+        *capacity <<= 1;
+    }
+
+    if ((buffer = mmap(NULL, *capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+    {
+        perror("mmap");
+        return NULL;
+    }
+
+    if (poolHugePages)
+    {
+        madvise(buffer, *capacity, MADV_HUGEPAGE);
+    }
+
+    return buffer;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                poolCharge
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Raise the global count by what is missing only.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void poolCharge(const size_t capacity)
+--                              const size_t capacity: The size of a buffer the calling thread took.
+--
+-- NOTES:
+-- Counts a buffer as held by the calling thread. The global count is only raised once the thread
+-- holds more than it already charged, and then by the difference.
+--------------------------------------------------------------------------------------------------*/
+void poolCharge(const size_t capacity)
+{
+    localPool.attached += capacity;
+
+    if (localPool.attached > localPool.charged)
+    {
+        __atomic_fetch_add(&chargedBytes, localPool.attached - localPool.charged, __ATOMIC_RELAXED);
+        localPool.charged = localPool.attached;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                poolUncharge
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Keep the charge of one buffer of at most the largest class.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void poolUncharge(const size_t capacity)
+--                              const size_t capacity: The size of a buffer the calling thread gave back.
+--
+-- NOTES:
+-- Counts a buffer as no longer held by the calling thread. The thread keeps charged what it holds
+-- plus this buffer, up to POOL_MAX_BUFFER, so a connection that takes and returns the same buffer
+-- over and over never touches the global count, and lowers the global count by anything past that.
+--------------------------------------------------------------------------------------------------*/
+void poolUncharge(const size_t capacity)
+{
+    size_t keep;
+
+    localPool.attached -= capacity;
+    keep = localPool.attached + (capacity < POOL_MAX_BUFFER ? capacity : POOL_MAX_BUFFER);
+
+    if (localPool.charged > keep)
+    {
+        __atomic_fetch_sub(&chargedBytes, localPool.charged - keep, __ATOMIC_RELAXED);
+        localPool.charged = keep;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                poolSettle
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void poolSettle()
+--
+-- NOTES:
+-- Gives back the charge the calling thread kept past what it holds. A worker calls it before it
+-- waits for events, so an idle worker never counts against the budget more than it holds.
+--------------------------------------------------------------------------------------------------*/
+void poolSettle()
+{
+    if (localPool.charged > localPool.attached)
+    {
+        __atomic_fetch_sub(&chargedBytes, localPool.charged - localPool.attached, __ATOMIC_RELAXED);
+        localPool.charged = localPool.attached;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef BUFPOOL_H
+#define BUFPOOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// buffers come in POOL_CLASSES sizes from 4KB up, each POOL_CLASS_SHIFT bits larger than the last,
+// anything larger is mapped on its own
+#define POOL_CLASSES 5
+#define POOL_MIN_SHIFT 12
+#define POOL_CLASS_SHIFT 2
+#define POOL_MAX_BUFFER ((size_t)1 << (POOL_MIN_SHIFT + (POOL_CLASSES - 1) * POOL_CLASS_SHIFT))
+
+// buffers are carved out of slabs the size of a huge page
+#define POOL_SLAB_SIZE (2 * 1024 * 1024)
+
+// free buffers of a class kept resident, the memory of any more is given back to the kernel
+#define POOL_WARM_BUFFERS 16
+
+struct pool_buffer
+{
+    struct pool_buffer *next;
+};
+
+struct buffer_pool
+{
+    struct pool_buffer *free[POOL_CLASSES];
+    int freeCount[POOL_CLASSES];
+    // the part of the newest slab of each class that was never handed out
+    char *unused[POOL_CLASSES];
+    char *slabEnd[POOL_CLASSES];
+    // the bytes of buffers the thread holds, and what it counted against the budget for them
+    size_t attached;
+    size_t charged;
+};
+
+void startBufferPool(const size_t budget, const bool hugePages);
+char *poolAcquire(const size_t size, size_t *capacity);
+void poolRelease(char *buffer, const size_t capacity);
+bool poolOverBudget();
+size_t poolAttached();
+int poolClass(const size_t size);
+bool poolMapSlab(const int cls);
+char *poolMapLarge(const size_t size, size_t *capacity);
+void poolCharge(const size_t capacity);
+void poolUncharge(const size_t capacity);
+void poolSettle();
+
+#endif // BUFPOOL_H
@@ -0,0 +1,59 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SELECT_MODE 1
+#define EPOLL_MODE 2
+#define URING_MODE 3
+#define POLL_MODE 4
+
+// connections an epoll worker accepts in a row before it serves its clients again
+#define ACCEPT_CAP_DEFAULT 64
+
+// seconds an epoll connection may wait for its first data, go without data and fail to write
+#define TIMEOUT_READ_DEFAULT 10
+#define TIMEOUT_IDLE_DEFAULT 60
+#define TIMEOUT_WRITE_DEFAULT 10
+
+// seconds a draining epoll worker lets its connections finish before it closes them
+#define DRAIN_TIMEOUT_DEFAULT 30
+
+struct protocol_handler;
+
+struct server_config
+{
+    int mode;
+    short port;
+    int workers;
+    // the cpu each worker is pinned to
+    int *workerCpus;
+    int bufferLength;
+    int backlog;
+    int acceptCap;
+    int readTimeout;
+    int idleTimeout;
+    int writeTimeout;
+    int drainTimeout;
+    // the unix socket listeners are handed over through on upgrade, NULL for none
+    const char *upgradePath;
+    // the protocol spoken on every connection
+    const struct protocol_handler *handler;
+    // the file the http handler serves, NULL for its own text
+    const char *httpBody;
+    // run every epoll connection on a fiber, with stacks of fiberStack bytes and at most fiberLimit of them
+    bool fibers;
+    int fiberStack;
+    int fiberLimit;
+    bool reusePort;
+    bool steerToCpu;
+    bool splice;
+    int zeroCopyThreshold;
+    size_t memoryBudget;
+    bool hugePages;
+    int logPolicy;
+    int logFormat;
+};
+
+#endif // CONFIG_H
@@ -0,0 +1,1810 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            connection.c
+--
+-- PROGRAM:                server.out
+--
+-- FUNCTIONS:
+--                         bool startConnectionTable()
+--                         void stopConnectionTable()
+--                         struct connection *createConnection(const int fd)
+--                         void destroyConnection(struct connection *conn)
+--                         uint64_t connectionHandle(const struct connection *conn)
+--                         struct connection *lookupConnection(const uint64_t handle)
+--                         size_t localConnectionCount()
+--                         size_t closeLocalConnections(const size_t max, const bool force)
+--                         size_t pendingOutput(const struct connection *conn)
+--                         bool queueOutput(struct connection *conn, const char *data, const size_t len)
+--                         bool queueShared(struct connection *conn, const char *data, const size_t len)
+--                         bool pushPiece(struct connection *conn, const char *shared, const size_t len)
+--                         ssize_t sendPieces(struct connection *conn)
+--                         void skipOutput(struct connection *conn, size_t len)
+--                         bool sendOrQueue(struct connection *conn, const char *data, const size_t len)
+--                         bool flushConnection(struct connection *conn)
+--                         bool readConnection(struct connection *conn, char *buf, const int len)
+--                         bool writeConnection(struct handler_conn *handlerConn, const struct iovec *iov, const int count,
+--                                              const bool more)
+--                         ssize_t receiveOnFiber(struct connection *conn, char *buf, const size_t len)
+--                         ssize_t readOnFiber(struct handler_conn *handlerConn, char *buf, const size_t len)
+--                         bool writeOnFiber(struct handler_conn *handlerConn, const struct iovec *iov, const int count,
+--                                           const bool more)
+--                         bool echoConnection(struct connection *conn, char *buf, const int len)
+--                         bool spliceConnection(struct connection *conn, const int *echoPipe, char *buf, const int len)
+--                         bool takeFromPipe(struct connection *conn, const int pipeOut, char *buf, const int len,
+--                                           size_t count, const bool keep)
+--                         bool sendZeroCopy(struct connection *conn, struct zc_buffer *zc, const size_t len)
+--                         bool trackZeroCopy(struct connection *conn, struct zc_buffer *zc)
+--                         bool completeZeroCopy(struct connection *conn)
+--                         bool lingerZeroCopy(struct connection *conn)
+--                         struct zc_buffer *acquireZeroCopyBuffer(const size_t size)
+--                         void releaseZeroCopyBuffer(struct zc_buffer *zc)
+--
+-- DATE:                   Oct 17, 2026
+--
+-- REVISIONS:              Oct 17, 2026 - Zero copy echo through a pipe.
+--                         Oct 17, 2026 - MSG_ZEROCOPY sends above a threshold.
+--                         Oct 17, 2026 - Pending output in pool buffers held only while pending.
+--                         Oct 17, 2026 - Connections live in a table indexed by fd.
+--                         Oct 17, 2026 - A timeout timer per connection.
+--                         Oct 17, 2026 - A list of the connections of each worker for draining.
+--                         Oct 17, 2026 - Reads go to the protocol handler of the connection.
+--                         Oct 18, 2026 - Reads and writes that block the fiber of the connection.
+--                         Oct 18, 2026 - Keep output the handler shares by reference.
+--                         Oct 18, 2026 - Cap the table whatever the open file limit is.
+--                         Oct 18, 2026 - Keep the socket of a closed connection open until its zero copy
+--                                        sends complete.
+--                         Oct 18, 2026 - Send what a handler wrote before giving its connection up.
+--                         Oct 18, 2026 - Blocking reads for handlers on the fiber of the connection.
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- Per connection state for non-blocking sockets.
+--
+-- The state of every connection lives in one flat table indexed by its fd, so finding the state of a
+-- socket is an index and the slots are never freed. Each slot has a generation that goes up every
+-- time its connection is destroyed. A handle packs the fd and the generation into the 64 bits of
+-- epoll data, so an event for a connection that was closed, even one whose fd was reused since, is
+-- recognised and dropped instead of being applied to the wrong connection. The table is sized to the
+-- open file limit and mapped without touching it, so only slots of fds that were used take memory.
+-- The limit can be unlimited or in the billions, so the table is capped at the most fds the kernel
+-- hands out, fs.nr_open, and at CONNECTION_SLOTS_MAX. A connection whose fd lies past it is closed.
+--
+-- Every connection reads into the buffer of its worker and hands each read to its protocol handler,
+-- see handler.c. The output the handler queued is gathered into one sendmsg, straight from where the
+-- handler keeps it. Only what the socket does not take is copied. A handler that gives its
+-- connection up after writing a last answer leaves it closing: the reading side is shut down and the
+-- connection is only destroyed once that answer is out.
+--
+-- In fiber mode every connection runs on a fiber of its own, see fiber.c, and reads and writes as if
+-- its socket blocked. A read or write that would block yields the fiber back to the worker, which
+-- resumes it once epoll reports the socket ready. A write only returns once all of its output is
+-- sent, so a fiber connection never has pending output and stops reading by itself while the peer
+-- does not read.
+--
+-- Every connection carries the output it could not write yet. Reads always drain the socket
+-- until EAGAIN so that no data is left behind under edge triggered epoll, unless the pending output
+-- grows past CONNECTION_HIGH_WATER. In that case reading stops and readBlocked is set, the caller
+-- waits for the socket to become writable, flushes and then resumes reading. The pending output is
+-- kept in a buffer from the pool of the worker that is returned as soon as it is flushed, and reading
+-- also stops while output is pending and the pool is over its budget.
+--
+-- Output the handler shared with handlerShare is never copied. Once some of it has to wait, the
+-- pending output becomes a queue of pieces, each either the next bytes of the buffer or a pointer
+-- into the shared output, which is flushed with one sendmsg per HANDLER_MAX_SEGMENTS pieces. Shared
+-- output counts towards the high water mark like any other, but takes no buffer.
+--
+-- Every connection embeds the timer of its timeout in the wheel of its worker. The worker arms it,
+-- the connection only has to unlink it when it is destroyed. Every connection is also linked into a
+-- list of the worker that created it, which a draining worker walks to close what it still holds.
+-- Connections are only ever created and destroyed by their own worker.
+--
+-- Every read and write that moves data, every EAGAIN and every error is counted in the stats of the
+-- calling worker, and so is every connection that is destroyed.
+--
+-- Splice and zero copy are ways of echoing in the kernel that no handler could express, so
+-- echoConnection and spliceConnection echo without the handler.
+--
+-- spliceConnection echoes without copying the data into user space. It splices what the socket has
+-- into a pipe of the worker and from there straight back into the socket. The pipe is shared by all
+-- connections of the worker, so it has to be empty again before the next connection uses it. Whatever
+-- the socket would not take is read out of the pipe into the pending output, and from then on the
+-- connection is echoed by copying until its output is flushed, which keeps the echo in order. A
+-- socket that cannot be spliced is echoed by copying for good.
+--
+-- A connection with a zeroCopyThreshold receives into a zc_buffer instead of the worker's buffer and
+-- sends reads of at least that size with MSG_ZEROCOPY. Every such send holds a reference to its
+-- buffer in the inflight queue of the connection until the kernel reports it complete on the error
+-- queue, which completeZeroCopy reads when epoll reports EPOLLERR. Completions arrive in the order of
+-- the sends, so the queue is released from the front. Buffers go back to a small free list of the
+-- worker once their last reference is gone.
+--
+-- The kernel keeps sending from those buffers after the socket is closed, so they must not be reused
+-- before their completions arrive, and those can only be read while the socket is open. A connection
+-- destroyed with sends in flight is shut down instead and lingers: it keeps its fd, its slot and its
+-- place in the list of the worker, and its events only read the error queue, until the last send
+-- completes and it is really closed. TCP_USER_TIMEOUT makes the kernel give up on a peer that stops
+-- taking data, which completes the sends too. A lingering connection that has to go before that, as
+-- when the worker is done draining, leaves its buffers on a quarantine list that is never reused.
+---------------------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+
+#include "connection.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bufpool.h"
+#include "stats.h"
+#include "tools.h"
+
+static struct connection *connections = NULL;
+static size_t connectionSlots = 0;
+static __thread struct zc_buffer *freeBuffers = NULL;
+static __thread int freeBufferCount = 0;
+static __thread struct zc_buffer *quarantinedBuffers = NULL;
+static __thread struct connection *localConnections = NULL;
+static __thread size_t localCount = 0;
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                startConnectionTable
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - At most fs.nr_open and CONNECTION_SLOTS_MAX slots.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool startConnectionTable()
+--
+-- RETURNS:                 True if the table was mapped, false otherwise.
+--
+-- NOTES:
+-- Maps one slot for every fd the process may open, up to the most the kernel gives any process and
+-- CONNECTION_SLOTS_MAX. Must be called before any worker starts.
+--------------------------------------------------------------------------------------------------*/
+bool startConnectionTable()
+{
+    struct rlimit limit;
+    FILE *file;
+    unsigned long nrOpen;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == -1)
+    {
+        return false;
+    }
+
+    connectionSlots = CONNECTION_SLOTS_MAX;
+    if (limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < connectionSlots)
+    {
+        connectionSlots = limit.rlim_cur;
+    }
+    if ((file = fopen("/proc/sys/fs/nr_open", "r")) != NULL)
+    {
+        if (fscanf(file, "%lu", &nrOpen) == 1 && nrOpen > 0 && nrOpen < connectionSlots)
+        {
+            connectionSlots = nrOpen;
+        }
+        fclose(file);
+    }
+
+    connections = mmap(NULL, connectionSlots * sizeof(struct connection), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (connections == MAP_FAILED)
+    {
+        connections = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                stopConnectionTable
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void stopConnectionTable()
+--
+-- NOTES:
+-- Unmaps the table. Must be called once the workers have stopped.
+--------------------------------------------------------------------------------------------------*/
+void stopConnectionTable()
+{
+    if (connections != NULL)
+    {
+        munmap(connections, connectionSlots * sizeof(struct connection));
+        connections = NULL;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                createConnection
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Take the slot of the fd in the table.
+--                          Oct 17, 2026 - Link into the list of the calling worker.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               struct connection *createConnection(const int fd)
+--                              const int fd: The connected socket.
+--
+-- RETURNS:                 The new connection or NULL if the fd is outside of the table.
+--
+-- NOTES:
+-- Creates the state for a newly accepted socket in the slot of its fd, keeping the generation of the
+-- slot, and links it into the connections of the calling worker. No output buffer is allocated until
+-- the first write that cannot complete.
+--------------------------------------------------------------------------------------------------*/
+struct connection *createConnection(const int fd)
+{
+    struct connection *conn;
+    uint32_t generation;
+
+    if (fd < 0 || (size_t)fd >= connectionSlots)
+    {
+        errno = EMFILE;
+        return NULL;
+    }
+
+    conn = connections + fd;
+    generation = conn->generation;
+
+    memset(conn, 0, sizeof(struct connection));
+    conn->fd = fd;
+    conn->generation = generation;
+    conn->inUse = true;
+
+    conn->next = localConnections;
+    if (localConnections != NULL)
+    {
+        localConnections->prev = conn;
+    }
+    localConnections = conn;
+    localCount++;
+
+    return conn;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                destroyConnection
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Release zero copy buffers still in flight.
+--                          Oct 17, 2026 - Retire the slot instead of freeing it.
+--                          Oct 17, 2026 - Cancel the timeout.
+--                          Oct 17, 2026 - Unlink from the list of the worker.
+--                          Oct 17, 2026 - Let the handler free its state.
+--                          Oct 18, 2026 - Give the fiber back to the pool.
+--                          Oct 18, 2026 - Free the queue of pending pieces.
+--                          Oct 18, 2026 - Linger while zero copy sends are in flight, never reuse their
+--                                         buffers before they complete.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void destroyConnection(struct connection *conn)
+--                              struct connection *conn: The connection to destroy.
+--
+-- NOTES:
+-- Lets the handler of the connection free its state, frees any unsent data of the connection, bumps
+-- the generation of its slot so that events still queued for it are dropped and closes the socket.
+-- The socket is closed last since its fd, and with it the slot, may be handed to another worker by
+-- accept the moment it is closed. A connection with zero copy sends in flight lingers instead, see
+-- lingerZeroCopy, and is closed by destroying it again, which quarantines the buffers of whatever
+-- sends are still in flight then. A fiber connection must not be destroyed from its own fiber, as
+-- the fiber is given back to the pool and never resumed again.
+--------------------------------------------------------------------------------------------------*/
+void destroyConnection(struct connection *conn)
+{
+    if (!conn->lingering)
+    {
+        handlerClose(&conn->handlerConn);
+        if (conn->fiber != NULL)
+        {
+            releaseFiber(conn->fiber);
+            conn->fiber = NULL;
+        }
+        statsAdd(STAT_CLOSES, 1);
+        wheelCancel(&conn->timer);
+        free(conn->pieces);
+        if (conn->out != NULL)
+        {
+            poolRelease(conn->out, conn->outCap);
+        }
+        conn->out = NULL;
+        conn->pieces = NULL;
+        conn->outStart = conn->outEnd = 0;
+        conn->pieceCount = 0;
+        conn->sharedPending = 0;
+
+        if (conn->inflightCount > 0 && lingerZeroCopy(conn))
+        {
+            return;
+        }
+    }
+
+    if (conn->prev != NULL)
+    {
+        conn->prev->next = conn->next;
+    }
+    else
+    {
+        localConnections = conn->next;
+    }
+    if (conn->next != NULL)
+    {
+        conn->next->prev = conn->prev;
+    }
+    localCount--;
+
+    // the kernel may still send from these, so they are never handed out again
+    for (size_t i = 0; i < conn->inflightCount; i++)
+    {
+        struct zc_buffer *zc = conn->inflight[(conn->inflightHead + i) % conn->inflightCap];
+
+        if (--zc->refs == 0)
+        {
+            zc->next = quarantinedBuffers;
+            quarantinedBuffers = zc;
+        }
+    }
+    free(conn->inflight);
+    conn->inflight = NULL;
+    conn->inflightCount = 0;
+    conn->lingering = false;
+    conn->inUse = false;
+    conn->generation++;
+    close(conn->fd);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                connectionHandle
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               uint64_t connectionHandle(const struct connection *conn)
+--                              const struct connection *conn: The connection.
+--
+-- RETURNS:                 The generation of the connection in the high and its fd in the low 32 bits.
+--------------------------------------------------------------------------------------------------*/
+uint64_t connectionHandle(const struct connection *conn)
+{
+    return ((uint64_t)conn->generation << 32) | (uint32_t)conn->fd;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                lookupConnection
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               struct connection *lookupConnection(const uint64_t handle)
+--                              const uint64_t handle: A handle from connectionHandle.
+--
+-- RETURNS:                 The connection or NULL if it has been destroyed since the handle was made.
+--------------------------------------------------------------------------------------------------*/
+struct connection *lookupConnection(const uint64_t handle)
+{
+    uint32_t fd = (uint32_t)handle;
+    struct connection *conn;
+
+    if (fd >= connectionSlots)
+    {
+        return NULL;
+    }
+
+    conn = connections + fd;
+    if (!conn->inUse || conn->generation != (uint32_t)(handle >> 32))
+    {
+        return NULL;
+    }
+
+    return conn;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                localConnectionCount
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               size_t localConnectionCount()
+--
+-- RETURNS:                 The number of connections the calling worker has open.
+--------------------------------------------------------------------------------------------------*/
+size_t localConnectionCount()
+{
+    return localCount;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                closeLocalConnections
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Leave lingering connections unless forced.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               size_t closeLocalConnections(const size_t max, const bool force)
+--                              const size_t max: The most connections to close.
+--                              const bool force: Also close connections with output pending.
+--
+-- RETURNS:                 The number of connections closed.
+--
+-- NOTES:
+-- Destroys up to max connections of the calling worker. Without force only connections that have
+-- all of their echo written are closed, the others are left to finish. A fiber connection has its
+-- echo written unless its fiber waits to write. A lingering connection is left to its zero copy
+-- sends unless forced.
+--------------------------------------------------------------------------------------------------*/
+size_t closeLocalConnections(const size_t max, const bool force)
+{
+    size_t closed = 0;
+    struct connection *conn = localConnections;
+
+    while (conn != NULL && closed < max)
+    {
+        struct connection *next = conn->next;
+
+        if (force || (pendingOutput(conn) == 0 && !conn->writeBlocked && !conn->lingering))
+        {
+            destroyConnection(conn);
+            closed++;
+        }
+        conn = next;
+    }
+
+    return closed;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                pendingOutput
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               size_t pendingOutput(const struct connection *conn)
+--                              const struct connection *conn: The connection.
+--
+-- RETURNS:                 The number of bytes waiting to be written, shared output included.
+--------------------------------------------------------------------------------------------------*/
+size_t pendingOutput(const struct connection *conn)
+{
+    return conn->outEnd - conn->outStart + conn->sharedPending;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                queueOutput
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Grow into a larger pool buffer instead of reallocating.
+--                          Oct 18, 2026 - Add a piece while shared output is pending.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool queueOutput(struct connection *conn, const char *data, const size_t len)
+--                              struct connection *conn: The connection.
+--                              const char *data: The data to queue.
+--                              const size_t len: The length of data.
+--
+-- RETURNS:                 True if the data was queued, false if no memory was left for it.
+--
+-- NOTES:
+-- Copies data to the end of the pending output. Already written bytes at the front of the buffer
+-- are reclaimed if that makes room, otherwise the output moves to a buffer of a larger class.
+--------------------------------------------------------------------------------------------------*/
+bool queueOutput(struct connection *conn, const char *data, const size_t len)
+{
+    size_t pending = conn->outEnd - conn->outStart;
+
+    if (conn->pieceCount > 0 && !pushPiece(conn, NULL, len))
+    {
+        return false;
+    }
+
+    if (conn->outEnd + len > conn->outCap && pending + len <= conn->outCap)
+    {
+        memmove(conn->out, conn->out + conn->outStart, pending);
+        conn->outEnd = pending;
+        conn->outStart = 0;
+    }
+
+    if (pending + len > conn->outCap)
+    {
+        size_t cap;
+        char *out;
+
+        if ((out = poolAcquire(pending + len, &cap)) == NULL)
+        {
+            return false;
+        }
+
+        if (conn->out != NULL)
+        {
+            memcpy(out, conn->out + conn->outStart, pending);
+            poolRelease(conn->out, conn->outCap);
+        }
+
+        conn->out = out;
+        conn->outCap = cap;
+        conn->outStart = 0;
+        conn->outEnd = pending;
+    }
+
+    memcpy(conn->out + conn->outEnd, data, len);
+    conn->outEnd += len;
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                queueShared
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool queueShared(struct connection *conn, const char *data, const size_t len)
+--                              struct connection *conn: The connection.
+--                              const char *data: Output shared with handlerShare.
+--                              const size_t len: The length of data.
+--
+-- RETURNS:                 True if the data was queued, false if no memory was left for it.
+--
+-- NOTES:
+-- Appends a pointer to data to the pending output. The output already in the buffer becomes the
+-- first piece if it is the first shared output to wait.
+--------------------------------------------------------------------------------------------------*/
+bool queueShared(struct connection *conn, const char *data, const size_t len)
+{
+    if (conn->pieceCount == 0 && conn->outEnd > conn->outStart
+        && !pushPiece(conn, NULL, conn->outEnd - conn->outStart))
+    {
+        return false;
+    }
+
+    if (!pushPiece(conn, data, len))
+    {
+        return false;
+    }
+    conn->sharedPending += len;
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                pushPiece
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool pushPiece(struct connection *conn, const char *shared, const size_t len)
+--                              struct connection *conn: The connection.
+--                              const char *shared: Shared output, NULL for the next len bytes of the buffer.
+--                              const size_t len: The length of the piece.
+--
+-- RETURNS:                 False if the queue could not be grown, true otherwise.
+--
+-- NOTES:
+-- Adds a piece to the end of the pending output, extending the last piece if the new one directly
+-- follows it. The queue grows like the inflight queue and is kept until the connection is destroyed.
+--------------------------------------------------------------------------------------------------*/
+bool pushPiece(struct connection *conn, const char *shared, const size_t len)
+{
+    if (conn->pieceCount > 0)
+    {
+        struct output_piece *last = &conn->pieces[(conn->pieceHead + conn->pieceCount - 1) % conn->pieceCap];
+
+        if (shared == NULL ? last->shared == NULL : last->shared != NULL && last->shared + last->len == shared)
+        {
+            last->len += len;
+            return true;
+        }
+    }
+
+    if (conn->pieceCount == conn->pieceCap)
+    {
+        size_t cap = conn->pieceCap ? conn->pieceCap * 2 : 8;
+        struct output_piece *pieces;
+
+        if ((pieces = malloc(cap * sizeof(struct output_piece))) == NULL)
+        {
+            statsAdd(STAT_ERRORS, 1);
+            return false;
+        }
+
+        // unwrap the old queue to the front of the new one
+        for (size_t i = 0; i < conn->pieceCount; i++)
+        {
+            pieces[i] = conn->pieces[(conn->pieceHead + i) % conn->pieceCap];
+        }
+
+        free(conn->pieces);
+        conn->pieces = pieces;
+        conn->pieceCap = cap;
+        conn->pieceHead = 0;
+    }
+
+    conn->pieces[(conn->pieceHead + conn->pieceCount) % conn->pieceCap].shared = shared;
+    conn->pieces[(conn->pieceHead + conn->pieceCount) % conn->pieceCap].len = len;
+    conn->pieceCount++;
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                sendPieces
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               ssize_t sendPieces(struct connection *conn)
+--                              struct connection *conn: A connection with pieces pending.
+--
+-- RETURNS:                 What sendmsg returned.
+--
+-- NOTES:
+-- Sends the first HANDLER_MAX_SEGMENTS pieces of the pending output with one sendmsg.
+--------------------------------------------------------------------------------------------------*/
+ssize_t sendPieces(struct connection *conn)
+{
+    struct iovec iov[HANDLER_MAX_SEGMENTS];
+    struct msghdr msg;
+    size_t offset = conn->outStart;
+    size_t count = 0;
+
+    while (count < conn->pieceCount && count < HANDLER_MAX_SEGMENTS)
+    {
+        struct output_piece *piece = &conn->pieces[(conn->pieceHead + count) % conn->pieceCap];
+
+        if (piece->shared != NULL)
+        {
+            iov[count].iov_base = (void *)piece->shared;
+        }
+        else
+        {
+            iov[count].iov_base = conn->out + offset;
+            offset += piece->len;
+        }
+        iov[count].iov_len = piece->len;
+        count++;
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+
+    return sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                skipOutput
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void skipOutput(struct connection *conn, size_t len)
+--                              struct connection *conn: The connection.
+--                              size_t len: The number of bytes of pending output that were sent.
+--
+-- NOTES:
+-- Drops sent bytes from the front of the pending output, and the pieces they used up.
+--------------------------------------------------------------------------------------------------*/
+void skipOutput(struct connection *conn, size_t len)
+{
+    while (len > 0 && conn->pieceCount > 0)
+    {
+        struct output_piece *piece = &conn->pieces[conn->pieceHead];
+        size_t take = len < piece->len ? len : piece->len;
+
+        if (piece->shared != NULL)
+        {
+            piece->shared += take;
+            conn->sharedPending -= take;
+        }
+        else
+        {
+            conn->outStart += take;
+        }
+        piece->len -= take;
+        len -= take;
+
+        if (piece->len == 0)
+        {
+            conn->pieceHead = (conn->pieceHead + 1) % conn->pieceCap;
+            conn->pieceCount--;
+        }
+    }
+
+    conn->outStart += len;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                sendOrQueue
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool sendOrQueue(struct connection *conn, const char *data, const size_t len)
+--                              struct connection *conn: The connection.
+--                              const char *data: The data to write.
+--                              const size_t len: The length of data.
+--
+-- RETURNS:                 False if the connection failed, true otherwise.
+--
+-- NOTES:
+-- Writes data straight to the socket if nothing is pending. Whatever the socket does not take is
+-- queued behind the pending output so the order of the echo is kept.
+--------------------------------------------------------------------------------------------------*/
+bool sendOrQueue(struct connection *conn, const char *data, const size_t len)
+{
+    size_t sent = 0;
+
+    while (pendingOutput(conn) == 0 && sent < len)
+    {
+        ssize_t n = send(conn->fd, data + sent, len - sent, MSG_NOSIGNAL);
+
+        if (n > 0)
+        {
+            logSnd(conn->fd, n);
+            statsAdd(STAT_BYTES_OUT, n);
+            statsAdd(STAT_MESSAGES_OUT, 1);
+            sent += n;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            statsAdd(STAT_EAGAINS, 1);
+            break;
+        }
+        else if (errno != EINTR)
+        {
+            statsAdd(STAT_ERRORS, 1);
+            return false;
+        }
+    }
+
+    if (sent < len)
+    {
+        return queueOutput(conn, data + sent, len - sent);
+    }
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                flushConnection
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Give the buffer back once it is flushed.
+--                          Oct 18, 2026 - Send the pieces while shared output is pending.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool flushConnection(struct connection *conn)
+--                              struct connection *conn: The connection.
+--
+-- RETURNS:                 False if the connection failed, true otherwise.
+--
+-- NOTES:
+-- Writes pending output until it is gone or the socket would block. Once it is gone the buffer goes
+-- back to the pool.
+--------------------------------------------------------------------------------------------------*/
+bool flushConnection(struct connection *conn)
+{
+    while (pendingOutput(conn) > 0)
+    {
+        ssize_t n = conn->pieceCount > 0 ? sendPieces(conn)
+                                         : send(conn->fd, conn->out + conn->outStart, pendingOutput(conn), MSG_NOSIGNAL);
+
+        if (n > 0)
+        {
+            logSnd(conn->fd, n);
+            statsAdd(STAT_BYTES_OUT, n);
+            statsAdd(STAT_MESSAGES_OUT, 1);
+            skipOutput(conn, n);
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            statsAdd(STAT_EAGAINS, 1);
+            return true;
+        }
+        else if (errno != EINTR)
+        {
+            statsAdd(STAT_ERRORS, 1);
+            return false;
+        }
+    }
+
+    if (conn->out != NULL)
+    {
+        poolRelease(conn->out, conn->outCap);
+    }
+
+    conn->out = NULL;
+    conn->outCap = 0;
+    conn->outStart = 0;
+    conn->outEnd = 0;
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                readConnection
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Start closing a connection the handler gave up with output pending.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool readConnection(struct connection *conn, char *buf, const int len)
+--                              struct connection *conn: The connection.
+--                              char *buf: The buffer of the worker to read into.
+--                              const int len: The length of buf.
+--
+-- RETURNS:                 False if the connection was closed by the peer, failed or its handler closed
+--                          it with nothing left to send, true otherwise.
+--
+-- NOTES:
+-- Reads the socket in chunks of len bytes until it would block and hands every chunk to the handler
+-- of the connection. Stops early with readBlocked set under the same conditions as echoConnection.
+-- A handler that gives the connection up while some of what it wrote is still pending leaves the
+-- connection closing, with its reading side shut down.
+--------------------------------------------------------------------------------------------------*/
+bool readConnection(struct connection *conn, char *buf, const int len)
+{
+    while (true)
+    {
+        ssize_t n;
+
+        if (pendingOutput(conn) >= CONNECTION_HIGH_WATER || (pendingOutput(conn) > 0 && poolOverBudget()))
+        {
+            conn->readBlocked = true;
+            return true;
+        }
+
+        n = recv(conn->fd, buf, len, 0);
+
+        if (n > 0)
+        {
+            logRcv(conn->fd, n);
+            statsAdd(STAT_BYTES_IN, n);
+            statsAdd(STAT_MESSAGES_IN, 1);
+
+            if (!handlerData(&conn->handlerConn, buf, n))
+            {
+                if (pendingOutput(conn) == 0)
+                {
+                    return false;
+                }
+                shutdown(conn->fd, SHUT_RD);
+                conn->closing = true;
+                conn->readBlocked = false;
+                return true;
+            }
+        }
+        else if (n == 0)
+        {
+            return false;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            statsAdd(STAT_EAGAINS, 1);
+            conn->readBlocked = false;
+            return true;
+        }
+        else if (errno != EINTR)
+        {
+            statsAdd(STAT_ERRORS, 1);
+            return false;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                writeConnection
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Cork the socket while more output follows.
+--                          Oct 18, 2026 - Queue shared output by reference.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool writeConnection(struct handler_conn *handlerConn, const struct iovec *iov,
+--                                               const int count, const bool more)
+--                              struct handler_conn *handlerConn: The handler side of the connection.
+--                              const struct iovec *iov: The output the handler queued.
+--                              const int count: The number of pieces, at most HANDLER_MAX_SEGMENTS.
+--                              const bool more: Whether more output follows.
+--
+-- RETURNS:                 False if the connection failed, true otherwise.
+--
+-- NOTES:
+-- The write of epoll connections. Like sendOrQueue for the pieces of iov, sent with one sendmsg as
+-- long as the socket takes them. What is left is copied into the pending output, unless the handler
+-- shares it.
+--------------------------------------------------------------------------------------------------*/
+bool writeConnection(struct handler_conn *handlerConn, const struct iovec *iov, const int count,
+                     const bool more)
+{
+    struct connection *conn = (struct connection *)((char *)handlerConn - offsetof(struct connection, handlerConn));
+    struct iovec rest[HANDLER_MAX_SEGMENTS];
+    struct msghdr msg;
+
+    memcpy(rest, iov, count * sizeof(struct iovec));
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = rest;
+    msg.msg_iovlen = count;
+
+    while (pendingOutput(conn) == 0 && msg.msg_iovlen > 0)
+    {
+        ssize_t n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+
+        if (n > 0)
+        {
+            logSnd(conn->fd, n);
+            statsAdd(STAT_BYTES_OUT, n);
+            statsAdd(STAT_MESSAGES_OUT, 1);
+
+            // skip what went out, the first piece left may have been sent in part
+            while (msg.msg_iovlen > 0 && (size_t)n >= msg.msg_iov->iov_len)
+            {
+                n -= msg.msg_iov->iov_len;
+                msg.msg_iov++;
+                msg.msg_iovlen--;
+            }
+            if (msg.msg_iovlen > 0)
+            {
+                msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + n;
+                msg.msg_iov->iov_len -= n;
+            }
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            statsAdd(STAT_EAGAINS, 1);
+            break;
+        }
+        else if (errno != EINTR)
+        {
+            statsAdd(STAT_ERRORS, 1);
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < msg.msg_iovlen; i++)
+    {
+        const char *data = msg.msg_iov[i].iov_base;
+        size_t len = msg.msg_iov[i].iov_len;
+
+        if (handlerShared(data, len) ? !queueShared(conn, data, len) : !queueOutput(conn, data, len))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                receiveOnFiber
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               ssize_t receiveOnFiber(struct connection *conn, char *buf, const size_t len)
+--                              struct connection *conn: The connection, called on its fiber.
+--                              char *buf: The buffer to read into.
+--                              const size_t len: The length of buf.
+--
+-- RETURNS:                 The number of bytes read, 0 if the peer closed the connection and -1 if it
+--                          failed.
+--
+-- NOTES:
+-- Reads what the socket has, yielding the fiber until epoll reports the socket readable if it has
+-- nothing. Reading before yielding means data that arrived while the fiber was busy is never waited
+-- for, whatever happened to its edge.
+--------------------------------------------------------------------------------------------------*/
+ssize_t receiveOnFiber(struct connection *conn, char *buf, const size_t len)
+{
+    while (true)
+    {
+        ssize_t n = recv(conn->fd, buf, len, 0);
+
+        if (n > 0)
+        {
+            logRcv(conn->fd, n);
+            statsAdd(STAT_BYTES_IN, n);
+            statsAdd(STAT_MESSAGES_IN, 1);
+            conn->hasRead = true;
+            return n;
+        }
+        else if (n == 0)
+        {
+            return 0;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            statsAdd(STAT_EAGAINS, 1);
+            yieldFiber();
+        }
+        else if (errno != EINTR)
+        {
+            statsAdd(STAT_ERRORS, 1);
+            return -1;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                readOnFiber
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               ssize_t readOnFiber(struct handler_conn *handlerConn, char *buf, const size_t len)
+--                              struct handler_conn *handlerConn: The handler side of the connection.
+--                              char *buf: The buffer to read into.
+--                              const size_t len: The length of buf.
+--
+-- RETURNS:                 The number of bytes read, 0 if the peer closed the connection and -1 if it
+--                          failed.
+--
+-- NOTES:
+-- The read of fiber connections, called by handlerRead from the onFiber of the handler.
+--------------------------------------------------------------------------------------------------*/
+ssize_t readOnFiber(struct handler_conn *handlerConn, char *buf, const size_t len)
+{
+    struct connection *conn = (struct connection *)((char *)handlerConn - offsetof(struct connection, handlerConn));
+
+    return receiveOnFiber(conn, buf, len);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                writeOnFiber
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool writeOnFiber(struct handler_conn *handlerConn, const struct iovec *iov,
+--                                            const int count, const bool more)
+--                              struct handler_conn *handlerConn: The handler side of the connection.
+--                              const struct iovec *iov: The output the handler queued.
+--                              const int count: The number of pieces, at most HANDLER_MAX_SEGMENTS.
+--                              const bool more: Whether more output follows.
+--
+-- RETURNS:                 False if the connection failed, true once all of the output is sent.
+--
+-- NOTES:
+-- The write of fiber connections. Sends the pieces of iov with sendmsg and yields the fiber with
+-- writeBlocked set whenever the socket is full, until all of them are out. The pieces are copied
+-- first, since the gather list iov points into belongs to the worker and the other fibers fill it
+-- while this one is suspended. The data itself is not copied, it stays where the handler keeps it
+-- on the suspended fiber.
+--------------------------------------------------------------------------------------------------*/
+bool writeOnFiber(struct handler_conn *handlerConn, const struct iovec *iov, const int count, const bool more)
+{
+    struct connection *conn = (struct connection *)((char *)handlerConn - offsetof(struct connection, handlerConn));
+    struct iovec rest[HANDLER_MAX_SEGMENTS];
+    struct msghdr msg;
+
+    memcpy(rest, iov, count * sizeof(struct iovec));
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = rest;
+    msg.msg_iovlen = count;
+
+    while (msg.msg_iovlen > 0)
+    {
+        ssize_t n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+
+        if (n > 0)
+        {
+            logSnd(conn->fd, n);
+            statsAdd(STAT_BYTES_OUT, n);
+            statsAdd(STAT_MESSAGES_OUT, 1);
+
+            // skip what went out, the first piece left may have been sent in part
+            while (msg.msg_iovlen > 0 && (size_t)n >= msg.msg_iov->iov_len)
+            {
+                n -= msg.msg_iov->iov_len;
+                msg.msg_iov++;
+                msg.msg_iovlen--;
+            }
+            if (msg.msg_iovlen > 0)
+            {
+                msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + n;
+                msg.msg_iov->iov_len -= n;
+            }
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            statsAdd(STAT_EAGAINS, 1);
+            conn->writeBlocked = true;
+            yieldFiber();
+            conn->writeBlocked = false;
+        }
+        else if (errno != EINTR)
+        {
+            statsAdd(STAT_ERRORS, 1);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                echoConnection
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Zero copy sends above the threshold of the connection.
+--                          Oct 17, 2026 - Stop reading while output is pending over the pool budget.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool echoConnection(struct connection *conn, char *buf, const int len)
+--                              struct connection *conn: The connection.
+--                              char *buf: A scratch buffer for reading.
+--                              const int len: The length of buf.
+--
+-- RETURNS:                 False if the connection was closed by the peer or failed, true otherwise.
+--
+-- NOTES:
+-- Reads the socket in chunks of len bytes until it would block, echoing every chunk. Messages of any
+-- size are handled since nothing is assumed about where a read ends. Stops early with readBlocked
+-- set if the peer is not reading its echo fast enough, or if output is pending and the buffers held by
+-- all connections are over budget. With zero copy the chunks are read into a
+-- zc_buffer, and a new one is taken whenever a send keeps the current one pinned.
+--------------------------------------------------------------------------------------------------*/
+bool echoConnection(struct connection *conn, char *buf, const int len)
+{
+    struct zc_buffer *zc = NULL;
+    bool open = true;
+
+    while (true)
+    {
+        ssize_t n;
+        char *data = buf;
+
+        if (pendingOutput(conn) >= CONNECTION_HIGH_WATER || (pendingOutput(conn) > 0 && poolOverBudget()))
+        {
+            conn->readBlocked = true;
+            break;
+        }
+
+        if (conn->zeroCopyThreshold > 0)
+        {
+            if (zc == NULL && (zc = acquireZeroCopyBuffer(len)) == NULL)
+            {
+                statsAdd(STAT_ERRORS, 1);
+                return false;
+            }
+            data = zc->data;
+        }
+
+        n = recv(conn->fd, data, len, 0);
+
+        if (n > 0)
+        {
+            logRcv(conn->fd, n);
+            statsAdd(STAT_BYTES_IN, n);
+            statsAdd(STAT_MESSAGES_IN, 1);
+
+            if (zc != NULL && (size_t)n >= conn->zeroCopyThreshold && pendingOutput(conn) == 0)
+            {
+                open = sendZeroCopy(conn, zc, n);
+
+                // the kernel still reads from it, read the next chunk somewhere else
+                if (zc->refs > 1)
+                {
+                    releaseZeroCopyBuffer(zc);
+                    zc = NULL;
+                }
+            }
+            else
+            {
+                open = sendOrQueue(conn, data, n);
+            }
+
+            if (!open)
+            {
+                break;
+            }
+        }
+        else if (n == 0)
+        {
+            open = false;
+            break;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            statsAdd(STAT_EAGAINS, 1);
+            conn->readBlocked = false;
+            break;
+        }
+        else if (errno != EINTR)
+        {
+            statsAdd(STAT_ERRORS, 1);
+            open = false;
+            break;
+        }
+    }
+
+    if (zc != NULL)
+    {
+        releaseZeroCopyBuffer(zc);
+    }
+
+    return open;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                spliceConnection
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool spliceConnection(struct connection *conn, const int *echoPipe, char *buf,
+--                                                const int len)
+--                              struct connection *conn: The connection.
+--                              const int *echoPipe: The empty pipe of the worker, read end first.
+--                              char *buf: A scratch buffer for when the data has to be copied.
+--                              const int len: The length of buf.
+--
+-- RETURNS:                 False if the connection was closed by the peer or failed, true otherwise.
+--
+-- NOTES:
+-- Like echoConnection, but moves up to len bytes at a time from the socket through echoPipe and back
+-- without copying them. Falls back to echoConnection while output is pending and for sockets that
+-- splice does not support. echoPipe is empty again when this returns.
+--------------------------------------------------------------------------------------------------*/
+bool spliceConnection(struct connection *conn, const int *echoPipe, char *buf, const int len)
+{
+    while (true)
+    {
+        ssize_t n;
+        ssize_t sent = 0;
+
+        if (conn->noSplice || pendingOutput(conn) > 0)
+        {
+            return echoConnection(conn, buf, len);
+        }
+
+        n = splice(conn->fd, NULL, echoPipe[1], NULL, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+        if (n == 0)
+        {
+            return false;
+        }
+        else if (n == -1)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                statsAdd(STAT_EAGAINS, 1);
+                conn->readBlocked = false;
+                return true;
+            }
+            else if (errno == EINVAL)
+            {
+                conn->noSplice = true;
+                continue;
+            }
+            else if (errno != EINTR)
+            {
+                statsAdd(STAT_ERRORS, 1);
+                return false;
+            }
+            continue;
+        }
+
+        logRcv(conn->fd, n);
+        statsAdd(STAT_BYTES_IN, n);
+        statsAdd(STAT_MESSAGES_IN, 1);
+
+        while (sent < n)
+        {
+            ssize_t m = splice(echoPipe[0], NULL, conn->fd, NULL, n - sent, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+            if (m > 0)
+            {
+                logSnd(conn->fd, m);
+                statsAdd(STAT_BYTES_OUT, m);
+                statsAdd(STAT_MESSAGES_OUT, 1);
+                sent += m;
+            }
+            else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                statsAdd(STAT_EAGAINS, 1);
+                break;
+            }
+            else if (errno != EINTR)
+            {
+                statsAdd(STAT_ERRORS, 1);
+                takeFromPipe(conn, echoPipe[0], buf, len, n - sent, false);
+                return false;
+            }
+        }
+
+        if (sent < n && !takeFromPipe(conn, echoPipe[0], buf, len, n - sent, true))
+        {
+            return false;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                takeFromPipe
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool takeFromPipe(struct connection *conn, const int pipeOut, char *buf,
+--                                            const int len, size_t count, const bool keep)
+--                              struct connection *conn: The connection the data belongs to.
+--                              const int pipeOut: The read end of the pipe.
+--                              char *buf: A scratch buffer.
+--                              const int len: The length of buf.
+--                              size_t count: The number of bytes in the pipe.
+--                              const bool keep: Whether to queue the data or throw it away.
+--
+-- RETURNS:                 False if the data could not be queued, true otherwise.
+--
+-- NOTES:
+-- Empties the pipe, queueing what was in it as pending output of the connection if keep is set. The
+-- pipe is always emptied, even when queueing fails, so the next connection finds it empty.
+--------------------------------------------------------------------------------------------------*/
+bool takeFromPipe(struct connection *conn, const int pipeOut, char *buf, const int len, size_t count, const bool keep)
+{
+    bool queued = true;
+
+    while (count > 0)
+    {
+        ssize_t n = read(pipeOut, buf, count < (size_t)len ? count : (size_t)len);
+
+        if (n > 0)
+        {
+            if (keep && queued)
+            {
+                queued = queueOutput(conn, buf, n);
+            }
+            count -= n;
+        }
+        else if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        else
+        {
+            statsAdd(STAT_ERRORS, 1);
+            return false;
+        }
+    }
+
+    return queued;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                sendZeroCopy
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool sendZeroCopy(struct connection *conn, struct zc_buffer *zc, const size_t len)
+--                              struct connection *conn: The connection, with nothing pending.
+--                              struct zc_buffer *zc: The buffer holding the data.
+--                              const size_t len: The length of the data.
+--
+-- RETURNS:                 False if the connection failed, true otherwise.
+--
+-- NOTES:
+-- Sends the data with MSG_ZEROCOPY, pinning zc once for every send that took part of it. What the
+-- socket does not take is copied into the pending output. If the kernel is out of memory for pinning
+-- pages the rest is sent by copying.
+--------------------------------------------------------------------------------------------------*/
+bool sendZeroCopy(struct connection *conn, struct zc_buffer *zc, const size_t len)
+{
+    size_t sent = 0;
+
+    while (sent < len)
+    {
+        ssize_t n = send(conn->fd, zc->data + sent, len - sent, MSG_NOSIGNAL | MSG_ZEROCOPY);
+
+        if (n > 0)
+        {
+            logSnd(conn->fd, n);
+            statsAdd(STAT_BYTES_OUT, n);
+            statsAdd(STAT_MESSAGES_OUT, 1);
+            statsAdd(STAT_ZEROCOPY_SENDS, 1);
+            if (!trackZeroCopy(conn, zc))
+            {
+                return false;
+            }
+            sent += n;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            statsAdd(STAT_EAGAINS, 1);
+            return queueOutput(conn, zc->data + sent, len - sent);
+        }
+        else if (errno == ENOBUFS)
+        {
+            return sendOrQueue(conn, zc->data + sent, len - sent);
+        }
+        else if (errno != EINTR)
+        {
+            statsAdd(STAT_ERRORS, 1);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                trackZeroCopy
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool trackZeroCopy(struct connection *conn, struct zc_buffer *zc)
+--                              struct connection *conn: The connection.
+--                              struct zc_buffer *zc: The buffer that was just sent from.
+--
+-- RETURNS:                 False if the inflight queue could not grow, true otherwise.
+--
+-- NOTES:
+-- Takes a reference to zc and appends it to the inflight queue, one entry per zero copy send, which
+-- is how the kernel numbers its completions.
+--------------------------------------------------------------------------------------------------*/
+bool trackZeroCopy(struct connection *conn, struct zc_buffer *zc)
+{
+    if (conn->inflightCount == conn->inflightCap)
+    {
+        size_t cap = conn->inflightCap ? conn->inflightCap * 2 : 16;
+        struct zc_buffer **inflight;
+
+        if ((inflight = malloc(cap * sizeof(struct zc_buffer *))) == NULL)
+        {
+            statsAdd(STAT_ERRORS, 1);
+            return false;
+        }
+
+        // unwrap the old queue to the front of the new one
+        for (size_t i = 0; i < conn->inflightCount; i++)
+        {
+            inflight[i] = conn->inflight[(conn->inflightHead + i) % conn->inflightCap];
+        }
+
+        free(conn->inflight);
+        conn->inflight = inflight;
+        conn->inflightCap = cap;
+        conn->inflightHead = 0;
+    }
+
+    zc->refs++;
+    conn->inflight[(conn->inflightHead + conn->inflightCount) % conn->inflightCap] = zc;
+    conn->inflightCount++;
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                completeZeroCopy
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool completeZeroCopy(struct connection *conn)
+--                              struct connection *conn: The connection.
+--
+-- RETURNS:                 False if the error queue held a real error, true otherwise.
+--
+-- NOTES:
+-- Reads the error queue of the socket until it is empty. Every zero copy notification covers a range
+-- of sends, whose buffers are released. Sends the kernel had to copy after all, as it always does
+-- over loopback, are counted as STAT_ZEROCOPY_COPIED.
+--------------------------------------------------------------------------------------------------*/
+bool completeZeroCopy(struct connection *conn)
+{
+    while (true)
+    {
+        char control[128];
+        struct msghdr msg;
+        struct cmsghdr *cmsg;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(conn->fd, &msg, MSG_ERRQUEUE) == -1)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return true;
+            }
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            statsAdd(STAT_ERRORS, 1);
+            return false;
+        }
+
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            struct sock_extended_err *serr;
+            uint32_t count;
+
+            if (!(cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVERR)
+                && !(cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+            {
+                continue;
+            }
+
+            serr = (struct sock_extended_err *)CMSG_DATA(cmsg);
+            if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno != 0)
+            {
+                statsAdd(STAT_ERRORS, 1);
+                return false;
+            }
+
+            // ee_info to ee_data is the inclusive range of sends that completed
+            count = serr->ee_data - serr->ee_info + 1;
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            {
+                statsAdd(STAT_ZEROCOPY_COPIED, count);
+            }
+
+            for (uint32_t i = 0; i < count && conn->inflightCount > 0; i++)
+            {
+                releaseZeroCopyBuffer(conn->inflight[conn->inflightHead]);
+                conn->inflightHead = (conn->inflightHead + 1) % conn->inflightCap;
+                conn->inflightCount--;
+            }
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                lingerZeroCopy
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool lingerZeroCopy(struct connection *conn)
+--                              struct connection *conn: A connection being destroyed with sends in flight.
+--
+-- RETURNS:                 True if the connection lingers, false if it can be closed right away.
+--
+-- NOTES:
+-- Shuts the socket down both ways, which still lets the kernel send what it has queued, and gives
+-- the peer ZEROCOPY_LINGER_MS to take it. Completions that already arrived are read first, as with
+-- edge triggered epoll they will not be reported again.
+--------------------------------------------------------------------------------------------------*/
+bool lingerZeroCopy(struct connection *conn)
+{
+    unsigned int timeout = ZEROCOPY_LINGER_MS;
+
+    shutdown(conn->fd, SHUT_RDWR);
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &timeout, sizeof(timeout));
+
+    if (!completeZeroCopy(conn) || conn->inflightCount == 0)
+    {
+        return false;
+    }
+
+    conn->lingering = true;
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                acquireZeroCopyBuffer
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               struct zc_buffer *acquireZeroCopyBuffer(const size_t size)
+--                              const size_t size: The size of the data the buffer must hold.
+--
+-- RETURNS:                 A buffer with one reference or NULL if none could be allocated.
+--
+-- NOTES:
+-- Takes a buffer from the free list of the worker, allocating one if the list is empty or its first
+-- buffer is too small.
+--------------------------------------------------------------------------------------------------*/
+struct zc_buffer *acquireZeroCopyBuffer(const size_t size)
+{
+    struct zc_buffer *zc = freeBuffers;
+
+    if (zc != NULL && zc->size >= size)
+    {
+        freeBuffers = zc->next;
+        freeBufferCount--;
+    }
+    else if ((zc = malloc(sizeof(struct zc_buffer) + size)) != NULL)
+    {
+        zc->size = size;
+    }
+    else
+    {
+        return NULL;
+    }
+
+    zc->refs = 1;
+    zc->next = NULL;
+
+    return zc;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                releaseZeroCopyBuffer
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void releaseZeroCopyBuffer(struct zc_buffer *zc)
+--                              struct zc_buffer *zc: The buffer.
+--
+-- NOTES:
+-- Drops a reference to zc. The last reference puts it on the free list of the worker, or frees it if
+-- the list is full.
+--------------------------------------------------------------------------------------------------*/
+void releaseZeroCopyBuffer(struct zc_buffer *zc)
+{
+    if (--zc->refs > 0)
+    {
+        return;
+    }
+
+    if (freeBufferCount >= ZEROCOPY_FREE_MAX)
+    {
+        free(zc);
+        return;
+    }
+
+    zc->next = freeBuffers;
+    freeBuffers = zc;
+    freeBufferCount++;
+}
@@ -0,0 +1,123 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "fiber.h"
+#include "handler.h"
+#include "timerwheel.h"
+
+// stop reading from a connection once this much echo data is waiting to be written
+#define CONNECTION_HIGH_WATER (256 * 1024)
+
+// the most connection slots the table maps however high the open file limit is, fds past the
+// table are closed as soon as they are accepted
+#define CONNECTION_SLOTS_MAX (1024 * 1024)
+
+// idle zero copy buffers each worker keeps for reuse
+#define ZEROCOPY_FREE_MAX 64
+
+// how long a closed connection waits for the peer to take its zero copy sends before the kernel
+// gives up on them
+#define ZEROCOPY_LINGER_MS (30 * 1000)
+
+// the data of a zero copy send, pinned until every send of it has completed
+struct zc_buffer
+{
+    int refs;
+    size_t size;
+    struct zc_buffer *next;
+    char data[];
+};
+
+// a stretch of pending output, the next len bytes of out, or output shared by the handler
+struct output_piece
+{
+    // NULL for bytes of out
+    const char *shared;
+    size_t len;
+};
+
+// the epoll data of the listener, the timerfd and the drain eventfd, no connection has these handles
+#define CONNECTION_LISTENER UINT64_MAX
+#define CONNECTION_TIMER (UINT64_MAX - 1)
+#define CONNECTION_DRAIN (UINT64_MAX - 2)
+
+struct connection
+{
+    // one cache line per connection at least, the table is indexed by fd
+    _Alignas(64) int fd;
+    uint32_t generation;
+    bool inUse;
+    bool readBlocked;
+    bool wantWrite;
+    bool noSplice;
+    bool hasRead;
+    // the fiber of the connection waits for the socket to take its output
+    bool writeBlocked;
+    // destroyed, but the socket stays open until its zero copy sends complete
+    bool lingering;
+    // the handler gave the connection up, it reads no more and closes once its output is out
+    bool closing;
+    struct wheel_timer timer;
+    // what the protocol handler sees of the connection
+    struct handler_conn handlerConn;
+    // runs the connection in fiber mode, NULL otherwise
+    struct fiber *fiber;
+    // the other connections of the same worker
+    struct connection *next;
+    struct connection *prev;
+    char *out;
+    size_t outCap;
+    size_t outStart;
+    size_t outEnd;
+    // the order of the pending output while some of it is shared, empty while all of it is in out
+    struct output_piece *pieces;
+    size_t pieceCap;
+    size_t pieceHead;
+    size_t pieceCount;
+    size_t sharedPending;
+    size_t zeroCopyThreshold;
+    struct zc_buffer **inflight;
+    size_t inflightCap;
+    size_t inflightHead;
+    size_t inflightCount;
+};
+
+bool startConnectionTable();
+void stopConnectionTable();
+struct connection *createConnection(const int fd);
+void destroyConnection(struct connection *conn);
+uint64_t connectionHandle(const struct connection *conn);
+struct connection *lookupConnection(const uint64_t handle);
+size_t localConnectionCount();
+size_t closeLocalConnections(const size_t max, const bool force);
+
+size_t pendingOutput(const struct connection *conn);
+bool queueOutput(struct connection *conn, const char *data, const size_t len);
+bool queueShared(struct connection *conn, const char *data, const size_t len);
+bool pushPiece(struct connection *conn, const char *shared, const size_t len);
+ssize_t sendPieces(struct connection *conn);
+void skipOutput(struct connection *conn, size_t len);
+bool sendOrQueue(struct connection *conn, const char *data, const size_t len);
+bool flushConnection(struct connection *conn);
+bool readConnection(struct connection *conn, char *buf, const int len);
+bool writeConnection(struct handler_conn *handlerConn, const struct iovec *iov, const int count,
+                     const bool more);
+ssize_t receiveOnFiber(struct connection *conn, char *buf, const size_t len);
+ssize_t readOnFiber(struct handler_conn *handlerConn, char *buf, const size_t len);
+bool writeOnFiber(struct handler_conn *handlerConn, const struct iovec *iov, const int count, const bool more);
+bool echoConnection(struct connection *conn, char *buf, const int len);
+bool spliceConnection(struct connection *conn, const int *echoPipe, char *buf, const int len);
+bool takeFromPipe(struct connection *conn, const int pipeOut, char *buf, const int len, size_t count, const bool keep);
+bool sendZeroCopy(struct connection *conn, struct zc_buffer *zc, const size_t len);
+bool trackZeroCopy(struct connection *conn, struct zc_buffer *zc);
+bool completeZeroCopy(struct connection *conn);
+bool lingerZeroCopy(struct connection *conn);
+struct zc_buffer *acquireZeroCopyBuffer(const size_t size);
+void releaseZeroCopyBuffer(struct zc_buffer *zc);
+
+#endif // CONNECTION_H
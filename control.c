@@ -0,0 +1,574 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            control.c
+--
+-- PROGRAM:                server.out
+--
+-- FUNCTIONS:
+--                         bool startControl(const struct server_config *config)
+--                         void stopControl()
+--                         int inheritedListener(const int index)
+--                         bool registerListener(const int fd)
+--                         int awaitControl()
+--                         void startDraining()
+--                         bool serverDraining()
+--                         int drainFd()
+--                         int receiveListeners(const struct server_config *config, int *fds)
+--                         bool sendListeners(const int sock)
+--
+-- DATE:                   Oct 17, 2026
+--
+-- REVISIONS:              N/A
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- Stopping, draining and upgrading the server.
+--
+-- SIGINT and SIGTERM are blocked in every thread and read from a signalfd by the main thread once the
+-- workers run, so no signal interrupts a worker and nothing runs in a signal handler. SIGINT stops the
+-- server at once. SIGTERM drains it: the workers stop accepting, finish the echoes they are in the
+-- middle of and exit once their connections are gone.
+--
+-- With an upgrade path the server also listens on a Unix socket at that path. A new server started
+-- with the same path connects to it first and is sent every listening socket of the running one with
+-- SCM_RIGHTS. The new server accepts on the very same sockets, so connects queue in the same backlog
+-- the whole time and none is refused, while the old server drains. Only a server started the same way,
+-- same mode, same -r and same number of workers with -r, can take the sockets over. The new server
+-- answers with one byte whether it does, and the old one only drains once it has.
+---------------------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+
+#include "control.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "tools.h"
+
+static int signalFd = -1;
+static int wakeFd = -1;
+static int upgradeSocket = -1;
+static const char *upgradePath = NULL;
+static bool draining = false;
+static int serverMode;
+static bool serverReusePort;
+static int inherited[CONTROL_MAX_LISTENERS];
+static int inheritedCount = 0;
+static int listeners[CONTROL_MAX_LISTENERS];
+static int listenerCount = 0;
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                startControl
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool startControl(const struct server_config *config)
+--                              const struct server_config *config: The server configuration.
+--
+-- RETURNS:                 True if the server can be controlled, false otherwise.
+--
+-- NOTES:
+-- Blocks SIGINT and SIGTERM and creates the signalfd they are read from. Must be called before any
+-- other thread exists so that every thread inherits the mask. With an upgrade path, takes over the
+-- listeners of a server running there, if there is one, and then listens on the path itself. A socket
+-- file with no server behind it is left over from a server that was killed and is replaced.
+--------------------------------------------------------------------------------------------------*/
+bool startControl(const struct server_config *config)
+{
+    sigset_t set;
+    struct sockaddr_un addr;
+
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    if (pthread_sigmask(SIG_BLOCK, &set, NULL))
+    {
+        return false;
+    }
+
+    if ((signalFd = signalfd(-1, &set, SFD_CLOEXEC)) == -1 || (wakeFd = eventfd(0, EFD_CLOEXEC)) == -1)
+    {
+        return false;
+    }
+
+    serverMode = config->mode;
+    serverReusePort = config->reusePort;
+
+    if (config->upgradePath == NULL)
+    {
+        return true;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(config->upgradePath) >= sizeof(addr.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    strcpy(addr.sun_path, config->upgradePath);
+
+    if ((inheritedCount = receiveListeners(config, inherited)) == -1)
+    {
+        inheritedCount = 0;
+        return false;
+    }
+
+    // the old server stops listening on the path once it handed over, take it
+    if (unlink(config->upgradePath) == -1 && errno != ENOENT)
+    {
+        return false;
+    }
+
+    if ((upgradeSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+    {
+        return false;
+    }
+
+    if (bind(upgradeSocket, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(upgradeSocket, 1) == -1)
+    {
+        close(upgradeSocket);
+        upgradeSocket = -1;
+        return false;
+    }
+    upgradePath = config->upgradePath;
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                stopControl
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void stopControl()
+--
+-- NOTES:
+-- Closes the signalfd, the eventfd and the upgrade socket, removing the path unless the listeners were
+-- handed over and the path now belongs to the new server. Must be called once the workers have stopped.
+--------------------------------------------------------------------------------------------------*/
+void stopControl()
+{
+    if (upgradeSocket != -1)
+    {
+        close(upgradeSocket);
+        unlink(upgradePath);
+        upgradeSocket = -1;
+    }
+
+    close(signalFd);
+    close(wakeFd);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                inheritedListener
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int inheritedListener(const int index)
+--                              const int index: The index of the listener, the worker with -r.
+--
+-- RETURNS:                 The listening socket handed over by the old server, -1 if there is none.
+--
+-- NOTES:
+-- Inherited listeners are bound and listening already, with reuse port in the order of the group.
+--------------------------------------------------------------------------------------------------*/
+int inheritedListener(const int index)
+{
+    return index < inheritedCount ? inherited[index] : -1;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                registerListener
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool registerListener(const int fd)
+--                              const int fd: A listening socket of the server.
+--
+-- RETURNS:                 True if it was registered, false if there are too many.
+--
+-- NOTES:
+-- Adds a listening socket to those handed over on upgrade, in order. Must be called before the
+-- workers start.
+--------------------------------------------------------------------------------------------------*/
+bool registerListener(const int fd)
+{
+    if (listenerCount == CONTROL_MAX_LISTENERS)
+    {
+        errno = EMFILE;
+        return false;
+    }
+
+    listeners[listenerCount++] = fd;
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                awaitControl
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int awaitControl()
+--
+-- RETURNS:                 CONTROL_STOP or CONTROL_DRAIN.
+--
+-- NOTES:
+-- Called by the main thread once the workers run. Waits for SIGINT, SIGTERM or a new server on the
+-- upgrade socket. Once a new server took the listeners this one drains. A new server that did not
+-- take them fails to start, and this one keeps running.
+--------------------------------------------------------------------------------------------------*/
+int awaitControl()
+{
+    struct pollfd fds[2];
+
+    fds[0].fd = signalFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = upgradeSocket;
+    fds[1].events = POLLIN;
+
+    while (true)
+    {
+        // poll skips the upgrade socket when there is none
+        if (poll(fds, 2, -1) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            systemFatal("poll");
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            struct signalfd_siginfo info;
+
+            if (read(signalFd, &info, sizeof(info)) != sizeof(info))
+            {
+                continue;
+            }
+
+            if (info.ssi_signo == SIGINT)
+            {
+                fprintf(stdout, "Stopping server\n");
+                return CONTROL_STOP;
+            }
+
+            fprintf(stdout, "Draining server\n");
+            startDraining();
+            return CONTROL_DRAIN;
+        }
+
+        if (fds[1].revents & POLLIN)
+        {
+            int client;
+
+            if ((client = accept4(upgradeSocket, NULL, NULL, SOCK_CLOEXEC)) == -1)
+            {
+                continue;
+            }
+
+            // a new server that does not take them started its own or failed, keep running
+            if (!sendListeners(client))
+            {
+                fprintf(stderr, "The new server did not take the listeners\n");
+                close(client);
+                continue;
+            }
+            close(client);
+
+            // the path is the new server's now
+            close(upgradeSocket);
+            upgradeSocket = -1;
+
+            fprintf(stdout, "Handed the listeners over, draining server\n");
+            startDraining();
+            return CONTROL_DRAIN;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                startDraining
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void startDraining()
+--
+-- NOTES:
+-- Stops taking upgrades, a draining server has nothing to hand over, and tells the workers to drain.
+-- The eventfd stays readable from now on, so every worker watching it sees it once.
+--------------------------------------------------------------------------------------------------*/
+void startDraining()
+{
+    uint64_t wake = 1;
+
+    if (upgradeSocket != -1)
+    {
+        close(upgradeSocket);
+        unlink(upgradePath);
+        upgradeSocket = -1;
+    }
+
+    __atomic_store_n(&draining, true, __ATOMIC_RELEASE);
+
+    if (write(wakeFd, &wake, sizeof(wake)) == -1)
+    {
+        perror("write");
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                serverDraining
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool serverDraining()
+--
+-- RETURNS:                 True once the server drains, false otherwise.
+--------------------------------------------------------------------------------------------------*/
+bool serverDraining()
+{
+    return __atomic_load_n(&draining, __ATOMIC_ACQUIRE);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                drainFd
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int drainFd()
+--
+-- RETURNS:                 An eventfd that becomes readable when the server starts to drain.
+--
+-- NOTES:
+-- Workers add it to what they wait on. It is never read, so a worker must stop watching it once it
+-- has seen it.
+--------------------------------------------------------------------------------------------------*/
+int drainFd()
+{
+    return wakeFd;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                receiveListeners
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int receiveListeners(const struct server_config *config, int *fds)
+--                              const struct server_config *config: The server configuration.
+--                              int *fds: Room for CONTROL_MAX_LISTENERS sockets.
+--
+-- RETURNS:                 The number of listeners received, 0 if no server runs on the upgrade path
+--                          and -1 on error.
+--
+-- NOTES:
+-- Takes the listeners of the server on the upgrade path if it listens the way this one would, and
+-- tells it whether they were taken. Listeners that were not taken are closed again and the old server
+-- keeps running.
+--------------------------------------------------------------------------------------------------*/
+int receiveListeners(const struct server_config *config, int *fds)
+{
+    int sock;
+    int count;
+    char taken;
+    struct sockaddr_un addr;
+    struct listener_handoff handoff;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(int) * CONTROL_MAX_LISTENERS)];
+        struct cmsghdr align;
+    } control;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, config->upgradePath);
+
+    if ((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+    {
+        return -1;
+    }
+
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        int error = errno;
+
+        close(sock);
+        errno = error;
+        return errno == ENOENT || errno == ECONNREFUSED ? 0 : -1;
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &handoff;
+    iov.iov_len = sizeof(handoff);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    if (recvmsg(sock, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC) != sizeof(handoff)
+        || (cmsg = CMSG_FIRSTHDR(&msg)) == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+    {
+        close(sock);
+        errno = EPROTO;
+        return -1;
+    }
+
+    count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    memcpy(fds, CMSG_DATA(cmsg), count * sizeof(int));
+
+    taken = !(msg.msg_flags & MSG_CTRUNC) && count == handoff.count && handoff.mode == config->mode
+            && handoff.reusePort == config->reusePort && count == (config->reusePort ? config->workers : 1);
+
+    if (send(sock, &taken, sizeof(taken), MSG_NOSIGNAL) != sizeof(taken))
+    {
+        taken = false;
+    }
+    close(sock);
+
+    if (!taken)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            close(fds[i]);
+        }
+        fprintf(stderr, "The server on %s listens differently, start with the same -m, -r and -w\n",
+                config->upgradePath);
+        errno = EINVAL;
+        return -1;
+    }
+
+    return count;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                sendListeners
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool sendListeners(const int sock)
+--                              const int sock: A new server connected to the upgrade socket.
+--
+-- RETURNS:                 True if the new server took the listeners, false otherwise.
+--
+-- NOTES:
+-- Sends the registered listeners in one SCM_RIGHTS message along with how this server listens and
+-- waits a second at most for the answer of the new server. The new server gets its own descriptors of
+-- the same sockets, this server keeps its own until it closes them when it stops.
+--------------------------------------------------------------------------------------------------*/
+bool sendListeners(const int sock)
+{
+    struct listener_handoff handoff;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    struct timeval wait = { 1, 0 };
+    char taken = false;
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(int) * CONTROL_MAX_LISTENERS)];
+        struct cmsghdr align;
+    } control;
+
+    handoff.mode = serverMode;
+    handoff.reusePort = serverReusePort;
+    handoff.count = listenerCount;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&control, 0, sizeof(control));
+    iov.iov_base = &handoff;
+    iov.iov_len = sizeof(handoff);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * listenerCount);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * listenerCount);
+    memcpy(CMSG_DATA(cmsg), listeners, sizeof(int) * listenerCount);
+
+    if (sendmsg(sock, &msg, MSG_NOSIGNAL) != sizeof(handoff)
+        || setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &wait, sizeof(wait)) == -1
+        || recv(sock, &taken, sizeof(taken), 0) != sizeof(taken))
+    {
+        return false;
+    }
+
+    return taken;
+}
@@ -0,0 +1,34 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdbool.h>
+
+#include "config.h"
+
+// what the server was told to do
+#define CONTROL_STOP 1
+#define CONTROL_DRAIN 2
+
+// the most listeners that can be handed over, one per worker with reuse port
+#define CONTROL_MAX_LISTENERS 256
+
+// sent along with the listeners so the new server can check that it can use them
+struct listener_handoff
+{
+    int mode;
+    int reusePort;
+    int count;
+};
+
+bool startControl(const struct server_config *config);
+void stopControl();
+int inheritedListener(const int index);
+bool registerListener(const int fd);
+int awaitControl();
+void startDraining();
+bool serverDraining();
+int drainFd();
+int receiveListeners(const struct server_config *config, int *fds);
+bool sendListeners(const int sock);
+
+#endif // CONTROL_H
@@ -5,8 +5,18 @@
 --
 -- FUNCTIONS:
 --                         void *eventLoop(void *args)
---                         void runEpoll(int listenSocket, const int bufferLength)
---                         void epollSignalHandler(int sig)
+--                         bool serviceConnection(const int epoll_fd, struct connection *conn, const uint32_t events,
+--                                                char *buf, const int len, const int *echoPipe)
+--                         bool serviceFiber(const int epoll_fd, struct connection *conn, const uint32_t events)
+--                         void serveFiber(void *arg)
+--                         bool watchWritable(const int epoll_fd, struct connection *conn, const bool wantWrite)
+--                         bool acceptClients(const int epoll_fd, const event_loop_args *args, struct timer_wheel *wheel)
+--                         void scheduleTimeout(struct timer_wheel *wheel, struct connection *conn,
+--                                              const event_loop_args *args)
+--                         void expireConnection(struct wheel_timer *timer, void *arg)
+--                         void runEpoll(int listenSocket, const struct server_config *config)
+--                         void createReusePortListeners(event_loop_args *args, const int count, const struct server_config *config)
+--                         void drainConnections(const uint64_t start, const size_t total, const int timeout)
 --
 -- DATE:                   Feb 19, 2019
 --
@@ -17,8 +27,10 @@
 -- PROGRAMMERS:            William Murphy
 --
 -- NOTES:
--- Contains all functions for running the server in epoll mode.
+-- Contains all functions for running the server in epoll mode, and in fiber mode, which is epoll
+-- mode with every connection run on a fiber of its own.
 ---------------------------------------------------------------------------------------*/
+#define _GNU_SOURCE
 #define _REENTRANT
 #define DCE_COMPAT
 
@@ -28,31 +40,44 @@
 #include <fcntl.h>
 #include <netdb.h>
 #include <pthread.h>
-#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
-#include <sys/sysinfo.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "affinity.h"
+#include "bufpool.h"
+#include "connection.h"
+#include "control.h"
+#include "metrics.h"
+#include "stats.h"
 #include "tools.h"
 #include "net.h"
 
 
 // Globals
 static const int MAX_EVENTS = 256;
-static const int EPOLL_FLAGS = EPOLLIN | EPOLLET | EPOLLEXCLUSIVE;
-
-pthread_t *workers;
+static const int EPOLL_FLAGS = EPOLLIN | EPOLLET;
+static const int DRAIN_TICK_MS = 100;
 
 /*--------------------------------------------------------------------------------------------------
 -- FUNCTION:                eventLoop
 --
 -- DATE:                    Feb 19, 2019
 --
--- REVISIONS:               N/A
+-- REVISIONS:               Oct 17, 2026 - Time accepts, echoes and event batches.
+--                          Oct 17, 2026 - Count into the shared memory stats.
+--                          Oct 17, 2026 - Splice echo through a pipe of the worker.
+--                          Oct 17, 2026 - Zero copy sends and their completions.
+--                          Oct 17, 2026 - Identify clients by generation tagged handles.
+--                          Oct 17, 2026 - Accept in capped runs after the clients of a batch.
+--                          Oct 17, 2026 - Always pin, with memory on the node of the cpu.
+--                          Oct 17, 2026 - Time out connections on a timing wheel.
+--                          Oct 17, 2026 - Drain and return when the server drains.
+--                          Oct 18, 2026 - Resume the fibers of fiber connections.
+--                          Oct 18, 2026 - Finish closing lingering zero copy connections.
 --
 -- DESIGNER:                William Murphy
 --
@@ -64,20 +89,52 @@ pthread_t *workers;
 --
 -- NOTES:
 -- The main function of each worker thread for epoll. Allocates a buffer for storing data and then
--- goes into a forever loop that blocks on epoll_wait and then handles requests accordingly.
+-- goes into a forever loop that blocks on epoll_wait and then handles requests accordingly. The
+-- worker pins itself to its cpu first, so the steering program and the worker agree and its epoll
+-- set, buffers and stats slot are allocated on the numa node it runs on.
+-- The listening socket is registered as CONNECTION_LISTENER, every client with the handle of its
+-- connection, so that an event for a connection closed earlier in the same batch is dropped.
+-- Accepting a connection, echoing what a readable connection sent and handling the whole batch of
+-- events are timed into the worker's metrics. With splice the worker creates the pipe all of its
+-- connections are echoed through, and echoes by copying if it cannot. With zero copy every client
+-- gets SO_ZEROCOPY, and EPOLLERR on a client first means its error queue holds send completions.
+-- A client closed with sends in flight lingers, and its events only finish closing it once they
+-- have all completed.
+-- The listener is accepted from once the clients of the batch are served, and while it may still
+-- hold connections epoll_wait only polls so the worker comes straight back to it. With any timeout
+-- set the worker has a timing wheel whose timerfd is registered as CONNECTION_TIMER. Every connection
+-- it serves gets its deadline pushed back, and the connections whose deadline passed are closed once
+-- the batch is handled.
+-- The drain eventfd of the server is registered as CONNECTION_DRAIN. Once it fires the worker stops
+-- watching the listener, closes every connection whose echo is out as soon as it has served it and
+-- the idle ones evenly over the drain timeout, then closes whatever is left and returns.
+-- In fiber mode a ready connection has its fiber resumed instead of being read from here, see
+-- serviceFiber, and everything else about the connection is the same.
 --------------------------------------------------------------------------------------------------*/
 void *eventLoop(void *args)
 {
     struct epoll_event current_event, event;
     int n_ready;
     int status;
-    struct sockaddr_in remote_addr;
+    bool listenerReady = false;
+    bool timerReady = false;
+    bool draining = false;
+    uint64_t drainStart = 0;
+    size_t drainTotal = 0;
+    struct timer_wheel *wheel = NULL;
     char *local_buffer;
     int epoll_fd;
+    int echoPipe[2] = { -1, -1 };
     struct epoll_event events[MAX_EVENTS];
 
     event_loop_args *ev_args = (event_loop_args *)args;
 
+    // before anything is allocated so that it all lands on the node of the cpu
+    if (!pinWorker(ev_args->cpu))
+    {
+        fprintf(stderr, "pinWorker: could not pin worker to cpu %d\n", ev_args->cpu);
+    }
+
     epoll_fd = epoll_create1(0);
     if (epoll_fd == -1)
     {
@@ -85,7 +142,7 @@ void *eventLoop(void *args)
     }
 
     // Register the server socket for epoll events
-    event.data.fd = ev_args->server_fd;
+    event.data.u64 = CONNECTION_LISTENER;
     event.events = EPOLLIN | EPOLLET;
     status = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ev_args->server_fd, &event);
     if (status == -1)
@@ -93,82 +150,591 @@ void *eventLoop(void *args)
         systemFatal("epoll_ctl");
     }
 
+    // level triggered, the worker stops watching it once it drains
+    event.data.u64 = CONNECTION_DRAIN;
+    event.events = EPOLLIN;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, drainFd(), &event) == -1)
+    {
+        systemFatal("epoll_ctl");
+    }
+
     if ((local_buffer = calloc(ev_args->bufLen, sizeof(char))) == NULL)
     {
         systemFatal("calloc");
     }
 
-    while (true)
+    // one timerfd drives the timeouts of all connections of the worker
+    if (ev_args->readTimeout > 0 || ev_args->idleTimeout > 0 || ev_args->writeTimeout > 0)
+    {
+        if ((wheel = createTimerWheel()) == NULL)
+        {
+            systemFatal("createTimerWheel");
+        }
+
+        event.data.u64 = CONNECTION_TIMER;
+        event.events = EPOLLIN | EPOLLET;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wheel->timerFd, &event) == -1)
+        {
+            systemFatal("epoll_ctl");
+        }
+    }
+
+    if (ev_args->splice && pipe2(echoPipe, O_NONBLOCK) == -1)
     {
-        n_ready = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        perror("pipe2");
+        echoPipe[0] = -1;
+    }
+
+    // claim a stats slot up front so that idle workers show up too
+    createLocalStats();
+
+    while (!draining || localConnectionCount() > 0)
+    {
+        uint64_t loopStart;
+
+        // the worker may block now, so it counts no more against the budget than it holds
+        if (!listenerReady)
+        {
+            poolSettle();
+        }
+
+        // a listener that still has connections waiting gives no new edge, so only peek, and a
+        // draining worker wakes up to close its idle connections a few at a time
+        n_ready = epoll_wait(epoll_fd, events, MAX_EVENTS, listenerReady ? 0 : draining ? DRAIN_TICK_MS : -1);
         if (n_ready == -1)
         {
             systemFatal("epoll_wait");
         }
+        loopStart = metricsNow();
 
         // A file descriptor is ready
         for (int i = 0; i < n_ready; ++i)
         {
-            int client_fd;
+            struct connection *conn;
+            uint64_t start = metricsNow();
             current_event = events[i];
-            // An error or hangup occurred
-            // Client might have closed their side of the connection
-            if (current_event.events & (EPOLLHUP | EPOLLERR))
+
+            // Accept after the clients of this batch are handled
+            if (current_event.data.u64 == CONNECTION_LISTENER)
             {
-                fprintf(stderr, "epoll: EPOLLERR or EPOLLHUP\n");
-                close(current_event.data.fd);
+                listenerReady = !draining;
                 continue;
             }
-
-            // The server is receiving a connection request
-            if (current_event.data.fd == ev_args->server_fd)
+            else if (current_event.data.u64 == CONNECTION_TIMER)
             {
-                if (!acceptNewConnection(ev_args->server_fd, &client_fd, &remote_addr))
-                {
-                    perror("acceptNewConnection");
-                    break;
-                }
-
-                if (!setSocketToNonBlocking(client_fd))
+                timerReady = true;
+                continue;
+            }
+            else if (current_event.data.u64 == CONNECTION_DRAIN)
+            {
+                // leave the listener to the other workers or to the new server
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, ev_args->server_fd, NULL);
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, drainFd(), NULL);
+                listenerReady = false;
+                draining = true;
+                drainStart = metricsNow();
+                drainTotal = localConnectionCount();
+                continue;
+            }
+            else
+            {
+                // closed earlier in this batch
+                if ((conn = lookupConnection(current_event.data.u64)) == NULL)
                 {
-                    perror("setSocketToNonBlocking");
-                    close(client_fd);
                     continue;
                 }
 
-                if (!setSocketTimeout(10, 0, client_fd))
+                // closed already, it only waits for its zero copy sends to complete
+                if (conn->lingering)
                 {
-                    perror("setSocketTimeout");
-                    close(client_fd);
+                    if (!completeZeroCopy(conn) || conn->inflightCount == 0)
+                    {
+                        destroyConnection(conn);
+                    }
                     continue;
                 }
 
-                // Add the client socket to the epoll instance
-                event.data.fd = client_fd;
-                event.events = EPOLL_FLAGS;
-                status = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &event);
-                if (status == -1)
+                // zero copy completions are reported as errors
+                if ((current_event.events & EPOLLERR) && conn->zeroCopyThreshold > 0)
                 {
-                    close(client_fd);
-                    if (errno == EBADF) // this is a hack
+                    if (!completeZeroCopy(conn))
                     {
+                        destroyConnection(conn);
                         continue;
                     }
-                    systemFatal("epoll_ctl");
+                    current_event.events &= ~EPOLLERR;
                 }
-            }
-            else
-            {
-                if (clearSocket(current_event.data.fd, local_buffer, ev_args->bufLen) == -1)
+
+                // An error or hangup occurred
+                // Client might have closed their side of the connection
+                if (current_event.events & (EPOLLHUP | EPOLLERR))
+                {
+                    fprintf(stderr, "epoll: EPOLLERR or EPOLLHUP\n");
+                    statsAdd(STAT_ERRORS, 1);
+                    destroyConnection(conn);
+                    continue;
+                }
+
+                if (conn->fiber != NULL ? !serviceFiber(epoll_fd, conn, current_event.events)
+                                        : !serviceConnection(epoll_fd, conn, current_event.events, local_buffer,
+                                                             ev_args->bufLen, echoPipe[0] != -1 ? echoPipe : NULL))
+                {
+                    destroyConnection(conn);
+                    continue;
+                }
+                if (current_event.events & EPOLLIN)
                 {
-                    close(current_event.data.fd);
+                    metricsRecord(METRIC_SERVICE, metricsNow() - start);
+                }
+
+                // a draining worker lets a connection go as soon as its echo is out
+                if (draining && pendingOutput(conn) == 0 && !conn->writeBlocked)
+                {
+                    destroyConnection(conn);
+                    continue;
                 }
+                scheduleTimeout(wheel, conn, ev_args);
             }
         }
+
+        if (listenerReady)
+        {
+            listenerReady = acceptClients(epoll_fd, ev_args, wheel);
+        }
+
+        if (timerReady)
+        {
+            statsAdd(STAT_TIMEOUTS, wheelAdvance(wheel, expireConnection, NULL));
+            timerReady = false;
+        }
+
+        if (draining)
+        {
+            drainConnections(drainStart, drainTotal, ev_args->drainTimeout);
+        }
+
+        metricsRecord(METRIC_LOOP, metricsNow() - loopStart);
+        statsAdd(STAT_LOOPS, 1);
     }
 
+    if (echoPipe[0] != -1)
+    {
+        close(echoPipe[0]);
+        close(echoPipe[1]);
+    }
+    if (wheel != NULL)
+    {
+        destroyTimerWheel(wheel);
+    }
+    if (ev_args->fibers)
+    {
+        releaseLocalFibers();
+    }
     free(local_buffer);
     close(epoll_fd);
+
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                serviceConnection
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Splice when the worker has a pipe.
+--                          Oct 17, 2026 - Note that the connection has sent data.
+--                          Oct 17, 2026 - Hand reads to the protocol handler, echo in the kernel only
+--                                         with splice or zero copy.
+--                          Oct 18, 2026 - Register EPOLLOUT with watchWritable.
+--                          Oct 18, 2026 - Only flush a closing connection, and close it once it is out.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool serviceConnection(const int epoll_fd, struct connection *conn,
+--                                                 const uint32_t events, char *buf, const int len,
+--                                                 const int *echoPipe)
+--                              const int epoll_fd: The epoll instance of the worker.
+--                              struct connection *conn: The connection that is ready.
+--                              const uint32_t events: The ready events.
+--                              char *buf: The buffer of the worker.
+--                              const int len: The length of buf.
+--                              const int *echoPipe: The pipe to splice through, NULL to copy.
+--
+-- RETURNS:                 False if the connection should be closed, true otherwise.
+--
+-- NOTES:
+-- Flushes pending output if the socket became writable and tells the handler once it is all out,
+-- then drains the socket if it is readable or reading was paused for backpressure. Reads go to the
+-- handler, unless the worker echoes with splice or the connection with zero copy, which only the
+-- echo handler can be used with. EPOLLOUT is only registered while output is pending. A connection
+-- the handler gave up is not read from again and is closed once its last output is flushed.
+--------------------------------------------------------------------------------------------------*/
+bool serviceConnection(const int epoll_fd, struct connection *conn, const uint32_t events, char *buf, const int len,
+                       const int *echoPipe)
+{
+    if (events & EPOLLOUT)
+    {
+        if (!flushConnection(conn)
+            || (pendingOutput(conn) == 0 && (conn->closing || !handlerWritable(&conn->handlerConn))))
+        {
+            return false;
+        }
+    }
+
+    // a closing connection has its reading side shut down and only finishes writing
+    if (!conn->closing && ((events & EPOLLIN) || conn->readBlocked))
+    {
+        bool open;
+
+        conn->hasRead = true;
+        if (echoPipe != NULL)
+        {
+            open = spliceConnection(conn, echoPipe, buf, len);
+        }
+        else if (conn->zeroCopyThreshold > 0)
+        {
+            open = echoConnection(conn, buf, len);
+        }
+        else
+        {
+            open = readConnection(conn, buf, len);
+        }
+
+        if (!open)
+        {
+            return false;
+        }
+    }
+
+    return watchWritable(epoll_fd, conn, pendingOutput(conn) > 0);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                serviceFiber
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool serviceFiber(const int epoll_fd, struct connection *conn, const uint32_t events)
+--                              const int epoll_fd: The epoll instance of the worker.
+--                              struct connection *conn: The fiber connection that is ready.
+--                              const uint32_t events: The ready events.
+--
+-- RETURNS:                 False if the connection should be closed, true otherwise.
+--
+-- NOTES:
+-- Resumes the fiber of the connection if the socket became ready for what it waits on, writing if
+-- it is blocked on a write and reading otherwise. Events it does not wait on are dropped, the fiber
+-- tries the socket before it waits on it again. EPOLLOUT is only registered while the fiber waits
+-- to write.
+--------------------------------------------------------------------------------------------------*/
+bool serviceFiber(const int epoll_fd, struct connection *conn, const uint32_t events)
+{
+    if ((events & (conn->writeBlocked ? EPOLLOUT : EPOLLIN)) && !resumeFiber(conn->fiber))
+    {
+        return false;
+    }
+
+    return watchWritable(epoll_fd, conn, conn->writeBlocked);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                serveFiber
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Let a handler with onFiber read for itself.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void serveFiber(void *arg)
+--                              void *arg: The connection the fiber runs.
+--
+-- NOTES:
+-- The whole life of a fiber connection, written as if its socket blocked. Starts the handler, then
+-- reads into the buffer of the fiber and hands every read to the handler, whose writes return once
+-- they are sent. A handler with onFiber is left to read for itself with handlerRead instead. Returns
+-- when the peer closes, the socket fails or the handler closes the connection, and the worker
+-- destroys the connection.
+--------------------------------------------------------------------------------------------------*/
+void serveFiber(void *arg)
+{
+    struct connection *conn = (struct connection *)arg;
+    char *buf = conn->fiber->buffer;
+    size_t len = conn->fiber->bufferLength;
+    ssize_t n;
+
+    if (!handlerAccept(&conn->handlerConn))
+    {
+        return;
+    }
+
+    // the handler reads for itself
+    if (conn->handlerConn.handler->onFiber != NULL)
+    {
+        handlerFiber(&conn->handlerConn);
+        return;
+    }
+
+    while ((n = receiveOnFiber(conn, buf, len)) > 0)
+    {
+        if (!handlerData(&conn->handlerConn, buf, n))
+        {
+            return;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                watchWritable
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool watchWritable(const int epoll_fd, struct connection *conn, const bool wantWrite)
+--                              const int epoll_fd: The epoll instance of the worker.
+--                              struct connection *conn: A registered connection.
+--                              const bool wantWrite: Whether the connection waits for the socket to have room.
+--
+-- RETURNS:                 False if the registration could not be changed, true otherwise.
+--
+-- NOTES:
+-- Adds or removes EPOLLOUT from the events of the connection, only calling epoll_ctl if that changes them.
+--------------------------------------------------------------------------------------------------*/
+bool watchWritable(const int epoll_fd, struct connection *conn, const bool wantWrite)
+{
+    struct epoll_event event;
+
+    if (wantWrite == conn->wantWrite)
+    {
+        return true;
+    }
+
+    event.data.u64 = connectionHandle(conn);
+    event.events = EPOLL_FLAGS | (wantWrite ? EPOLLOUT : 0);
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &event) == -1)
+    {
+        return false;
+    }
+    conn->wantWrite = wantWrite;
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                acceptClients
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Start the protocol handler of every connection.
+--                          Oct 18, 2026 - Start the fiber of every connection in fiber mode.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool acceptClients(const int epoll_fd, const event_loop_args *args,
+--                                                 struct timer_wheel *wheel)
+--                              const int epoll_fd: The epoll instance of the worker.
+--                              const event_loop_args *args: The arguments of the worker.
+--                              struct timer_wheel *wheel: The timing wheel of the worker, NULL for none.
+--
+-- RETURNS:                 True if the cap was reached with connections possibly still waiting.
+--
+-- NOTES:
+-- Accepts connections from the listener of the worker until it runs dry or args->acceptCap of them
+-- have been accepted, so that a connect storm cannot starve the clients the worker already has. The
+-- listener is edge triggered and gives no new edge for connections left waiting, so a worker that hit
+-- the cap must call this again after its next batch of events. The sockets come out of accept4
+-- non-blocking already. Running out of fds also ends the run, the next connect retries. Every new
+-- connection starts with the read timeout, instead of the SO_RCVTIMEO that a non-blocking socket
+-- ignores. The handler of the worker is started on every connection, and a connection it refuses is
+-- closed before it is registered. In fiber mode the connection gets a fiber from the pool instead,
+-- which starts the handler and runs until it first has to wait. A connection the pool has no fiber
+-- left for is closed.
+--------------------------------------------------------------------------------------------------*/
+bool acceptClients(const int epoll_fd, const event_loop_args *args, struct timer_wheel *wheel)
+{
+    statsAdd(STAT_ACCEPT_BATCHES, 1);
+
+    for (int accepted = 0; accepted < args->acceptCap; accepted++)
+    {
+        int client_fd;
+        struct sockaddr_in remote_addr;
+        struct connection *conn;
+        struct epoll_event event;
+        uint64_t start = metricsNow();
+
+        if (!acceptNewConnection(args->server_fd, &client_fd, &remote_addr, SOCK_NONBLOCK | SOCK_CLOEXEC))
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                statsAdd(STAT_EAGAINS, 1);
+                return false;
+            }
+            // the client gave up while it waited in the backlog
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            perror("acceptNewConnection");
+            statsAdd(STAT_ERRORS, 1);
+            return false;
+        }
+        statsAdd(STAT_ACCEPTS, 1);
+
+        if ((conn = createConnection(client_fd)) == NULL)
+        {
+            perror("createConnection");
+            statsAdd(STAT_ERRORS, 1);
+            statsAdd(STAT_CLOSES, 1);
+            close(client_fd);
+            continue;
+        }
+
+        // without the flag the connection just copies
+        if (args->zeroCopyThreshold > 0 && setSocketZeroCopy(client_fd))
+        {
+            conn->zeroCopyThreshold = args->zeroCopyThreshold;
+        }
+
+        conn->handlerConn.fd = client_fd;
+        conn->handlerConn.handler = args->handler;
+        conn->handlerConn.write = args->fibers ? writeOnFiber : writeConnection;
+        conn->handlerConn.read = args->fibers ? readOnFiber : NULL;
+        if (args->fibers)
+        {
+            // runs until the connection first has to wait
+            if ((conn->fiber = createFiber(serveFiber, conn)) == NULL)
+            {
+                perror("createFiber");
+                statsAdd(STAT_ERRORS, 1);
+                destroyConnection(conn);
+                continue;
+            }
+            if (!resumeFiber(conn->fiber))
+            {
+                destroyConnection(conn);
+                continue;
+            }
+        }
+        else if (!handlerAccept(&conn->handlerConn))
+        {
+            destroyConnection(conn);
+            continue;
+        }
+
+        // Add the client socket to the epoll instance, with what the handler could not write yet
+        conn->wantWrite = pendingOutput(conn) > 0 || conn->writeBlocked;
+        event.data.u64 = connectionHandle(conn);
+        event.events = EPOLL_FLAGS | (conn->wantWrite ? EPOLLOUT : 0);
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &event) == -1)
+        {
+            perror("epoll_ctl");
+            statsAdd(STAT_ERRORS, 1);
+            destroyConnection(conn);
+            continue;
+        }
+
+        scheduleTimeout(wheel, conn, args);
+
+        metricsRecord(METRIC_ACCEPT, metricsNow() - start);
+    }
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                scheduleTimeout
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - The write timeout for a fiber waiting to write.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void scheduleTimeout(struct timer_wheel *wheel, struct connection *conn,
+--                                               const event_loop_args *args)
+--                              struct timer_wheel *wheel: The timing wheel of the worker, NULL for none.
+--                              struct connection *conn: The connection that was just served.
+--                              const event_loop_args *args: The arguments of the worker.
+--
+-- NOTES:
+-- Restarts the timeout of the connection from now, picked by the state it was left in. A connection
+-- with output pending or a fiber waiting to write has the write timeout, since the peer is not reading, one that has not sent
+-- anything yet the read timeout and any other the idle timeout. A timeout of 0 never fires.
+--------------------------------------------------------------------------------------------------*/
+void scheduleTimeout(struct timer_wheel *wheel, struct connection *conn, const event_loop_args *args)
+{
+    int timeout;
+
+    if (wheel == NULL)
+    {
+        return;
+    }
+
+    if (pendingOutput(conn) > 0 || conn->writeBlocked)
+    {
+        timeout = args->writeTimeout;
+    }
+    else if (!conn->hasRead)
+    {
+        timeout = args->readTimeout;
+    }
+    else
+    {
+        timeout = args->idleTimeout;
+    }
+
+    if (timeout > 0)
+    {
+        wheelSchedule(wheel, &conn->timer, wheelTicks(timeout));
+    }
+    else
+    {
+        wheelCancel(&conn->timer);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                expireConnection
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void expireConnection(struct wheel_timer *timer, void *arg)
+--                              struct wheel_timer *timer: The timer of a connection that timed out.
+--                              void *arg: Unused.
+--
+-- NOTES:
+-- Called by the timing wheel for every connection whose timeout passed. Closes the connection.
+--------------------------------------------------------------------------------------------------*/
+void expireConnection(struct wheel_timer *timer, void *arg)
+{
+    struct connection *conn = (struct connection *)((char *)timer - offsetof(struct connection, timer));
+
+    destroyConnection(conn);
 }
 
 /*--------------------------------------------------------------------------------------------------
@@ -176,78 +742,203 @@ void *eventLoop(void *args)
 --
 -- DATE:                    Feb 19, 2019
 --
--- REVISIONS:               N/A
+-- REVISIONS:               Oct 17, 2026 - Per worker reuse port listeners.
+--                          Oct 17, 2026 - The configured number of workers, each on its own cpu.
+--                          Oct 17, 2026 - Wait for the server to be stopped or drained.
+--                          Oct 17, 2026 - Pass on the protocol handler.
+--                          Oct 18, 2026 - Pass on fiber mode.
 --
 -- DESIGNER:                William Murphy
 --
 -- PROGRAMMER:              William Murphy
 --
--- INTERFACE:               void runEpoll(int listenSocket, const int bufferLength)
+-- INTERFACE:               void runEpoll(int listenSocket, const struct server_config *config)
+--                              int listenSocket: The shared listening socket, unused with reuse port.
+--                              const struct server_config *config: The server configuration.
 --
 -- NOTES:
--- The main entry point for epoll mode. Prepares the arguments for epoll and then spawns one worker
--- thread per cpu and waits for all workers to exit.
+-- The main entry point for epoll mode. Prepares the arguments for epoll and then spawns the workers,
+-- each given the cpu it runs on, and waits for all workers to exit. With reuse port every worker gets its own
+-- listener, otherwise they all share listenSocket. Stopping the server cancels the workers, while
+-- draining it is up to the workers, which watch the drain eventfd and return when they are done.
 --------------------------------------------------------------------------------------------------*/
-void runEpoll(int listenSocket, const int bufferLength)
+void runEpoll(int listenSocket, const struct server_config *config)
 {
-    event_loop_args *args = calloc(1, sizeof(event_loop_args));
+    event_loop_args *args;
+    pthread_t *workers;
+    int nWorkers = config->workers;
 
-    signal(SIGINT, epollSignalHandler);
+    if ((args = calloc(nWorkers, sizeof(event_loop_args))) == NULL)
+    {
+        systemFatal("calloc");
+    }
 
-    args->server_fd = listenSocket;
+    for (int i = 0; i < nWorkers; i++)
+    {
+        args[i].server_fd = listenSocket;
+        args[i].bufLen = (size_t)config->bufferLength;
+        args[i].cpu = config->workerCpus[i];
+        args[i].splice = config->splice;
+        args[i].zeroCopyThreshold = config->zeroCopyThreshold;
+        args[i].acceptCap = config->acceptCap;
+        args[i].readTimeout = config->readTimeout;
+        args[i].idleTimeout = config->idleTimeout;
+        args[i].writeTimeout = config->writeTimeout;
+        args[i].drainTimeout = config->drainTimeout;
+        args[i].fibers = config->fibers;
+        args[i].handler = config->handler;
+    }
 
-    if (!setSocketToNonBlocking(args->server_fd))
+    if (config->reusePort)
+    {
+        createReusePortListeners(args, nWorkers, config);
+    }
+    else if (!setSocketToNonBlocking(listenSocket))
     {
         systemFatal("setSocketToNonBlocking");
     }
 
-    args->bufLen = (size_t)bufferLength;
-
-    if ((workers = calloc(get_nprocs(), sizeof(pthread_t))) == NULL)
+    if ((workers = calloc(nWorkers, sizeof(pthread_t))) == NULL)
     {
         systemFatal("calloc");
     }
 
     // Start the event loop
-    for (int i = 0; i < get_nprocs(); i++)
+    for (int i = 0; i < nWorkers; i++)
     {
-        if (pthread_create(workers + i, NULL, eventLoop, (void *)args))
+        if (pthread_create(workers + i, NULL, eventLoop, (void *)(args + i)))
         {
             systemFatal("pthread_create");
         }
     }
-    for (int i = 0; i < get_nprocs(); i++)
+
+    if (awaitControl() == CONTROL_STOP)
+    {
+        for (int i = 0; i < nWorkers; i++)
+        {
+            pthread_cancel(workers[i]);
+        }
+    }
+
+    for (int i = 0; i < nWorkers; i++)
     {
         pthread_join(workers[i], NULL);
     }
 
-    //eventLoop((void*) args);
+    if (config->reusePort)
+    {
+        for (int i = 0; i < nWorkers; i++)
+        {
+            close(args[i].server_fd);
+        }
+    }
 
+    free(workers);
     free(args);
 }
 
 /*--------------------------------------------------------------------------------------------------
--- FUNCTION:                epollSignalHandler
+-- FUNCTION:                createReusePortListeners
 --
--- DATE:                    Feb 19, 2019
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Listen with the configured backlog.
+--                          Oct 17, 2026 - Steer to the cpus the workers are pinned to.
+--                          Oct 17, 2026 - Take over the listeners of an old server.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void createReusePortListeners(event_loop_args *args, const int count,
+--                                                        const struct server_config *config)
+--                              event_loop_args *args: The worker arguments to fill in.
+--                              const int count: The number of workers.
+--                              const struct server_config *config: The server configuration.
+--
+-- NOTES:
+-- Creates one non-blocking SO_REUSEPORT listener per worker. The listeners are created and put into
+-- the listening state in worker order so that listener i sits at index i of the reuse port group.
+-- When cpu steering is on, the steering program is attached to the group with the cpu of every
+-- worker so that a connection received on the cpu of worker i is accepted by worker i. Listeners
+-- handed over by an old server are in the same order and keep the steering program of the group.
+--------------------------------------------------------------------------------------------------*/
+void createReusePortListeners(event_loop_args *args, const int count, const struct server_config *config)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if ((args[i].server_fd = inheritedListener(i)) != -1)
+        {
+            continue;
+        }
+
+        if (!createBoundSocket(&args[i].server_fd, config->port, true))
+        {
+            systemFatal("createBoundSocket");
+        }
+
+        if (!setSocketToNonBlocking(args[i].server_fd))
+        {
+            systemFatal("setSocketToNonBlocking");
+        }
+
+        if (listen(args[i].server_fd, config->backlog) == -1)
+        {
+            systemFatal("listen");
+        }
+    }
+
+    if (config->steerToCpu && inheritedListener(0) == -1
+        && !attachReusePortSteering(args[0].server_fd, config->workerCpus, count))
+    {
+        systemFatal("attachReusePortSteering");
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!registerListener(args[i].server_fd))
+        {
+            systemFatal("registerListener");
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                drainConnections
+--
+-- DATE:                    Oct 17, 2026
 --
 -- REVISIONS:               N/A
 --
--- DESIGNER:                William Murphy
+-- DESIGNER:                Benny Wang
 --
--- PROGRAMMER:              William Murphy
+-- PROGRAMMER:              Benny Wang
 --
--- INTERFACE:               void epollSignalHandler(int sig)
---                              int sig: The signal that was caught.
+-- INTERFACE:               void drainConnections(const uint64_t start, const size_t total, const int timeout)
+--                              const uint64_t start: When the worker started to drain, from metricsNow.
+--                              const size_t total: The connections it had then.
+--                              const int timeout: Seconds the drain may take.
 --
 -- NOTES:
--- Callback function to catch SIGINT. Kills all the worker threads.
+-- Closes idle connections of the calling worker so that the share still open falls evenly from all of
+-- them to none over the timeout. Closing them all at once would have all of their clients reconnect
+-- at once. Once the timeout has passed every connection is closed, echo written or not.
 --------------------------------------------------------------------------------------------------*/
-void epollSignalHandler(int sig)
+void drainConnections(const uint64_t start, const size_t total, const int timeout)
 {
-    fprintf(stdout, "Stopping server\n");
-    for (int i = 0; i < get_nprocs(); i++)
+    uint64_t elapsed = metricsNow() - start;
+    uint64_t span = (uint64_t)timeout * 1000000000;
+    size_t keep;
+
+    if (elapsed >= span)
+    {
+        closeLocalConnections(SIZE_MAX, true);
+        return;
+    }
+
+    keep = total - total * elapsed / span;
+    if (localConnectionCount() > keep)
     {
-       pthread_cancel(workers[i]);
+        closeLocalConnections(localConnectionCount() - keep, false);
     }
 }
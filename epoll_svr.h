@@ -1,15 +1,43 @@
 #ifndef EPOLL_SVR_H
 #define EPOLL_SVR_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "connection.h"
+#include "handler.h"
+#include "timerwheel.h"
+
 typedef struct
 {
     int nClients;
     int server_fd;
     int bufLen;
+    int cpu;
+    bool splice;
+    int zeroCopyThreshold;
+    int acceptCap;
+    int readTimeout;
+    int idleTimeout;
+    int writeTimeout;
+    int drainTimeout;
+    // run every connection on a fiber of its own
+    bool fibers;
+    const struct protocol_handler *handler;
 } event_loop_args;
 
 void *eventLoop(void *args);
-void runEpoll(int listenSocket, const int bufferLength);
-void epollSignalHandler(int sig);
+bool serviceConnection(const int epoll_fd, struct connection *conn, const uint32_t events, char *buf, const int len,
+                       const int *echoPipe);
+bool serviceFiber(const int epoll_fd, struct connection *conn, const uint32_t events);
+void serveFiber(void *arg);
+bool watchWritable(const int epoll_fd, struct connection *conn, const bool wantWrite);
+bool acceptClients(const int epoll_fd, const event_loop_args *args, struct timer_wheel *wheel);
+void scheduleTimeout(struct timer_wheel *wheel, struct connection *conn, const event_loop_args *args);
+void expireConnection(struct wheel_timer *timer, void *arg);
+void runEpoll(int listenSocket, const struct server_config *config);
+void createReusePortListeners(event_loop_args *args, const int count, const struct server_config *config);
+void drainConnections(const uint64_t start, const size_t total, const int timeout);
 
 #endif // EPOLL_SVR_H
@@ -0,0 +1,581 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            fiber.c
+--
+-- PROGRAM:                server.out
+--
+-- FUNCTIONS:
+--                         bool startFiberPool(const size_t limit, const int workers, const size_t stackSize,
+--                                             const size_t bufferSize)
+--                         void stopFiberPool()
+--                         void releaseLocalFibers()
+--                         struct fiber *createFiber(void (*entry)(void *arg), void *arg)
+--                         void releaseFiber(struct fiber *fiber)
+--                         bool resumeFiber(struct fiber *fiber)
+--                         void yieldFiber()
+--                         void fiberStart()
+--                         void fiberSwitch(void **save, void *load)
+--                         void guardFault(int sig, siginfo_t *info, void *context)
+--
+-- DATE:                   Oct 18, 2026
+--
+-- REVISIONS:              Oct 18, 2026 - Share free slots past the warm ones, count the limit across workers.
+--                         Oct 18, 2026 - A guard page below every stack instead of the zero line.
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- User space fibers on pooled stacks, for code that reads like it blocks run by an event loop.
+--
+-- A worker resumes a fiber, which runs on a stack of its own until it yields back to the worker or
+-- returns. Only the worker ever resumes a fiber and a fiber only ever yields back to the worker that
+-- resumed it, so switching never needs a scheduler. On x86_64 fiberSwitch saves the callee saved
+-- registers on the current stack and swaps the stack pointer, a few instructions and no syscall.
+-- Elsewhere it falls back to swapcontext, which also saves the signal mask with a syscall.
+--
+-- The stacks of all fibers the server may have at once are reserved as one mapping when the server
+-- starts, so the pool can never take more than its slots however many connections arrive, and a
+-- slot of it only takes memory once its pages are touched. Every slot holds the stack, the buffer of
+-- the fiber and the struct fiber itself at the top, so a fiber with a small buffer that calls a few
+-- functions deep only ever touches the top page of its slot. Below the stack every slot starts with
+-- a page that cannot be touched, so a fiber that runs past the end of its stack faults before it
+-- writes a byte of the slot below, and the SIGSEGV handler stops the server with a message to raise
+-- the stack. The handler runs on a stack of the worker's own, as the fiber has none left. Every
+-- guard page splits the mapping, so each slot takes two of vm.max_map_count. Transparent huge pages
+-- are turned off for the mapping, or every stack touched would take 2MB.
+--
+-- Every worker keeps up to FIBER_WARM_STACKS slots its fibers are done with on a list of its own and
+-- hands them out again first, so creating a fiber mostly takes no lock. Any further slot it frees has
+-- its memory given back to the kernel and goes on a list shared by all workers, under a lock, which
+-- is taken from next. Unused slots are handed out in order with an atomic counter. The limit counts
+-- the fibers of all workers with an atomic counter of its own, and the pool holds FIBER_WARM_STACKS
+-- slots per worker on top of it, so however the free slots are spread over the workers there is
+-- always a slot for a fiber within the limit.
+---------------------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+
+#include "fiber.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static char *region = NULL;
+static size_t regionSize = 0;
+static size_t slotSize = 0;
+static size_t guardSize = 0;
+static size_t slotCount = 0;
+static size_t nextSlot = 0;
+static size_t fiberLimit = 0;
+static size_t liveFibers = 0;
+static size_t headerSize = 0;
+static size_t bufferLength = 0;
+static size_t bufferSpace = 0;
+static pthread_mutex_t sharedLock = PTHREAD_MUTEX_INITIALIZER;
+static char **sharedSlots = NULL;
+static size_t sharedCount = 0;
+static __thread char *freeSlots[FIBER_WARM_STACKS];
+static __thread size_t freeCount = 0;
+static __thread char *signalStack = NULL;
+static __thread struct fiber *running = NULL;
+#if defined(__x86_64__)
+static __thread void *workerContext = NULL;
+#else
+static __thread ucontext_t workerContext;
+#endif
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                fiberSwitch
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void fiberSwitch(void **save, void *load)
+--                              void **save: Set to the stack pointer to come back to.
+--                              void *load: A stack pointer saved by fiberSwitch or set up by createFiber.
+--
+-- NOTES:
+-- Pushes the callee saved registers, saves the stack pointer, loads the other one and pops its
+-- registers, returning on the other stack. Everything else the caller expects to be clobbered by a
+-- call.
+--------------------------------------------------------------------------------------------------*/
+#if defined(__x86_64__)
+__asm__(".text\n"
+        ".globl fiberSwitch\n"
+        ".type fiberSwitch, @function\n"
+        "fiberSwitch:\n"
+        "    pushq %rbp\n"
+        "    pushq %rbx\n"
+        "    pushq %r12\n"
+        "    pushq %r13\n"
+        "    pushq %r14\n"
+        "    pushq %r15\n"
+        "    movq %rsp, (%rdi)\n"
+        "    movq %rsi, %rsp\n"
+        "    popq %r15\n"
+        "    popq %r14\n"
+        "    popq %r13\n"
+        "    popq %r12\n"
+        "    popq %rbx\n"
+        "    popq %rbp\n"
+        "    ret\n"
+        ".size fiberSwitch, .-fiberSwitch\n");
+#endif
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                startFiberPool
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Slots for the warm lists of the workers on top of the limit.
+--                          Oct 18, 2026 - A guard page at the bottom of every slot.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool startFiberPool(const size_t limit, const int workers, const size_t stackSize,
+--                                              const size_t bufferSize)
+--                              const size_t limit: The most fibers all workers may have at once.
+--                              const int workers: The number of workers that run fibers.
+--                              const size_t stackSize: The bytes of stack of every fiber.
+--                              const size_t bufferSize: The bytes of buffer of every fiber.
+--
+-- RETURNS:                 True if the stacks were reserved, false otherwise.
+--
+-- NOTES:
+-- Reserves the slots of all fibers without touching them, and the shared list they may all end up
+-- on, then protects the guard page of every slot and catches the faults on them. Must be called
+-- before any worker starts. Fails with a message if the guard pages need more mappings than
+-- vm.max_map_count allows.
+--------------------------------------------------------------------------------------------------*/
+bool startFiberPool(const size_t limit, const int workers, const size_t stackSize, const size_t bufferSize)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    struct sigaction action;
+
+    headerSize = (sizeof(struct fiber) + 63) & ~(size_t)63;
+    bufferLength = bufferSize;
+    bufferSpace = (bufferSize + 63) & ~(size_t)63;
+    guardSize = page;
+    slotSize = guardSize + ((stackSize + bufferSpace + headerSize + page - 1) & ~(page - 1));
+    slotCount = limit + (size_t)workers * FIBER_WARM_STACKS;
+    nextSlot = 0;
+    fiberLimit = limit;
+    liveFibers = 0;
+    sharedCount = 0;
+    regionSize = slotSize * slotCount;
+
+    if ((sharedSlots = malloc(slotCount * sizeof(char *))) == NULL)
+    {
+        return false;
+    }
+
+    region = mmap(NULL, regionSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK,
+                  -1, 0);
+    if (region == MAP_FAILED)
+    {
+        free(sharedSlots);
+        sharedSlots = NULL;
+        region = NULL;
+        return false;
+    }
+
+    // the stacks only ever touch a few pages each
+    madvise(region, regionSize, MADV_NOHUGEPAGE);
+
+    for (size_t i = 0; i < slotCount; i++)
+    {
+        if (mprotect(region + i * slotSize, guardSize, PROT_NONE) == -1)
+        {
+            if (errno == ENOMEM)
+            {
+                fprintf(stderr, "fiber: %zu stacks need a vm.max_map_count of more than %zu, lower -F or raise it\n",
+                        slotCount, slotCount * 2);
+            }
+            stopFiberPool();
+            return false;
+        }
+    }
+
+    // the workers run the handler on a stack of their own, set up with their first fiber
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = guardFault;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGSEGV, &action, NULL) == -1)
+    {
+        stopFiberPool();
+        return false;
+    }
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                stopFiberPool
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void stopFiberPool()
+--
+-- NOTES:
+-- Unmaps the stacks. Must be called once the workers have stopped.
+--------------------------------------------------------------------------------------------------*/
+void stopFiberPool()
+{
+    if (region != NULL)
+    {
+        munmap(region, regionSize);
+        region = NULL;
+        regionSize = 0;
+    }
+    free(sharedSlots);
+    sharedSlots = NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                releaseLocalFibers
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Hand the free slots to the other workers.
+--                          Oct 18, 2026 - Free the signal stack.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void releaseLocalFibers()
+--
+-- NOTES:
+-- Moves the free slots of the calling worker to the shared list once it has no fibers left, so the
+-- workers still running can have them, and frees the stack its signals ran on.
+--------------------------------------------------------------------------------------------------*/
+void releaseLocalFibers()
+{
+    pthread_mutex_lock(&sharedLock);
+    while (freeCount > 0)
+    {
+        sharedSlots[sharedCount++] = freeSlots[--freeCount];
+    }
+    pthread_mutex_unlock(&sharedLock);
+
+    if (signalStack != NULL)
+    {
+        stack_t none = {.ss_flags = SS_DISABLE};
+
+        sigaltstack(&none, NULL);
+        free(signalStack);
+        signalStack = NULL;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                createFiber
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Count the limit across workers, take shared slots before unused ones.
+--                          Oct 18, 2026 - Start the stack above the guard page, set up the signal stack.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               struct fiber *createFiber(void (*entry)(void *arg), void *arg)
+--                              void (*entry)(void *arg): What the fiber runs.
+--                              void *arg: Passed to entry.
+--
+-- RETURNS:                 The fiber or NULL with errno set to EAGAIN if all workers together have as
+--                          many fibers as the limit.
+--
+-- NOTES:
+-- Sets up a fiber that runs entry the first time it is resumed. The slot is taken from the free
+-- slots of the calling worker if it has any, from the shared list next and from the unused part of
+-- the pool last. Within the limit one of them always has a slot. The first fiber of a worker also
+-- gives it the stack a fault on a guard page is handled on.
+--------------------------------------------------------------------------------------------------*/
+struct fiber *createFiber(void (*entry)(void *arg), void *arg)
+{
+    char *slot = NULL;
+    struct fiber *fiber;
+
+    if (signalStack == NULL)
+    {
+        stack_t stack = {.ss_size = FIBER_SIGNAL_STACK};
+
+        if ((stack.ss_sp = signalStack = malloc(FIBER_SIGNAL_STACK)) == NULL)
+        {
+            return NULL;
+        }
+        if (sigaltstack(&stack, NULL) == -1)
+        {
+            free(signalStack);
+            signalStack = NULL;
+            return NULL;
+        }
+    }
+
+    if (__atomic_add_fetch(&liveFibers, 1, __ATOMIC_RELAXED) > fiberLimit)
+    {
+        __atomic_sub_fetch(&liveFibers, 1, __ATOMIC_RELAXED);
+        errno = EAGAIN;
+        return NULL;
+    }
+
+    if (freeCount > 0)
+    {
+        slot = freeSlots[--freeCount];
+    }
+    else if (__atomic_load_n(&sharedCount, __ATOMIC_RELAXED) > 0)
+    {
+        pthread_mutex_lock(&sharedLock);
+        if (sharedCount > 0)
+        {
+            slot = sharedSlots[--sharedCount];
+        }
+        pthread_mutex_unlock(&sharedLock);
+    }
+
+    if (slot == NULL)
+    {
+        size_t index = __atomic_fetch_add(&nextSlot, 1, __ATOMIC_RELAXED);
+
+        if (index < slotCount)
+        {
+            slot = region + index * slotSize;
+        }
+        else
+        {
+            // a slot went on the shared list after it was looked at
+            pthread_mutex_lock(&sharedLock);
+            if (sharedCount > 0)
+            {
+                slot = sharedSlots[--sharedCount];
+            }
+            pthread_mutex_unlock(&sharedLock);
+        }
+    }
+
+    if (slot == NULL)
+    {
+        __atomic_sub_fetch(&liveFibers, 1, __ATOMIC_RELAXED);
+        errno = EAGAIN;
+        return NULL;
+    }
+
+    fiber = (struct fiber *)(slot + slotSize - headerSize);
+    memset(fiber, 0, sizeof(struct fiber));
+    fiber->stack = slot;
+    fiber->buffer = (char *)fiber - bufferSpace;
+    fiber->bufferLength = bufferLength;
+    fiber->entry = entry;
+    fiber->arg = arg;
+
+#if defined(__x86_64__)
+    {
+        // what fiberSwitch pops on the first switch, the registers and then fiberStart to return to
+        void **sp = (void **)fiber->buffer;
+
+        *--sp = NULL;
+        *--sp = (void *)fiberStart;
+        sp -= 6;
+        memset(sp, 0, 6 * sizeof(void *));
+        fiber->context = sp;
+    }
+#else
+    if (getcontext(&fiber->context) == -1)
+    {
+        releaseFiber(fiber);
+        return NULL;
+    }
+    fiber->context.uc_stack.ss_sp = slot + guardSize;
+    fiber->context.uc_stack.ss_size = fiber->buffer - (slot + guardSize);
+    fiber->context.uc_link = NULL;
+    makecontext(&fiber->context, fiberStart, 0);
+#endif
+
+    return fiber;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                releaseFiber
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Put slots past the warm ones on the shared list.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void releaseFiber(struct fiber *fiber)
+--                              struct fiber *fiber: A fiber of the calling worker that is not running.
+--
+-- NOTES:
+-- Gives the slot of a fiber back to the calling worker, whether the fiber returned or is suspended.
+-- A suspended fiber is simply never resumed, so whatever it holds must be freed by someone else.
+-- Past FIBER_WARM_STACKS free slots the memory of the slot is given back to the kernel and the slot
+-- goes on the shared list.
+--------------------------------------------------------------------------------------------------*/
+void releaseFiber(struct fiber *fiber)
+{
+    char *slot = fiber->stack;
+
+    if (freeCount < FIBER_WARM_STACKS)
+    {
+        freeSlots[freeCount++] = slot;
+    }
+    else
+    {
+        madvise(slot + guardSize, slotSize - guardSize, MADV_DONTNEED);
+
+        pthread_mutex_lock(&sharedLock);
+        sharedSlots[sharedCount++] = slot;
+        pthread_mutex_unlock(&sharedLock);
+    }
+
+    __atomic_sub_fetch(&liveFibers, 1, __ATOMIC_RELAXED);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                resumeFiber
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - The guard page replaces the check of the bottom line.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool resumeFiber(struct fiber *fiber)
+--                              struct fiber *fiber: A fiber of the calling worker.
+--
+-- RETURNS:                 True if the fiber yielded, false if it returned.
+--
+-- NOTES:
+-- Runs the fiber until it yields or returns. Cancelling the worker is held off while it runs, as
+-- unwinding could not get off the stack of the fiber.
+--------------------------------------------------------------------------------------------------*/
+bool resumeFiber(struct fiber *fiber)
+{
+    int cancelState;
+
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancelState);
+    running = fiber;
+#if defined(__x86_64__)
+    fiberSwitch(&workerContext, fiber->context);
+#else
+    swapcontext(&workerContext, &fiber->context);
+#endif
+    running = NULL;
+    pthread_setcancelstate(cancelState, NULL);
+
+    return !fiber->done;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                yieldFiber
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void yieldFiber()
+--
+-- NOTES:
+-- Suspends the running fiber and goes back to the worker that resumed it. Returns once the worker
+-- resumes the fiber again. Must only be called on a fiber.
+--------------------------------------------------------------------------------------------------*/
+void yieldFiber()
+{
+    struct fiber *fiber = running;
+
+#if defined(__x86_64__)
+    fiberSwitch(&fiber->context, workerContext);
+#else
+    swapcontext(&fiber->context, &workerContext);
+#endif
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                fiberStart
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void fiberStart()
+--
+-- NOTES:
+-- The bottom frame of every fiber. Runs its entry and marks it done, then leaves it for good.
+--------------------------------------------------------------------------------------------------*/
+void fiberStart()
+{
+    struct fiber *fiber = running;
+
+    fiber->entry(fiber->arg);
+    fiber->done = true;
+    yieldFiber();
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                guardFault
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void guardFault(int sig, siginfo_t *info, void *context)
+--                              int sig: SIGSEGV.
+--                              siginfo_t *info: The address that faulted.
+--                              void *context: Unused.
+--
+-- NOTES:
+-- Stops the server with a message if the fault hit the guard page of a fiber. Any other fault gets
+-- the default action back and happens again once the handler returns.
+--------------------------------------------------------------------------------------------------*/
+void guardFault(int sig, siginfo_t *info, void *context)
+{
+    static const char message[] = "fiber: stack overflow, raise the stack size with -S\n";
+    char *address = info->si_addr;
+
+    if (address >= region && address < region + regionSize && (size_t)(address - region) % slotSize < guardSize)
+    {
+        write(STDERR_FILENO, message, sizeof(message) - 1);
+        abort();
+    }
+
+    signal(sig, SIG_DFL);
+}
@@ -0,0 +1,58 @@
+#ifndef FIBER_H
+#define FIBER_H
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#if !defined(__x86_64__)
+#include <ucontext.h>
+#endif
+
+// bytes of stack a fiber gets by default and at least
+#define FIBER_STACK_DEFAULT (64 * 1024)
+#define FIBER_STACK_MIN (16 * 1024)
+
+// fibers that may exist at once by default, the stacks of all of them are reserved up front and
+// with their guard pages take two of vm.max_map_count each
+#define FIBER_LIMIT_DEFAULT 16384
+
+// free stacks each worker keeps resident, the memory of any more is given back to the kernel
+#define FIBER_WARM_STACKS 64
+
+// bytes of the stack each worker handles a fault on a guard page on
+#define FIBER_SIGNAL_STACK (64 * 1024)
+
+// lives at the top of its slot, above the stack it runs on
+struct fiber
+{
+    // the stack pointer it was suspended at, or its whole context without a hand written switch
+#if defined(__x86_64__)
+    void *context;
+#else
+    ucontext_t context;
+#endif
+    // the lowest address of its slot, the guard page below the stack
+    char *stack;
+    // memory of the fiber's own between its stack and this struct
+    char *buffer;
+    size_t bufferLength;
+    void (*entry)(void *arg);
+    void *arg;
+    bool done;
+};
+
+bool startFiberPool(const size_t limit, const int workers, const size_t stackSize, const size_t bufferSize);
+void stopFiberPool();
+void releaseLocalFibers();
+struct fiber *createFiber(void (*entry)(void *arg), void *arg);
+void releaseFiber(struct fiber *fiber);
+bool resumeFiber(struct fiber *fiber);
+void yieldFiber();
+void fiberStart();
+void guardFault(int sig, siginfo_t *info, void *context);
+#if defined(__x86_64__)
+void fiberSwitch(void **save, void *load);
+#endif
+
+#endif // FIBER_H
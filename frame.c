@@ -0,0 +1,259 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            frame.c
+--
+-- PROGRAM:                server.out
+--
+-- FUNCTIONS:
+--                         bool frameAccept(struct handler_conn *conn)
+--                         bool frameData(struct handler_conn *conn, const char *data, const size_t len)
+--                         void frameClose(struct handler_conn *conn)
+--                         size_t frameSize(const char *header)
+--                         bool frameKeep(struct frame_state *state, const char *data, const size_t len)
+--
+-- DATE:                   Oct 17, 2026
+--
+-- REVISIONS:              Oct 18, 2026 - Note what the backends must queue for a frame.
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- The frame protocol handler, picked with -P frame. Every message is a frame: an 8 byte header
+-- holding the length of the payload and a request id, both in network byte order, followed by the
+-- payload. The server answers every frame with the same frame, so a client that sends many frames
+-- before it reads can match the answers by id and knows where each of them ends.
+--
+-- A read is cut into frames where it is read. All complete frames of a read are answered with a
+-- single piece pointing into the read, so a client that pipelines gets all of their answers back
+-- with one sendmsg, however many frames that is. Only the start of a frame the read ends in is
+-- copied, into a buffer of the connection that grows to the size of that frame. A frame larger than
+-- FRAME_MAX_LENGTH closes the connection.
+--
+-- The answer to a frame is queued whole, however much the connection already has waiting, so the
+-- output a backend keeps for a connection must be able to take FRAME_MAX_LENGTH on top of its high
+-- water mark. Epoll maps a buffer of its own for output past the largest pool class for that.
+---------------------------------------------------------------------------------------*/
+#include "frame.h"
+
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+
+const struct protocol_handler frameHandler = { "frame", frameAccept, frameData, NULL, frameClose, NULL };
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                frameAccept
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool frameAccept(struct handler_conn *conn)
+--                              struct handler_conn *conn: The new connection.
+--
+-- RETURNS:                 False if the state of the connection could not be allocated, true otherwise.
+--------------------------------------------------------------------------------------------------*/
+bool frameAccept(struct handler_conn *conn)
+{
+    conn->state = calloc(1, sizeof(struct frame_state));
+
+    return conn->state != NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                frameData
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool frameData(struct handler_conn *conn, const char *data, const size_t len)
+--                              struct handler_conn *conn: The connection that read.
+--                              const char *data: What was read.
+--                              const size_t len: The length of data.
+--
+-- RETURNS:                 False if the peer sent a frame that is too large, true otherwise.
+--
+-- NOTES:
+-- First completes the frame the last read ended in, then finds every complete frame of the read
+-- and queues them as one piece. The start of the frame the read ends in is kept for the next read.
+-- If the frame that was completed is still queued from the buffer the start is kept in, the output
+-- is flushed first and is sent with MSG_MORE since the answers of the other frames follow it.
+--------------------------------------------------------------------------------------------------*/
+bool frameData(struct handler_conn *conn, const char *data, const size_t len)
+{
+    struct frame_state *state = conn->state;
+    bool partialQueued = false;
+    size_t offset = 0;
+    size_t start;
+
+    while (state->length > 0)
+    {
+        size_t need = state->length < FRAME_HEADER_SIZE ? FRAME_HEADER_SIZE : frameSize(state->partial);
+        size_t take = need - state->length < len - offset ? need - state->length : len - offset;
+
+        if (need > FRAME_HEADER_SIZE + FRAME_MAX_LENGTH || !frameKeep(state, data + offset, take))
+        {
+            return false;
+        }
+        offset += take;
+
+        if (state->length >= FRAME_HEADER_SIZE && state->length == frameSize(state->partial))
+        {
+            if (!handlerQueue(conn, state->partial, state->length))
+            {
+                return false;
+            }
+            // the buffer keeps its contents until the output is written
+            state->length = 0;
+            partialQueued = true;
+        }
+        else if (offset == len)
+        {
+            return true;
+        }
+    }
+
+    start = offset;
+    while (len - offset >= FRAME_HEADER_SIZE)
+    {
+        size_t size = frameSize(data + offset);
+
+        if (size > FRAME_HEADER_SIZE + FRAME_MAX_LENGTH)
+        {
+            return false;
+        }
+        if (len - offset < size)
+        {
+            break;
+        }
+        offset += size;
+    }
+
+    if (!handlerQueue(conn, data + start, offset - start))
+    {
+        return false;
+    }
+
+    if (offset == len)
+    {
+        return true;
+    }
+
+    if (partialQueued && !handlerFlush(conn, true))
+    {
+        return false;
+    }
+
+    return frameKeep(state, data + offset, len - offset);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                frameClose
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void frameClose(struct handler_conn *conn)
+--                              struct handler_conn *conn: The connection about to be closed.
+--------------------------------------------------------------------------------------------------*/
+void frameClose(struct handler_conn *conn)
+{
+    struct frame_state *state = conn->state;
+
+    if (state != NULL)
+    {
+        free(state->partial);
+        free(state);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                frameSize
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               size_t frameSize(const char *header)
+--                              const char *header: The header of a frame, FRAME_HEADER_SIZE bytes.
+--
+-- RETURNS:                 The size of the whole frame, header included.
+--
+-- NOTES:
+-- The header is copied out since it can start at any byte of a read.
+--------------------------------------------------------------------------------------------------*/
+size_t frameSize(const char *header)
+{
+    struct frame_header frame;
+
+    memcpy(&frame, header, sizeof(frame));
+
+    return FRAME_HEADER_SIZE + (size_t)ntohl(frame.length);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                frameKeep
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool frameKeep(struct frame_state *state, const char *data, const size_t len)
+--                              struct frame_state *state: The state of the connection.
+--                              const char *data: Part of a frame.
+--                              const size_t len: The length of data.
+--
+-- RETURNS:                 False if the buffer could not be grown, true otherwise.
+--
+-- NOTES:
+-- Appends data to the unfinished frame of the connection, at least doubling the buffer when it is
+-- too small.
+--------------------------------------------------------------------------------------------------*/
+bool frameKeep(struct frame_state *state, const char *data, const size_t len)
+{
+    if (state->length + len > state->capacity)
+    {
+        size_t capacity = state->capacity ? state->capacity * 2 : 256;
+        char *partial;
+
+        while (capacity < state->length + len)
+        {
+            capacity *= 2;
+        }
+
+        if ((partial = realloc(state->partial, capacity)) == NULL)
+        {
+            return false;
+        }
+        state->partial = partial;
+        state->capacity = capacity;
+    }
+
+    memcpy(state->partial + state->length, data, len);
+    state->length += len;
+
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "handler.h"
+
+// every frame starts with a header, both fields in network byte order
+#define FRAME_HEADER_SIZE 8
+// the largest payload a frame may carry, a peer that announces more is closed
+#define FRAME_MAX_LENGTH (1024 * 1024)
+
+struct frame_header
+{
+    // the length of the payload that follows the header
+    uint32_t length;
+    // chosen by the client and sent back with the response
+    uint32_t id;
+};
+
+// the start of a frame that did not fit in the last read
+struct frame_state
+{
+    char *partial;
+    size_t length;
+    size_t capacity;
+};
+
+extern const struct protocol_handler frameHandler;
+
+bool frameAccept(struct handler_conn *conn);
+bool frameData(struct handler_conn *conn, const char *data, const size_t len);
+void frameClose(struct handler_conn *conn);
+size_t frameSize(const char *header);
+bool frameKeep(struct frame_state *state, const char *data, const size_t len);
+
+#endif // FRAME_H
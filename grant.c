@@ -0,0 +1,122 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            grant.c
+--
+-- PROGRAM:                server.out
+--
+-- FUNCTIONS:
+--                         bool grantFiber(struct handler_conn *conn)
+--                         bool grantReceive(struct handler_conn *conn, char *buf, const size_t len)
+--
+-- DATE:                   Oct 18, 2026
+--
+-- REVISIONS:              N/A
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- The grant protocol handler, picked with -P grant in fiber mode. Every message takes two round
+-- trips: the client asks with a frame header, the same 8 bytes as the frame protocol, the server
+-- grants it by sending the header back, and only then does the client send the payload, which the
+-- server echoes. A header announcing more than FRAME_MAX_LENGTH closes the connection.
+--
+-- The handler only has onFiber and reads with handlerRead, so the exchange is written in the order
+-- it happens and nothing about a half done message is kept between calls. The payload is echoed a
+-- chunk at a time as it comes in, out of a buffer on the stack of the fiber that the next read
+-- reuses once handlerRead wrote it.
+---------------------------------------------------------------------------------------*/
+#include "grant.h"
+
+#include <arpa/inet.h>
+
+#include "frame.h"
+
+const struct protocol_handler grantHandler = { "grant", NULL, NULL, NULL, NULL, grantFiber };
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                grantFiber
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool grantFiber(struct handler_conn *conn)
+--                              struct handler_conn *conn: The connection, called on its fiber.
+--
+-- RETURNS:                 False once the peer closes, the socket fails or a header asks for too
+--                          much.
+--------------------------------------------------------------------------------------------------*/
+bool grantFiber(struct handler_conn *conn)
+{
+    struct frame_header header;
+    char chunk[GRANT_CHUNK_SIZE];
+    size_t left;
+    ssize_t n;
+
+    while (grantReceive(conn, (char *)&header, sizeof(header)))
+    {
+        if ((left = ntohl(header.length)) > FRAME_MAX_LENGTH)
+        {
+            return false;
+        }
+
+        // written by the next read, before the peer can send the payload
+        if (!handlerQueue(conn, (char *)&header, sizeof(header)))
+        {
+            return false;
+        }
+
+        while (left > 0)
+        {
+            if ((n = handlerRead(conn, chunk, left < sizeof(chunk) ? left : sizeof(chunk))) <= 0
+                || !handlerQueue(conn, chunk, n))
+            {
+                return false;
+            }
+            left -= n;
+        }
+    }
+
+    return false;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                grantReceive
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool grantReceive(struct handler_conn *conn, char *buf, const size_t len)
+--                              struct handler_conn *conn: The connection, called on its fiber.
+--                              char *buf: The buffer to fill.
+--                              const size_t len: The length of buf.
+--
+-- RETURNS:                 True once buf is full, false if the peer closed or the socket failed
+--                          first.
+--------------------------------------------------------------------------------------------------*/
+bool grantReceive(struct handler_conn *conn, char *buf, const size_t len)
+{
+    size_t got = 0;
+    ssize_t n;
+
+    while (got < len)
+    {
+        if ((n = handlerRead(conn, buf + got, len - got)) <= 0)
+        {
+            return false;
+        }
+        got += n;
+    }
+
+    return true;
+}
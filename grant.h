@@ -0,0 +1,17 @@
+#ifndef GRANT_H
+#define GRANT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "handler.h"
+
+// the most of a payload read at once, on the stack of the fiber
+#define GRANT_CHUNK_SIZE 4096
+
+extern const struct protocol_handler grantHandler;
+
+bool grantFiber(struct handler_conn *conn);
+bool grantReceive(struct handler_conn *conn, char *buf, const size_t len);
+
+#endif // GRANT_H
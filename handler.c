@@ -0,0 +1,589 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            handler.c
+--
+-- PROGRAM:                server.out
+--
+-- FUNCTIONS:
+--                         const struct protocol_handler *findHandler(const char *name)
+--                         bool handlerAccept(struct handler_conn *conn)
+--                         bool handlerData(struct handler_conn *conn, const char *data, const size_t len)
+--                         bool handlerWritable(struct handler_conn *conn)
+--                         void handlerClose(struct handler_conn *conn)
+--                         bool handlerFiber(struct handler_conn *conn)
+--                         ssize_t handlerRead(struct handler_conn *conn, char *buf, const size_t len)
+--                         bool handlerQueue(struct handler_conn *conn, const char *data, const size_t len)
+--                         bool handlerFlush(struct handler_conn *conn, const bool more)
+--                         bool handlerFinish(struct handler_conn *conn, const bool open)
+--                         bool writeBlocking(struct handler_conn *conn, const struct iovec *iov, const int count,
+--                                            const bool more)
+--                         bool handlerShare(const char *data, const size_t len)
+--                         bool handlerShared(const char *data, const size_t len)
+--                         bool echoData(struct handler_conn *conn, const char *data, const size_t len)
+--
+-- DATE:                   Oct 17, 2026
+--
+-- REVISIONS:              Oct 17, 2026 - Cork the writes of a callback that flushes more than once.
+--                         Oct 18, 2026 - Let backends keep output a handler shares instead of copying it.
+--                         Oct 18, 2026 - Let writeBlocking wait on sockets that do not block.
+--                         Oct 18, 2026 - Let handlers run a fiber connection with blocking reads.
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- The protocol a server speaks, kept apart from how its backend moves the bytes.
+--
+-- A protocol_handler is a table of callbacks every backend calls at the same points: onAccept once a
+-- connection is set up, onData with a view of every read, onWritable once all output of a connection
+-- that had to wait is written and onClose before the connection is closed. A callback that returns
+-- false has the connection closed, dropping what it queued since it last flushed; what it flushed
+-- before is still sent in full before the connection closes. The handler keeps what
+-- it needs between calls behind conn->state. The view passed to onData belongs to the backend and is
+-- only valid until onData returns.
+--
+-- In fiber mode a handler may run the whole connection instead, with onFiber. It is called once
+-- after onAccept on the fiber of the connection, reads with handlerRead, which blocks the fiber
+-- until the socket has data, and returns when it is done with the connection. A protocol that has
+-- to wait for the peer in the middle of a message is then written straight down, without keeping
+-- where it stopped in conn->state. handlerRead writes what was queued before it reads, so the peer
+-- has the question before the handler waits for its answer, and queued data only has to stay
+-- unchanged until the next handlerRead. Handlers without onFiber get onData in fiber mode too.
+--
+-- Handlers do not write. They queue pieces of output with handlerQueue, which only stores a pointer
+-- and a length in a gather list of the worker. Once the callback returns the backend writes the whole
+-- list with conn->write, a single sendmsg for the sockets of select, poll and epoll. A callback that
+-- queues more than the list holds, or flushes early with handlerFlush, has every write but its last
+-- sent with MSG_MORE, so the kernel packs the pieces into full segments instead of pushing each. Queued data only
+-- has to stay unchanged until the callback returns, so a handler may queue parts of the view it was
+-- given and nothing is copied unless the socket does not take it all. Epoll copies what is left into
+-- the pending output of the connection and uring copies what is not part of a received buffer, since
+-- its sends complete after the callback returned.
+--
+-- Output that never changes, like a prebuilt response, can be registered once with handlerShare
+-- before the workers start. The backends check handlerShared before they copy a piece and keep a
+-- pointer to shared output instead, so a large response costs no memory per connection that has
+-- to wait for it.
+--
+-- The time spent in onData is recorded as the handler metric of the worker, so the cost of the
+-- protocol can be told apart from the cost of the event loop around it.
+---------------------------------------------------------------------------------------*/
+#include "handler.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "frame.h"
+#include "grant.h"
+#include "http.h"
+#include "metrics.h"
+#include "net.h"
+
+const struct protocol_handler echoHandler = { "echo", NULL, echoData, NULL, NULL, NULL };
+
+// every handler -P can pick, the first is the default
+static const struct protocol_handler *handlers[] = { &echoHandler, &frameHandler, &httpHandler, &grantHandler };
+
+static __thread struct iovec segments[HANDLER_MAX_SEGMENTS];
+static __thread int segmentCount = 0;
+
+// output that stays unchanged for as long as the server runs, only written before the workers start
+static struct iovec shared[HANDLER_MAX_SHARED];
+static int sharedCount = 0;
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                findHandler
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               const struct protocol_handler *findHandler(const char *name)
+--                              const char *name: The name of the handler.
+--
+-- RETURNS:                 The handler or NULL if there is none of that name.
+--------------------------------------------------------------------------------------------------*/
+const struct protocol_handler *findHandler(const char *name)
+{
+    for (size_t i = 0; i < sizeof(handlers) / sizeof(handlers[0]); i++)
+    {
+        if (!strcmp(handlers[i]->name, name))
+        {
+            return handlers[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                handlerAccept
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool handlerAccept(struct handler_conn *conn)
+--                              struct handler_conn *conn: A new connection, fd, handler and write set.
+--
+-- RETURNS:                 False if the connection should be closed, true otherwise.
+--
+-- NOTES:
+-- Lets the handler set up its state and queue a greeting, then writes what it queued. handlerClose
+-- must be called for the connection later whatever this returns.
+--------------------------------------------------------------------------------------------------*/
+bool handlerAccept(struct handler_conn *conn)
+{
+    conn->state = NULL;
+
+    return handlerFinish(conn, conn->handler->onAccept == NULL || conn->handler->onAccept(conn));
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                handlerData
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool handlerData(struct handler_conn *conn, const char *data, const size_t len)
+--                              struct handler_conn *conn: The connection that read.
+--                              const char *data: What was read.
+--                              const size_t len: The length of data.
+--
+-- RETURNS:                 False if the connection should be closed, true otherwise.
+--
+-- NOTES:
+-- Passes a read to the handler, timing it, and writes what the handler queued in answer.
+--------------------------------------------------------------------------------------------------*/
+bool handlerData(struct handler_conn *conn, const char *data, const size_t len)
+{
+    uint64_t start = metricsNow();
+    bool open = conn->handler->onData == NULL || conn->handler->onData(conn, data, len);
+
+    metricsRecord(METRIC_HANDLER, metricsNow() - start);
+
+    return handlerFinish(conn, open);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                handlerWritable
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool handlerWritable(struct handler_conn *conn)
+--                              struct handler_conn *conn: A connection whose waiting output is written.
+--
+-- RETURNS:                 False if the connection should be closed, true otherwise.
+--
+-- NOTES:
+-- Lets a handler that held back output until the socket had room queue more.
+--------------------------------------------------------------------------------------------------*/
+bool handlerWritable(struct handler_conn *conn)
+{
+    if (conn->handler->onWritable == NULL)
+    {
+        return true;
+    }
+
+    return handlerFinish(conn, conn->handler->onWritable(conn));
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                handlerClose
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void handlerClose(struct handler_conn *conn)
+--                              struct handler_conn *conn: The connection about to be closed.
+--
+-- NOTES:
+-- Lets the handler free its state. Does nothing for a connection no handler was set for.
+--------------------------------------------------------------------------------------------------*/
+void handlerClose(struct handler_conn *conn)
+{
+    if (conn->handler != NULL && conn->handler->onClose != NULL)
+    {
+        conn->handler->onClose(conn);
+    }
+    conn->state = NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                handlerFiber
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool handlerFiber(struct handler_conn *conn)
+--                              struct handler_conn *conn: An accepted connection, called on its fiber.
+--
+-- RETURNS:                 False if the connection should be closed, true if what the handler queued
+--                          last is written.
+--
+-- NOTES:
+-- Runs onFiber and writes what it queued after its last read. Only called by backends that set
+-- conn->read, for handlers that have onFiber. The time is not recorded as the handler metric, since
+-- most of it is spent waiting on the peer.
+--------------------------------------------------------------------------------------------------*/
+bool handlerFiber(struct handler_conn *conn)
+{
+    return handlerFinish(conn, conn->handler->onFiber(conn));
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                handlerRead
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               ssize_t handlerRead(struct handler_conn *conn, char *buf, const size_t len)
+--                              struct handler_conn *conn: The connection onFiber was called for.
+--                              char *buf: The buffer to read into.
+--                              const size_t len: The length of buf.
+--
+-- RETURNS:                 The number of bytes read, 0 if the peer closed the connection and -1 if
+--                          it failed or the backend cannot block.
+--
+-- NOTES:
+-- Writes what the handler queued, then reads what the socket has, blocking until it has something.
+-- The output has to go first, the peer may be waiting on it before it sends more, and the gather
+-- list belongs to the worker, whose other connections fill it while this one is blocked.
+--------------------------------------------------------------------------------------------------*/
+ssize_t handlerRead(struct handler_conn *conn, char *buf, const size_t len)
+{
+    if (conn->read == NULL)
+    {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    if (!handlerFlush(conn, false))
+    {
+        return -1;
+    }
+
+    return conn->read(conn, buf, len);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                handlerQueue
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Write a full list with MSG_MORE.
+--                          Oct 18, 2026 - Only look at the last piece when there is one.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool handlerQueue(struct handler_conn *conn, const char *data, const size_t len)
+--                              struct handler_conn *conn: The connection the handler was called for.
+--                              const char *data: The output, unchanged until the callback returns.
+--                              const size_t len: The length of data.
+--
+-- RETURNS:                 False if writing the output queued so far failed, true otherwise.
+--
+-- NOTES:
+-- Adds data to the output of the callback without copying it. Data that directly follows the last
+-- piece extends it. A full gather list is written, marked as followed by more, before the new
+-- piece is added.
+--------------------------------------------------------------------------------------------------*/
+bool handlerQueue(struct handler_conn *conn, const char *data, const size_t len)
+{
+    if (len == 0)
+    {
+        return true;
+    }
+
+    if (segmentCount > 0)
+    {
+        struct iovec *last = &segments[segmentCount - 1];
+
+        if ((char *)last->iov_base + last->iov_len == data)
+        {
+            last->iov_len += len;
+            return true;
+        }
+    }
+
+    if (segmentCount == HANDLER_MAX_SEGMENTS && !handlerFlush(conn, true))
+    {
+        return false;
+    }
+
+    segments[segmentCount].iov_base = (void *)data;
+    segments[segmentCount].iov_len = len;
+    segmentCount++;
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                handlerFlush
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Pass on whether more output follows.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool handlerFlush(struct handler_conn *conn, const bool more)
+--                              struct handler_conn *conn: The connection the output is for.
+--                              const bool more: Whether the callback queues more after this.
+--
+-- RETURNS:                 False if the connection failed, true otherwise.
+--
+-- NOTES:
+-- Hands the gather list of the worker to the backend of the connection and empties it. A handler
+-- calls it with more set when it has to reuse memory it already queued before it returns.
+--------------------------------------------------------------------------------------------------*/
+bool handlerFlush(struct handler_conn *conn, const bool more)
+{
+    int count = segmentCount;
+
+    if (count == 0)
+    {
+        return true;
+    }
+
+    segmentCount = 0;
+    return conn->write(conn, segments, count, more);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                handlerFinish
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool handlerFinish(struct handler_conn *conn, const bool open)
+--                              struct handler_conn *conn: The connection a callback was called for.
+--                              const bool open: What the callback returned.
+--
+-- RETURNS:                 False if the connection should be closed, true otherwise.
+--
+-- NOTES:
+-- Writes the output of a callback that kept the connection open and drops that of one that did not.
+--------------------------------------------------------------------------------------------------*/
+bool handlerFinish(struct handler_conn *conn, const bool open)
+{
+    if (!open)
+    {
+        segmentCount = 0;
+        return false;
+    }
+
+    return handlerFlush(conn, false);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                writeBlocking
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Cork the socket while more output follows.
+--                          Oct 18, 2026 - Wait for sockets that do not block to take the rest.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool writeBlocking(struct handler_conn *conn, const struct iovec *iov, const int count,
+--                                             const bool more)
+--                              struct handler_conn *conn: A connection with a socket of select or poll.
+--                              const struct iovec *iov: The output.
+--                              const int count: The number of pieces in iov.
+--                              const bool more: Whether more output follows.
+--
+-- RETURNS:                 True if all of the output was sent, false otherwise.
+--
+-- NOTES:
+-- The write of backends that have nowhere to keep output for later. A socket that does not take all
+-- of it is waited on for up to HANDLER_WRITE_WAIT_MS at a time, the same as the send timeout of a
+-- socket that blocks.
+--------------------------------------------------------------------------------------------------*/
+bool writeBlocking(struct handler_conn *conn, const struct iovec *iov, const int count, const bool more)
+{
+    struct iovec rest[count];
+    struct pollfd writable = { conn->fd, POLLOUT, 0 };
+    int first = 0;
+    size_t total = 0;
+
+    memcpy(rest, iov, count * sizeof(struct iovec));
+    for (int i = 0; i < count; i++)
+    {
+        total += iov[i].iov_len;
+    }
+
+    while (true)
+    {
+        size_t sent = sendVectorToSocket(conn->fd, rest + first, count - first, more ? MSG_MORE : 0);
+        int ready;
+
+        if (sent == total)
+        {
+            return true;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            return false;
+        }
+        total -= sent;
+
+        // skip what went out, the first piece left may have been sent in part
+        while (sent >= rest[first].iov_len)
+        {
+            sent -= rest[first].iov_len;
+            first++;
+        }
+        rest[first].iov_base = (char *)rest[first].iov_base + sent;
+        rest[first].iov_len -= sent;
+
+        while ((ready = poll(&writable, 1, HANDLER_WRITE_WAIT_MS)) == -1 && errno == EINTR)
+        {
+        }
+        if (ready <= 0)
+        {
+            return false;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                handlerShare
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool handlerShare(const char *data, const size_t len)
+--                              const char *data: Output that is never changed or freed while the server runs.
+--                              const size_t len: The length of data.
+--
+-- RETURNS:                 False if HANDLER_MAX_SHARED pieces are shared already, true otherwise.
+--
+-- NOTES:
+-- Lets the backends keep pointers into data rather than copies of it. Must be called before the
+-- workers start.
+--------------------------------------------------------------------------------------------------*/
+bool handlerShare(const char *data, const size_t len)
+{
+    if (sharedCount == HANDLER_MAX_SHARED)
+    {
+        return false;
+    }
+
+    shared[sharedCount].iov_base = (void *)data;
+    shared[sharedCount].iov_len = len;
+    sharedCount++;
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                handlerShared
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool handlerShared(const char *data, const size_t len)
+--                              const char *data: A piece of output.
+--                              const size_t len: The length of data.
+--
+-- RETURNS:                 True if the piece lies within output shared with handlerShare, false otherwise.
+--------------------------------------------------------------------------------------------------*/
+bool handlerShared(const char *data, const size_t len)
+{
+    for (int i = 0; i < sharedCount; i++)
+    {
+        const char *start = shared[i].iov_base;
+
+        if (data >= start && data + len <= start + shared[i].iov_len)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                echoData
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool echoData(struct handler_conn *conn, const char *data, const size_t len)
+--                              struct handler_conn *conn: The connection that read.
+--                              const char *data: What was read.
+--                              const size_t len: The length of data.
+--
+-- RETURNS:                 False if the echo could not be queued, true otherwise.
+--
+-- NOTES:
+-- The onData of the echo handler, the default. Queues the view itself, so the echo is written
+-- straight from the buffer it was read into.
+--------------------------------------------------------------------------------------------------*/
+bool echoData(struct handler_conn *conn, const char *data, const size_t len)
+{
+    return handlerQueue(conn, data, len);
+}
@@ -0,0 +1,63 @@
+#ifndef HANDLER_H
+#define HANDLER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// pieces of output a worker gathers before it writes them with one call
+#define HANDLER_MAX_SEGMENTS 64
+// pieces of output handlers may share with the backends for good
+#define HANDLER_MAX_SHARED 8
+// how long writeBlocking waits at a time for a socket to take more output
+#define HANDLER_WRITE_WAIT_MS (10 * 1000)
+
+struct handler_conn;
+
+// the protocol spoken on every connection of the server, any callback may be NULL
+struct protocol_handler
+{
+    const char *name;
+    bool (*onAccept)(struct handler_conn *conn);
+    bool (*onData)(struct handler_conn *conn, const char *data, const size_t len);
+    bool (*onWritable)(struct handler_conn *conn);
+    void (*onClose)(struct handler_conn *conn);
+    // runs the whole connection in fiber mode in place of onData, reading with handlerRead
+    bool (*onFiber)(struct handler_conn *conn);
+};
+
+// what a handler sees of a connection, only valid for the call it is passed to
+struct handler_conn
+{
+    int fd;
+    const struct protocol_handler *handler;
+    // writes what the handler queued, set by the backend, more is set if more output follows
+    bool (*write)(struct handler_conn *conn, const struct iovec *iov, const int count, const bool more);
+    // reads what the socket has, blocking until it has something, NULL where the backend cannot block
+    ssize_t (*read)(struct handler_conn *conn, char *buf, const size_t len);
+    // owned by the handler
+    void *state;
+};
+
+extern const struct protocol_handler echoHandler;
+
+const struct protocol_handler *findHandler(const char *name);
+
+bool handlerAccept(struct handler_conn *conn);
+bool handlerData(struct handler_conn *conn, const char *data, const size_t len);
+bool handlerWritable(struct handler_conn *conn);
+bool handlerFiber(struct handler_conn *conn);
+void handlerClose(struct handler_conn *conn);
+
+ssize_t handlerRead(struct handler_conn *conn, char *buf, const size_t len);
+bool handlerQueue(struct handler_conn *conn, const char *data, const size_t len);
+bool handlerFlush(struct handler_conn *conn, const bool more);
+bool handlerFinish(struct handler_conn *conn, const bool open);
+bool writeBlocking(struct handler_conn *conn, const struct iovec *iov, const int count, const bool more);
+bool handlerShare(const char *data, const size_t len);
+bool handlerShared(const char *data, const size_t len);
+
+bool echoData(struct handler_conn *conn, const char *data, const size_t len);
+
+#endif // HANDLER_H
@@ -0,0 +1,259 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            histogram.c
+--
+-- PROGRAM:                server.out, loadgen.out
+--
+-- FUNCTIONS:
+--                         void histogramReset(struct histogram *histogram)
+--                         void histogramRecord(struct histogram *histogram, const uint64_t value)
+--                         void histogramMerge(struct histogram *dst, const struct histogram *src)
+--                         uint64_t histogramPercentile(const struct histogram *histogram, const double percentile)
+--                         int histogramIndex(const uint64_t value)
+--                         uint64_t histogramHighestValue(const int index)
+--
+-- DATE:                   Oct 17, 2026
+--
+-- REVISIONS:              N/A
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- A fixed size log-linear histogram in the style of HdrHistogram.
+--
+-- Values below HISTOGRAM_SUB_COUNT get a bucket each. Every power of two above that is split into
+-- HISTOGRAM_HALF_COUNT equal buckets, so any 64 bit value is recorded with a relative error below
+-- 1 / HISTOGRAM_HALF_COUNT in a constant number of buckets. Recording is a count leading zeros and an
+-- increment, and two histograms are merged by adding their buckets, so every thread can keep its own
+-- and the totals are combined at the end.
+--
+-- A histogram has a single writer. Its fields are written and read with relaxed atomics, which cost
+-- nothing over plain loads and stores, so another thread may merge it while it is being recorded into.
+---------------------------------------------------------------------------------------*/
+#include "histogram.h"
+
+#include <string.h>
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                histogramReset
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void histogramReset(struct histogram *histogram)
+--                              struct histogram *histogram: The histogram to empty.
+--
+-- NOTES:
+-- Empties the histogram.
+--------------------------------------------------------------------------------------------------*/
+void histogramReset(struct histogram *histogram)
+{
+    memset(histogram, 0, sizeof(struct histogram));
+    histogram->min = UINT64_MAX;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                histogramRecord
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void histogramRecord(struct histogram *histogram, const uint64_t value)
+--                              struct histogram *histogram: The histogram to record into.
+--                              const uint64_t value: The value to record.
+--
+-- NOTES:
+-- Counts one occurrence of value.
+--------------------------------------------------------------------------------------------------*/
+void histogramRecord(struct histogram *histogram, const uint64_t value)
+{
+    uint64_t *bucket = &histogram->buckets[histogramIndex(value)];
+
+    __atomic_store_n(bucket, *bucket + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->count, histogram->count + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->total, histogram->total + value, __ATOMIC_RELAXED);
+    if (value < histogram->min)
+    {
+        __atomic_store_n(&histogram->min, value, __ATOMIC_RELAXED);
+    }
+    if (value > histogram->max)
+    {
+        __atomic_store_n(&histogram->max, value, __ATOMIC_RELAXED);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                histogramMerge
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void histogramMerge(struct histogram *dst, const struct histogram *src)
+--                              struct histogram *dst: The histogram to add to.
+--                              const struct histogram *src: The histogram to add.
+--
+-- NOTES:
+-- Adds every value recorded in src to dst. src may be recorded into at the same time, dst may not.
+--------------------------------------------------------------------------------------------------*/
+void histogramMerge(struct histogram *dst, const struct histogram *src)
+{
+    uint64_t min = __atomic_load_n(&src->min, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+
+    if (__atomic_load_n(&src->count, __ATOMIC_RELAXED) == 0)
+    {
+        return;
+    }
+
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        dst->buckets[i] += __atomic_load_n(&src->buckets[i], __ATOMIC_RELAXED);
+    }
+
+    dst->count += __atomic_load_n(&src->count, __ATOMIC_RELAXED);
+    dst->total += __atomic_load_n(&src->total, __ATOMIC_RELAXED);
+    if (min < dst->min)
+    {
+        dst->min = min;
+    }
+    if (max > dst->max)
+    {
+        dst->max = max;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                histogramPercentile
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               uint64_t histogramPercentile(const struct histogram *histogram,
+--                                                       const double percentile)
+--                              const struct histogram *histogram: The histogram to read.
+--                              const double percentile: The percentile between 0 and 100.
+--
+-- RETURNS:                 The value at the percentile, 0 for an empty histogram.
+--
+-- NOTES:
+-- Returns the highest value of the bucket holding the percentile, never more than the largest value
+-- recorded, so a percentile is never reported lower than it was.
+--------------------------------------------------------------------------------------------------*/
+uint64_t histogramPercentile(const struct histogram *histogram, const double percentile)
+{
+    uint64_t target;
+    uint64_t seen = 0;
+
+    if (histogram->count == 0)
+    {
+        return 0;
+    }
+
+    target = (uint64_t)(percentile / 100.0 * histogram->count + 0.5);
+    if (target < 1)
+    {
+        target = 1;
+    }
+    if (target > histogram->count)
+    {
+        target = histogram->count;
+    }
+
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        seen += histogram->buckets[i];
+        if (seen >= target)
+        {
+            uint64_t value = histogramHighestValue(i);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                histogramIndex
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int histogramIndex(const uint64_t value)
+--                              const uint64_t value: The value to look up.
+--
+-- RETURNS:                 The bucket value is counted in.
+--
+-- NOTES:
+-- Above HISTOGRAM_SUB_COUNT the value is shifted right until only its top HISTOGRAM_SUB_BITS bits are
+-- left. The shift picks the power of two and the remaining bits the bucket inside of it.
+--------------------------------------------------------------------------------------------------*/
+int histogramIndex(const uint64_t value)
+{
+    int shift;
+
+    if (value < HISTOGRAM_SUB_COUNT)
+    {
+        return (int)value;
+    }
+
+    shift = 63 - __builtin_clzll(value) - (HISTOGRAM_SUB_BITS - 1);
+    return HISTOGRAM_SUB_COUNT + (shift - 1) * HISTOGRAM_HALF_COUNT
+           + (int)(value >> shift) - HISTOGRAM_HALF_COUNT;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                histogramHighestValue
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               uint64_t histogramHighestValue(const int index)
+--                              const int index: The bucket.
+--
+-- RETURNS:                 The largest value counted in the bucket.
+--------------------------------------------------------------------------------------------------*/
+uint64_t histogramHighestValue(const int index)
+{
+    int shift;
+    uint64_t sub;
+
+    if (index < HISTOGRAM_SUB_COUNT)
+    {
+        return index;
+    }
+
+    shift = (index - HISTOGRAM_SUB_COUNT) / HISTOGRAM_HALF_COUNT + 1;
+    sub = (index - HISTOGRAM_SUB_COUNT) % HISTOGRAM_HALF_COUNT + HISTOGRAM_HALF_COUNT;
+    return (sub << shift) + ((uint64_t)1 << shift) - 1;
+}
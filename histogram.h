@@ -0,0 +1,28 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+// values below 2^HISTOGRAM_SUB_BITS are exact, larger ones are kept to within 1/128 of their value
+#define HISTOGRAM_SUB_BITS 8
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_HALF_COUNT (HISTOGRAM_SUB_COUNT / 2)
+#define HISTOGRAM_BUCKETS (HISTOGRAM_SUB_COUNT + (64 - HISTOGRAM_SUB_BITS) * HISTOGRAM_HALF_COUNT)
+
+struct histogram
+{
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t total;
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+};
+
+void histogramReset(struct histogram *histogram);
+void histogramRecord(struct histogram *histogram, const uint64_t value);
+void histogramMerge(struct histogram *dst, const struct histogram *src);
+uint64_t histogramPercentile(const struct histogram *histogram, const double percentile);
+int histogramIndex(const uint64_t value);
+uint64_t histogramHighestValue(const int index);
+
+#endif // HISTOGRAM_H
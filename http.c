@@ -0,0 +1,794 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            http.c
+--
+-- PROGRAM:                server.out
+--
+-- FUNCTIONS:
+--                         bool httpInit(const char *bodyPath)
+--                         bool httpAccept(struct handler_conn *conn)
+--                         bool httpData(struct handler_conn *conn, const char *data, const size_t len)
+--                         void httpClose(struct handler_conn *conn)
+--                         bool httpParse(const char *request, const size_t len, struct http_request *parsed)
+--                         bool httpHeaderHas(const char *value, const size_t len, const char *token)
+--                         bool httpRespond(struct handler_conn *conn, const int count)
+--                         bool httpRespondAndClose(struct handler_conn *conn, const int count, const bool badRequest)
+--                         size_t httpFindEndScalar(const char *data, const size_t len)
+--                         size_t httpFindByteScalar(const char *data, const size_t len, const char c)
+--                         size_t httpFindEndSse2(const char *data, const size_t len)
+--                         size_t httpFindEndAvx2(const char *data, const size_t len)
+--                         size_t httpFindByteSse2(const char *data, const size_t len, const char c)
+--                         size_t httpFindByteAvx2(const char *data, const size_t len, const char c)
+--
+-- DATE:                   Oct 18, 2026
+--
+-- REVISIONS:              Oct 18, 2026 - Share the responses with the backends, repeat only short ones.
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- The http protocol handler, picked with -P http. Every request gets the same 200 response, with
+-- the body from the file given with -E or a short text, so the server can be measured with wrk or
+-- ab against other servers on the same box.
+--
+-- Connections are kept alive as HTTP/1.1 and the Connection header say, and requests may be
+-- pipelined. Every complete request of a read is answered, and the answers are queued from a run
+-- of copies of the response laid out back to back, so several pipelined answers go out as one piece
+-- of the gather list. The run holds HTTP_RESPONSE_RUN copies, fewer for responses so long that the
+-- run would pass HTTP_RESPONSE_RUN_BYTES, and a single one for those longer than that. The
+-- responses are built once by httpInit() and nothing is formatted per request, which is also why
+-- there is no Date header. A request body is read past, chunked bodies are not supported.
+--
+-- The responses are shared with the backends through handlerShare, so the answers a slow client
+-- has not read yet are kept as pointers rather than copies, however large the file given with -E.
+-- The response that closes the connection is its own headers followed by the body of the run.
+--
+-- The end of a request and the end of each header line are found 32 bytes at a time with AVX2 or
+-- 16 at a time with SSE2, whichever the cpu has, and a byte at a time elsewhere. Only the start of
+-- a request that a read ends in is copied, requests longer than HTTP_MAX_REQUEST get a 400. A
+-- response that closes the connection is flushed before the handler gives the connection up, and
+-- the backend sends all of it before closing.
+---------------------------------------------------------------------------------------*/
+#include "http.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+const struct protocol_handler httpHandler = { "http", httpAccept, httpData, NULL, httpClose, NULL };
+
+// the prebuilt responses, shared by every worker: the close headers, then the run of responses
+static char *responses;
+static char *responseRun;
+static size_t responseLength;
+static int responseCopies;
+static size_t closeHeadersLength;
+static const char *body;
+static size_t bodyLength;
+static const char badResponse[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+// the scanners the cpu supports, picked by httpInit()
+static size_t (*findEnd)(const char *data, const size_t len) = httpFindEndScalar;
+static size_t (*findByte)(const char *data, const size_t len, const char c) = httpFindByteScalar;
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                httpInit
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Keep one copy of a long body and share the responses.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool httpInit(const char *bodyPath)
+--                              const char *bodyPath: The file to serve, NULL for a short text.
+--
+-- RETURNS:                 False if the file could not be read, true otherwise.
+--
+-- NOTES:
+-- Builds the responses, shares them with the backends and picks the widest scanners the cpu
+-- supports. The body is read straight into the first response of the run. Must be called before
+-- the workers start.
+--------------------------------------------------------------------------------------------------*/
+bool httpInit(const char *bodyPath)
+{
+    const char *headers = "HTTP/1.1 200 OK\r\nServer: scalable-server\r\nContent-Type: text/plain\r\n"
+                          "Content-Length: %zu\r\nConnection: %s\r\n\r\n";
+    const char *text = "Hello, World!\n";
+    FILE *file = NULL;
+    size_t headersLength;
+
+    if (bodyPath == NULL)
+    {
+        bodyLength = strlen(text);
+    }
+    else
+    {
+        long size;
+
+        if ((file = fopen(bodyPath, "rb")) == NULL)
+        {
+            return false;
+        }
+        if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0)
+        {
+            fclose(file);
+            return false;
+        }
+        bodyLength = size;
+    }
+
+    // as many copies of the keep alive response as fit the run, at least one
+    closeHeadersLength = snprintf(NULL, 0, headers, bodyLength, "close");
+    headersLength = snprintf(NULL, 0, headers, bodyLength, "keep-alive");
+    responseLength = headersLength + bodyLength;
+    responseCopies = HTTP_RESPONSE_RUN_BYTES / responseLength;
+    if (responseCopies < 1)
+    {
+        responseCopies = 1;
+    }
+    else if (responseCopies > HTTP_RESPONSE_RUN)
+    {
+        responseCopies = HTTP_RESPONSE_RUN;
+    }
+
+    if ((responses = malloc(closeHeadersLength + responseLength * responseCopies + 1)) == NULL)
+    {
+        if (file != NULL)
+        {
+            fclose(file);
+        }
+        return false;
+    }
+    responseRun = responses + closeHeadersLength;
+    body = responseRun + headersLength;
+
+    snprintf(responses, closeHeadersLength + 1, headers, bodyLength, "close");
+    snprintf(responseRun, headersLength + 1, headers, bodyLength, "keep-alive");
+    if (file == NULL)
+    {
+        memcpy(responseRun + headersLength, text, bodyLength);
+    }
+    else
+    {
+        bool complete = fread(responseRun + headersLength, 1, bodyLength, file) == bodyLength;
+
+        fclose(file);
+        if (!complete)
+        {
+            free(responses);
+            return false;
+        }
+    }
+    for (int i = 1; i < responseCopies; i++)
+    {
+        memcpy(responseRun + i * responseLength, responseRun, responseLength);
+    }
+
+    if (!handlerShare(responses, closeHeadersLength + responseLength * responseCopies)
+        || !handlerShare(badResponse, sizeof(badResponse) - 1))
+    {
+        free(responses);
+        return false;
+    }
+
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        findEnd = httpFindEndAvx2;
+        findByte = httpFindByteAvx2;
+    }
+    else
+    {
+        findEnd = httpFindEndSse2;
+        findByte = httpFindByteSse2;
+    }
+#endif
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                httpAccept
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool httpAccept(struct handler_conn *conn)
+--                              struct handler_conn *conn: The new connection.
+--
+-- RETURNS:                 False if the state of the connection could not be allocated, true otherwise.
+--------------------------------------------------------------------------------------------------*/
+bool httpAccept(struct handler_conn *conn)
+{
+    conn->state = calloc(1, sizeof(struct http_state));
+
+    return conn->state != NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                httpData
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool httpData(struct handler_conn *conn, const char *data, const size_t len)
+--                              struct handler_conn *conn: The connection that read.
+--                              const char *data: What was read.
+--                              const size_t len: The length of data.
+--
+-- RETURNS:                 False if the connection should be closed, true otherwise.
+--
+-- NOTES:
+-- Reads past the body of the last request, then answers every request that ends in the read. A
+-- request the last read ended in is completed in the buffer of the connection, the search for its
+-- end starting 3 bytes before the new data in case the blank line was cut. The keep alive answers
+-- are only counted and queued together at the end. A request that wants the connection closed or
+-- can not be parsed is answered with everything before it and the connection is closed.
+--------------------------------------------------------------------------------------------------*/
+bool httpData(struct handler_conn *conn, const char *data, const size_t len)
+{
+    struct http_state *state = conn->state;
+    size_t offset = 0;
+    int responses = 0;
+
+    while (offset < len)
+    {
+        struct http_request request;
+        const char *start;
+        size_t size;
+
+        if (state->skip > 0)
+        {
+            size_t take = state->skip < len - offset ? state->skip : len - offset;
+
+            state->skip -= take;
+            offset += take;
+            continue;
+        }
+
+        if (state->length > 0)
+        {
+            size_t from = state->length > 3 ? state->length - 3 : 0;
+            size_t used = state->length;
+            size_t take = len - offset < HTTP_MAX_REQUEST - state->length ? len - offset
+                                                                            : HTTP_MAX_REQUEST - state->length;
+
+            memcpy(state->partial + state->length, data + offset, take);
+            state->length += take;
+
+            if ((size = findEnd(state->partial + from, state->length - from)) == 0)
+            {
+                if (state->length == HTTP_MAX_REQUEST)
+                {
+                    return httpRespondAndClose(conn, responses, true);
+                }
+                offset += take;
+                continue;
+            }
+
+            // only the part of the read up to the end of the request belongs to it
+            size += from;
+            offset += size - used;
+            state->length = 0;
+            start = state->partial;
+        }
+        else if ((size = findEnd(data + offset, len - offset)) == 0)
+        {
+            if (len - offset >= HTTP_MAX_REQUEST)
+            {
+                return httpRespondAndClose(conn, responses, true);
+            }
+            if (state->partial == NULL && (state->partial = malloc(HTTP_MAX_REQUEST)) == NULL)
+            {
+                return false;
+            }
+            memcpy(state->partial, data + offset, len - offset);
+            state->length = len - offset;
+            break;
+        }
+        else
+        {
+            start = data + offset;
+            offset += size;
+        }
+
+        if (!httpParse(start, size, &request))
+        {
+            return httpRespondAndClose(conn, responses, true);
+        }
+        if (!request.keepAlive)
+        {
+            return httpRespondAndClose(conn, responses, false);
+        }
+
+        state->skip = request.bodyLength;
+        responses++;
+    }
+
+    return httpRespond(conn, responses);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                httpClose
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void httpClose(struct handler_conn *conn)
+--                              struct handler_conn *conn: The connection about to be closed.
+--------------------------------------------------------------------------------------------------*/
+void httpClose(struct handler_conn *conn)
+{
+    struct http_state *state = conn->state;
+
+    if (state != NULL)
+    {
+        free(state->partial);
+        free(state);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                httpParse
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool httpParse(const char *request, const size_t len, struct http_request *parsed)
+--                              const char *request: A whole request up to and with its blank line.
+--                              const size_t len: The length of request.
+--                              struct http_request *parsed: Set to what the answer depends on.
+--
+-- RETURNS:                 False if the request is not HTTP/1.x or has a body that can not be read
+--                          past, true otherwise.
+--
+-- NOTES:
+-- Splits the request into lines and only looks at the version and the Connection, Content-Length
+-- and Transfer-Encoding headers. HTTP/1.1 is kept alive unless it asks to close, HTTP/1.0 only if
+-- it asks for keep alive.
+--------------------------------------------------------------------------------------------------*/
+bool httpParse(const char *request, const size_t len, struct http_request *parsed)
+{
+    size_t end = findByte(request, len, '\n');
+    const char *version;
+
+    // the request line ends in " HTTP/1.x\r"
+    if (end < 14 || request[end - 1] != '\r' || request[end - 10] != ' ')
+    {
+        return false;
+    }
+    version = request + end - 9;
+    if (memcmp(version, "HTTP/1.", 7) || (version[7] != '0' && version[7] != '1'))
+    {
+        return false;
+    }
+
+    parsed->keepAlive = version[7] == '1';
+    parsed->bodyLength = 0;
+
+    for (size_t offset = end + 1; offset < len; offset = end + 1)
+    {
+        const char *line = request + offset;
+        size_t lineLength;
+
+        end = offset + findByte(line, len - offset, '\n');
+        lineLength = end - offset;
+
+        // the blank line that ends the headers
+        if (lineLength <= 1)
+        {
+            break;
+        }
+
+        if (lineLength > 11 && !strncasecmp(line, "connection:", 11))
+        {
+            if (httpHeaderHas(line + 11, lineLength - 11, "close"))
+            {
+                parsed->keepAlive = false;
+            }
+            else if (httpHeaderHas(line + 11, lineLength - 11, "keep-alive"))
+            {
+                parsed->keepAlive = true;
+            }
+        }
+        else if (lineLength > 15 && !strncasecmp(line, "content-length:", 15))
+        {
+            size_t i = 15;
+
+            while (i < lineLength && (line[i] == ' ' || line[i] == '\t'))
+            {
+                i++;
+            }
+            if (i == lineLength || line[i] < '0' || line[i] > '9')
+            {
+                return false;
+            }
+            for (parsed->bodyLength = 0; i < lineLength && line[i] >= '0' && line[i] <= '9'; i++)
+            {
+                parsed->bodyLength = parsed->bodyLength * 10 + line[i] - '0';
+            }
+        }
+        else if (lineLength > 18 && !strncasecmp(line, "transfer-encoding:", 18))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                httpHeaderHas
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool httpHeaderHas(const char *value, const size_t len, const char *token)
+--                              const char *value: The value of a header.
+--                              const size_t len: The length of value.
+--                              const char *token: The token to look for, in lower case.
+--
+-- RETURNS:                 True if the value contains the token in any case, false otherwise.
+--------------------------------------------------------------------------------------------------*/
+bool httpHeaderHas(const char *value, const size_t len, const char *token)
+{
+    size_t tokenLength = strlen(token);
+
+    for (size_t i = 0; i + tokenLength <= len; i++)
+    {
+        if (!strncasecmp(value + i, token, tokenLength))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                httpRespond
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Runs of as many responses as were laid out.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool httpRespond(struct handler_conn *conn, const int count)
+--                              struct handler_conn *conn: The connection to answer.
+--                              const int count: The number of keep alive responses to queue.
+--
+-- RETURNS:                 False if the responses could not be queued, true otherwise.
+--
+-- NOTES:
+-- Queues the responses as pieces of the response run, as many responses to a piece as the run has.
+--------------------------------------------------------------------------------------------------*/
+bool httpRespond(struct handler_conn *conn, const int count)
+{
+    for (int left = count; left > 0; left -= responseCopies)
+    {
+        int run = left < responseCopies ? left : responseCopies;
+
+        if (!handlerQueue(conn, responseRun, run * responseLength))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                httpRespondAndClose
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Send the close headers and the shared body.
+--                          Oct 18, 2026 - Rely on the backend to send the flushed rest before closing.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool httpRespondAndClose(struct handler_conn *conn, const int count,
+--                                                   const bool badRequest)
+--                              struct handler_conn *conn: The connection to answer.
+--                              const int count: The number of keep alive responses owed before.
+--                              const bool badRequest: Whether to answer the last request with a 400.
+--
+-- RETURNS:                 False, so that the connection is closed.
+--
+-- NOTES:
+-- Queues the responses owed and the last one, which says the connection closes, and flushes them
+-- right away since what a callback that gives up its connection has not flushed is dropped. The
+-- backend still sends all that was flushed before it closes the connection.
+--------------------------------------------------------------------------------------------------*/
+bool httpRespondAndClose(struct handler_conn *conn, const int count, const bool badRequest)
+{
+    if (httpRespond(conn, count))
+    {
+        if (badRequest)
+        {
+            handlerQueue(conn, badResponse, sizeof(badResponse) - 1);
+        }
+        else
+        {
+            handlerQueue(conn, responses, closeHeadersLength);
+            handlerQueue(conn, body, bodyLength);
+        }
+        handlerFlush(conn, false);
+    }
+
+    return false;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                httpFindEndScalar
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               size_t httpFindEndScalar(const char *data, const size_t len)
+--                              const char *data: The data to search.
+--                              const size_t len: The length of data.
+--
+-- RETURNS:                 The length of the request up to and with the first blank line, 0 if
+--                          there is none.
+--------------------------------------------------------------------------------------------------*/
+size_t httpFindEndScalar(const char *data, const size_t len)
+{
+    for (size_t i = 0; i + 4 <= len; i++)
+    {
+        if (data[i] == '\r' && data[i + 1] == '\n' && data[i + 2] == '\r' && data[i + 3] == '\n')
+        {
+            return i + 4;
+        }
+    }
+
+    return 0;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                httpFindByteScalar
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               size_t httpFindByteScalar(const char *data, const size_t len, const char c)
+--                              const char *data: The data to search.
+--                              const size_t len: The length of data.
+--                              const char c: The byte to find.
+--
+-- RETURNS:                 The index of the first c, len if there is none.
+--------------------------------------------------------------------------------------------------*/
+size_t httpFindByteScalar(const char *data, const size_t len, const char c)
+{
+    size_t i = 0;
+
+    while (i < len && data[i] != c)
+    {
+        i++;
+    }
+
+    return i;
+}
+
+#if defined(__x86_64__)
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                httpFindEndSse2
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               size_t httpFindEndSse2(const char *data, const size_t len)
+--                              const char *data: The data to search.
+--                              const size_t len: The length of data.
+--
+-- RETURNS:                 The length of the request up to and with the first blank line, 0 if
+--                          there is none.
+--
+-- NOTES:
+-- Compares 16 positions at once: the bytes at each position and the 3 after it are loaded as four
+-- overlapping vectors, and a position starts "\r\n\r\n" if all four compare equal. The last few
+-- bytes that do not fill a vector are searched by httpFindEndScalar().
+--------------------------------------------------------------------------------------------------*/
+size_t httpFindEndSse2(const char *data, const size_t len)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    size_t i = 0;
+    size_t end;
+
+    for (; i + 16 + 3 <= len; i += 16)
+    {
+        __m128i first = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i)), cr);
+        __m128i second = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i + 1)), lf);
+        __m128i third = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i + 2)), cr);
+        __m128i fourth = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i + 3)), lf);
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(first, second), _mm_and_si128(third, fourth)));
+
+        if (mask)
+        {
+            return i + __builtin_ctz(mask) + 4;
+        }
+    }
+
+    end = httpFindEndScalar(data + i, len - i);
+    return end ? i + end : 0;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                httpFindEndAvx2
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               size_t httpFindEndAvx2(const char *data, const size_t len)
+--                              const char *data: The data to search.
+--                              const size_t len: The length of data.
+--
+-- RETURNS:                 The length of the request up to and with the first blank line, 0 if
+--                          there is none.
+--
+-- NOTES:
+-- httpFindEndSse2() with 32 positions at once. Only called on cpus that have AVX2.
+--------------------------------------------------------------------------------------------------*/
+__attribute__((target("avx2"))) size_t httpFindEndAvx2(const char *data, const size_t len)
+{
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    size_t i = 0;
+    size_t end;
+
+    for (; i + 32 + 3 <= len; i += 32)
+    {
+        __m256i first = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i)), cr);
+        __m256i second = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i + 1)), lf);
+        __m256i third = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i + 2)), cr);
+        __m256i fourth = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i + 3)), lf);
+        unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(first, second),
+                                                              _mm256_and_si256(third, fourth)));
+
+        if (mask)
+        {
+            return i + __builtin_ctz(mask) + 4;
+        }
+    }
+
+    end = httpFindEndSse2(data + i, len - i);
+    return end ? i + end : 0;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                httpFindByteSse2
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               size_t httpFindByteSse2(const char *data, const size_t len, const char c)
+--                              const char *data: The data to search.
+--                              const size_t len: The length of data.
+--                              const char c: The byte to find.
+--
+-- RETURNS:                 The index of the first c, len if there is none.
+--------------------------------------------------------------------------------------------------*/
+size_t httpFindByteSse2(const char *data, const size_t len, const char c)
+{
+    const __m128i wanted = _mm_set1_epi8(c);
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16)
+    {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i)), wanted));
+
+        if (mask)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+
+    return i + httpFindByteScalar(data + i, len - i, c);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                httpFindByteAvx2
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               size_t httpFindByteAvx2(const char *data, const size_t len, const char c)
+--                              const char *data: The data to search.
+--                              const size_t len: The length of data.
+--                              const char c: The byte to find.
+--
+-- RETURNS:                 The index of the first c, len if there is none.
+--
+-- NOTES:
+-- Only called on cpus that have AVX2.
+--------------------------------------------------------------------------------------------------*/
+__attribute__((target("avx2"))) size_t httpFindByteAvx2(const char *data, const size_t len, const char c)
+{
+    const __m256i wanted = _mm256_set1_epi8(c);
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32)
+    {
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i)),
+                                                               wanted));
+
+        if (mask)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+
+    return i + httpFindByteSse2(data + i, len - i, c);
+}
+#endif
@@ -0,0 +1,51 @@
+#ifndef HTTP_H
+#define HTTP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "handler.h"
+
+// the longest request line and headers a client may send, a longer request gets a 400
+#define HTTP_MAX_REQUEST 8192
+// copies of the response laid out back to back, so pipelined answers go out as one piece
+#define HTTP_RESPONSE_RUN 16
+// the most bytes the copies may take, a response longer than this is laid out once
+#define HTTP_RESPONSE_RUN_BYTES (64 * 1024)
+
+// the start of a request that did not fit in the last read
+struct http_state
+{
+    char *partial;
+    size_t length;
+    // bytes of a request body still to be read past
+    size_t skip;
+};
+
+struct http_request
+{
+    bool keepAlive;
+    size_t bodyLength;
+};
+
+extern const struct protocol_handler httpHandler;
+
+bool httpInit(const char *bodyPath);
+bool httpAccept(struct handler_conn *conn);
+bool httpData(struct handler_conn *conn, const char *data, const size_t len);
+void httpClose(struct handler_conn *conn);
+bool httpParse(const char *request, const size_t len, struct http_request *parsed);
+bool httpHeaderHas(const char *value, const size_t len, const char *token);
+bool httpRespond(struct handler_conn *conn, const int count);
+bool httpRespondAndClose(struct handler_conn *conn, const int count, const bool badRequest);
+
+size_t httpFindEndScalar(const char *data, const size_t len);
+size_t httpFindByteScalar(const char *data, const size_t len, const char c);
+#if defined(__x86_64__)
+size_t httpFindEndSse2(const char *data, const size_t len);
+size_t httpFindEndAvx2(const char *data, const size_t len);
+size_t httpFindByteSse2(const char *data, const size_t len, const char c);
+size_t httpFindByteAvx2(const char *data, const size_t len, const char c);
+#endif
+
+#endif // HTTP_H
@@ -0,0 +1,966 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            loadgen.c
+--
+-- PROGRAM:                loadgen.out
+--
+-- FUNCTIONS:
+--                         int main(int argc, char *argv[])
+--                         void parseArguments(int argc, char *argv[])
+--                         void printHelp(const char *name)
+--                         void runLoad(const double rate, struct loadgen_stats *total, struct histogram *latency)
+--                         void *loadgenWorker(void *args)
+--                         bool startConnection(struct loadgen_thread *thread, struct loadgen_conn *conn, const int index)
+--                         bool progressConnection(struct loadgen_thread *thread, struct loadgen_conn *conn)
+--                         void finishConnection(struct loadgen_thread *thread, struct loadgen_conn *conn, const bool failed)
+--                         void scheduleMessages(struct loadgen_thread *thread, const uint64_t now)
+--                         uint64_t intendedNs(const struct loadgen_thread *thread, const uint64_t message)
+--                         uint64_t nowNs()
+--                         void printReport(const struct loadgen_stats *stats)
+--                         void printLatency(const struct histogram *latency)
+--                         void printSweepRow(const double rate, const struct loadgen_stats *stats, const struct histogram *latency)
+--
+-- DATE:                   Oct 17, 2026
+--
+-- REVISIONS:              Oct 17, 2026 - Pipeline messages and send them as frames.
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- A load generator for the echo server that runs on a single host.
+--
+-- Every connection sends a message, waits for the whole echo, waits the configured delay and sends
+-- the next one until it sent its number of messages, then closes. Connections are spread over the
+-- worker threads, each running its own edge triggered epoll loop. Against a loopback server the
+-- connections are bound to 127.0.0.1, 127.0.0.2, ... in turn so that the number of connections is
+-- not limited by the ephemeral ports of a single source address.
+--
+-- With -r the connections run open loop instead. Once every connection of a thread is open, the
+-- thread hands out messages round robin on a fixed schedule that adds up to the target rate, no
+-- matter whether the earlier echoes are back. The latency of each echo is measured from the time
+-- its message was meant to be sent rather than when it actually went out, so a server that stalls
+-- is charged for every message that should have been sent during the stall and not only for the one
+-- that was waiting on it. With -S the run is repeated at increasing rates up to -r to show how the
+-- latency grows with the load.
+--
+-- With -q a closed loop connection keeps that many messages in flight instead of one, sending the
+-- next as soon as the echo of the oldest is back. With -F every message is a frame for the frame
+-- handler of the server, its header holding the length of the rest and the number of the message.
+--
+-- For usage see the printHelp() function or README.md file.
+---------------------------------------------------------------------------------------*/
+#include "loadgen.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tools.h"
+
+#define MAX_EVENTS 256
+#define SCRATCH_SIZE (64 * 1024)
+
+struct loadgen_config config;
+char *payload;
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                main
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int main(int argc, char *argv[])
+--                              int argc: The number of command line arguments.
+--                              char *argv[]: The command line arguments.
+--
+-- RETURNS:                 The exit code of the program.
+--
+-- NOTES:
+-- The main entry point of the program. Raises the open file limit and does a single run, or with -S
+-- one run per step of the sweep, printing the results of each.
+--------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+    struct rlimit limit;
+    struct loadgen_stats total;
+    struct histogram *latency;
+    bool failed = false;
+
+    parseArguments(argc, argv);
+
+    // every connection needs a descriptor
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    if ((payload = malloc(config.size)) == NULL || (latency = malloc(sizeof(struct histogram))) == NULL)
+    {
+        systemFatal("malloc");
+    }
+    for (int i = 0; i < config.size; i++)
+    {
+        payload[i] = 'a' + i % 26;
+    }
+
+    if (config.steps > 0)
+    {
+        printf("%12s %12s %10s %10s %10s %10s\n", "offered/s", "achieved/s", "p50(us)", "p99(us)", "p99.9(us)",
+               "max(us)");
+        for (int i = 1; i <= config.steps; i++)
+        {
+            double rate = config.rate * i / config.steps;
+
+            runLoad(rate, &total, latency);
+            printSweepRow(rate, &total, latency);
+            failed = failed || total.failed;
+        }
+    }
+    else
+    {
+        runLoad(config.rate, &total, latency);
+        printReport(&total);
+        if (config.rate > 0)
+        {
+            printLatency(latency);
+        }
+        failed = total.failed;
+    }
+
+    free(latency);
+    free(payload);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                parseArguments
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Add -q and -F.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void parseArguments(int argc, char *argv[])
+--                              int argc: Argc from main.
+--                              char *argv[]: Argv from main.
+--
+-- NOTES:
+-- Parses the command line arguments and configures the approriate settings.
+--------------------------------------------------------------------------------------------------*/
+void parseArguments(int argc, char *argv[])
+{
+    int c;
+
+    strcpy(config.host, "127.0.0.1");
+    config.port = 0;
+    config.connections = 1000;
+    config.size = 100;
+    config.messages = 10;
+    config.delayMs = 0;
+    config.addresses = 16;
+    config.threads = 1;
+    config.rate = 0;
+    config.steps = 0;
+    config.depth = 1;
+    config.framed = false;
+
+    while ((c = getopt(argc, argv, "h:p:c:s:n:d:a:t:r:S:q:F")) != -1)
+    {
+        switch (c)
+        {
+        case 'h':
+            strncpy(config.host, optarg, sizeof(config.host) - 1);
+            break;
+        case 'p':
+            config.port = atoi(optarg);
+            break;
+        case 'c':
+            config.connections = atoi(optarg);
+            break;
+        case 's':
+            config.size = atoi(optarg);
+            break;
+        case 'n':
+            config.messages = atoi(optarg);
+            break;
+        case 'd':
+            config.delayMs = atoi(optarg);
+            break;
+        case 'a':
+            config.addresses = atoi(optarg);
+            break;
+        case 't':
+            config.threads = atoi(optarg);
+            break;
+        case 'r':
+            config.rate = atof(optarg);
+            break;
+        case 'S':
+            config.steps = atoi(optarg);
+            break;
+        case 'q':
+            config.depth = atoi(optarg);
+            break;
+        case 'F':
+            config.framed = true;
+            break;
+        default:
+            printHelp(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (!config.port || config.connections < 1 || config.size < 1 || config.messages < 1
+        || config.delayMs < 0 || config.addresses < 1 || config.addresses > 254 || config.threads < 1
+        || config.rate < 0 || config.steps < 0 || config.depth < 1)
+    {
+        printHelp(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    // the schedule decides when an open loop connection sends, not the echoes
+    if (config.rate > 0 && config.delayMs > 0)
+    {
+        fprintf(stderr, "-d can not be used with -r\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // the schedule or the delay decide when the next message goes out
+    if (config.depth > 1 && (config.rate > 0 || config.delayMs > 0))
+    {
+        fprintf(stderr, "-q can not be used with -r or -d\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (config.framed && config.size < FRAME_HEADER_SIZE)
+    {
+        fprintf(stderr, "A frame needs at least %d bytes\n", FRAME_HEADER_SIZE);
+        exit(EXIT_FAILURE);
+    }
+
+    if (config.steps > 0 && config.rate == 0)
+    {
+        fprintf(stderr, "-S needs the highest rate of the sweep given with -r\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (config.threads > config.connections)
+    {
+        config.threads = config.connections;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                printHelp
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Add -q and -F.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void printHelp(const char *name)
+--                              name: The name of the application.
+--
+-- NOTES:
+-- Prints the help menu with instructions on how to run the program.
+--------------------------------------------------------------------------------------------------*/
+void printHelp(const char *name)
+{
+    fprintf(stderr, "Usage: %s -p [port] [-h host] [-c connections] [-s size] [-n messages] [-d delay]"
+                    " [-a addresses] [-t threads] [-r rate] [-S steps] [-q depth] [-F]\n", name);
+    fprintf(stderr, "    -p - The port of the server.\n");
+    fprintf(stderr, "    -h - The address of the server. Default 127.0.0.1.\n");
+    fprintf(stderr, "    -c - The number of connections. Default 1000.\n");
+    fprintf(stderr, "    -s - The size of each message in bytes. Default 100.\n");
+    fprintf(stderr, "    -n - The number of messages per connection. Default 10.\n");
+    fprintf(stderr, "    -d - The delay between the messages of a connection in ms. Default 0.\n");
+    fprintf(stderr, "    -a - Loopback only. The number of 127.0.0.x source addresses to use. Default 16.\n");
+    fprintf(stderr, "    -t - The number of threads. Default 1.\n");
+    fprintf(stderr, "    -r - Run open loop, sending this many messages per second over all connections.\n");
+    fprintf(stderr, "    -S - With -r, sweep the rate from -r / steps up to -r in this many runs.\n");
+    fprintf(stderr, "    -q - The messages each connection keeps in flight without -r. Default 1.\n");
+    fprintf(stderr, "    -F - Send every message as a frame for the frame handler of the server.\n");
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                runLoad
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void runLoad(const double rate, struct loadgen_stats *total,
+--                                       struct histogram *latency)
+--                              const double rate: The messages per second to offer, 0 for closed loop.
+--                              struct loadgen_stats *total: Set to the combined results.
+--                              struct histogram *latency: Set to the combined open loop latencies.
+--
+-- NOTES:
+-- Starts the worker threads with an equal share of the connections and the rate, waits for them and
+-- combines what they measured.
+--------------------------------------------------------------------------------------------------*/
+void runLoad(const double rate, struct loadgen_stats *total, struct histogram *latency)
+{
+    struct loadgen_thread *threads;
+
+    if ((threads = calloc(config.threads, sizeof(struct loadgen_thread))) == NULL)
+    {
+        systemFatal("calloc");
+    }
+
+    memset(total, 0, sizeof(struct loadgen_stats));
+    histogramReset(latency);
+
+    total->startNs = nowNs();
+
+    for (int i = 0; i < config.threads; i++)
+    {
+        threads[i].id = i;
+        threads[i].rate = rate / config.threads;
+        if (pthread_create(&threads[i].thread, NULL, loadgenWorker, &threads[i]))
+        {
+            systemFatal("pthread_create");
+        }
+    }
+
+    for (int i = 0; i < config.threads; i++)
+    {
+        pthread_join(threads[i].thread, NULL);
+
+        total->connected += threads[i].stats.connected;
+        total->failed += threads[i].stats.failed;
+        total->messages += threads[i].stats.messages;
+        total->bytesSent += threads[i].stats.bytesSent;
+        total->bytesReceived += threads[i].stats.bytesReceived;
+        if (threads[i].stats.lastConnectNs > total->lastConnectNs)
+        {
+            total->lastConnectNs = threads[i].stats.lastConnectNs;
+        }
+        histogramMerge(latency, &threads[i].latency);
+    }
+
+    total->endNs = nowNs();
+
+    free(threads);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                loadgenWorker
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void *loadgenWorker(void *args)
+--                              void *args: The loadgen_thread of this worker.
+--
+-- RETURNS:                 NULL - unused.
+--
+-- NOTES:
+-- The main function of each worker thread. Opens its share of the connections and drives them until
+-- all of them are done. Connections waiting out their delay sit in a queue that is ordered by due
+-- time since every connection waits the same delay. In open loop mode the wait is instead until the
+-- next message of the schedule is due, with a nanosecond timeout so that the messages do not bunch up
+-- on millisecond ticks.
+--------------------------------------------------------------------------------------------------*/
+void *loadgenWorker(void *args)
+{
+    struct epoll_event events[MAX_EVENTS];
+    struct loadgen_thread *thread = (struct loadgen_thread *)args;
+
+    thread->count = config.connections / config.threads
+                    + (thread->id < config.connections % config.threads ? 1 : 0);
+    histogramReset(&thread->latency);
+
+    if ((thread->epoll_fd = epoll_create1(0)) == -1)
+    {
+        systemFatal("epoll_create1");
+    }
+
+    if ((thread->conns = calloc(thread->count, sizeof(struct loadgen_conn))) == NULL
+        || (thread->timers = calloc(thread->count + 1, sizeof(struct loadgen_conn *))) == NULL
+        || (thread->scratch = malloc(SCRATCH_SIZE)) == NULL)
+    {
+        systemFatal("calloc");
+    }
+
+    for (int i = 0; i < thread->count; i++)
+    {
+        thread->conns[i].index = i;
+        if (startConnection(thread, &thread->conns[i], thread->id + i * config.threads))
+        {
+            thread->active++;
+            thread->connecting++;
+        }
+        else
+        {
+            thread->conns[i].state = LOADGEN_DONE;
+            thread->stats.failed++;
+        }
+    }
+
+    while (thread->active > 0)
+    {
+        struct timespec timeout;
+        uint64_t due = UINT64_MAX;
+        uint64_t now = nowNs();
+        int nReady;
+
+        // the open loop schedule starts once every connection is open
+        if (thread->rate > 0 && thread->connecting == 0 && thread->scheduleNs == 0)
+        {
+            thread->scheduleNs = now;
+        }
+
+        if (thread->timerHead != thread->timerTail)
+        {
+            due = thread->timers[thread->timerHead]->due;
+        }
+        if (thread->scheduleNs && thread->nextMessage < (uint64_t)thread->count * config.messages
+            && intendedNs(thread, thread->nextMessage) < due)
+        {
+            due = intendedNs(thread, thread->nextMessage);
+        }
+        if (due != UINT64_MAX)
+        {
+            uint64_t wait = due > now ? due - now : 0;
+            timeout.tv_sec = wait / 1000000000;
+            timeout.tv_nsec = wait % 1000000000;
+        }
+
+        if ((nReady = epoll_pwait2(thread->epoll_fd, events, MAX_EVENTS, due != UINT64_MAX ? &timeout : NULL,
+                                   NULL)) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            systemFatal("epoll_pwait2");
+        }
+
+        for (int i = 0; i < nReady; i++)
+        {
+            struct loadgen_conn *conn = events[i].data.ptr;
+
+            if (conn->state != LOADGEN_DONE && !progressConnection(thread, conn))
+            {
+                finishConnection(thread, conn, true);
+            }
+        }
+
+        now = nowNs();
+        while (thread->timerHead != thread->timerTail && thread->timers[thread->timerHead]->due <= now)
+        {
+            struct loadgen_conn *conn = thread->timers[thread->timerHead];
+            thread->timerHead = (thread->timerHead + 1) % (thread->count + 1);
+
+            conn->state = LOADGEN_MESSAGE;
+            conn->scheduled++;
+            if (!progressConnection(thread, conn))
+            {
+                finishConnection(thread, conn, true);
+            }
+        }
+
+        if (thread->scheduleNs)
+        {
+            scheduleMessages(thread, now);
+        }
+    }
+
+    close(thread->epoll_fd);
+    free(thread->conns);
+    free(thread->timers);
+    free(thread->scratch);
+
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                startConnection
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool startConnection(struct loadgen_thread *thread, struct loadgen_conn *conn,
+--                                               const int index)
+--                              struct loadgen_thread *thread: The worker.
+--                              struct loadgen_conn *conn: The connection to open.
+--                              const int index: The index of the connection over all workers.
+--
+-- RETURNS:                 True if the connect was started, false otherwise.
+--
+-- NOTES:
+-- Starts a non-blocking connect. For a loopback server the socket is first bound to source address
+-- 127.0.0.(1 + index % addresses) with the port left to connect so that every source address has its
+-- own range of ephemeral ports.
+--------------------------------------------------------------------------------------------------*/
+bool startConnection(struct loadgen_thread *thread, struct loadgen_conn *conn, const int index)
+{
+    struct sockaddr_in server;
+    struct epoll_event event;
+
+    conn->state = LOADGEN_CONNECTING;
+
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_port = htons(config.port);
+    if (inet_pton(AF_INET, config.host, &server.sin_addr) != 1)
+    {
+        fprintf(stderr, "Invalid address %s\n", config.host);
+        exit(EXIT_FAILURE);
+    }
+
+    if ((conn->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1)
+    {
+        perror("socket");
+        return false;
+    }
+
+    if ((ntohl(server.sin_addr.s_addr) >> 24) == 127 && config.addresses > 1)
+    {
+        const int arg = 1;
+        struct sockaddr_in source;
+
+        memset(&source, 0, sizeof(source));
+        source.sin_family = AF_INET;
+        source.sin_addr.s_addr = htonl(0x7f000001 + index % config.addresses);
+
+        setsockopt(conn->fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &arg, sizeof(arg));
+        if (bind(conn->fd, (struct sockaddr *)&source, sizeof(source)) == -1)
+        {
+            perror("bind");
+            close(conn->fd);
+            return false;
+        }
+    }
+
+    if (connect(conn->fd, (struct sockaddr *)&server, sizeof(server)) == -1 && errno != EINPROGRESS)
+    {
+        perror("connect");
+        close(conn->fd);
+        return false;
+    }
+
+    event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    event.data.ptr = conn;
+    if (epoll_ctl(thread->epoll_fd, EPOLL_CTL_ADD, conn->fd, &event) == -1)
+    {
+        systemFatal("epoll_ctl");
+    }
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                progressConnection
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Keep -q messages in flight and send frame headers.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool progressConnection(struct loadgen_thread *thread, struct loadgen_conn *conn)
+--                              struct loadgen_thread *thread: The worker.
+--                              struct loadgen_conn *conn: The connection that is ready.
+--
+-- RETURNS:                 False if the connection failed, true otherwise.
+--
+-- NOTES:
+-- Moves the connection along as far as the socket allows. Sending and receiving the echo happen
+-- together so that a message bigger than the socket buffers can not deadlock against the server.
+-- Both directions are driven until EAGAIN since the socket is edge triggered.
+--
+-- The connection sends every message scheduled so far, and since every message has the same size a
+-- message is done once that many bytes of echo have come back. A closed loop connection schedules
+-- messages until -q of them are waiting for their echo, an open loop one when scheduleMessages()
+-- hands it one. A frame is sent as its own header followed by the payload, both in one sendmsg.
+--------------------------------------------------------------------------------------------------*/
+bool progressConnection(struct loadgen_thread *thread, struct loadgen_conn *conn)
+{
+    if (conn->state == LOADGEN_CONNECTING)
+    {
+        int error = 0;
+        socklen_t length = sizeof(error);
+
+        if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &length) == -1 || error)
+        {
+            errno = error;
+            return false;
+        }
+
+        thread->stats.connected++;
+        thread->stats.lastConnectNs = nowNs();
+        thread->connecting--;
+        conn->state = LOADGEN_MESSAGE;
+
+        // closed loop connections send their first messages right away
+        if (thread->rate == 0)
+        {
+            conn->scheduled = config.depth < config.messages ? config.depth : config.messages;
+        }
+    }
+
+    while (conn->state == LOADGEN_MESSAGE)
+    {
+        uint64_t target = (uint64_t)conn->scheduled * config.size;
+        ssize_t n;
+
+        while (conn->sent < target)
+        {
+            int offset = conn->sent % config.size;
+
+            if (config.framed && offset < FRAME_HEADER_SIZE)
+            {
+                struct frame_header frame;
+                struct iovec iov[2];
+                struct msghdr msg;
+
+                frame.length = htonl(config.size - FRAME_HEADER_SIZE);
+                frame.id = htonl(conn->sent / config.size);
+                memcpy(conn->header, &frame, sizeof(frame));
+
+                iov[0].iov_base = conn->header + offset;
+                iov[0].iov_len = FRAME_HEADER_SIZE - offset;
+                iov[1].iov_base = payload + FRAME_HEADER_SIZE;
+                iov[1].iov_len = config.size - FRAME_HEADER_SIZE;
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_iov = iov;
+                msg.msg_iovlen = 2;
+                n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+            }
+            else
+            {
+                n = send(conn->fd, payload + offset, config.size - offset, MSG_NOSIGNAL);
+            }
+
+            if (n > 0)
+            {
+                conn->sent += n;
+                thread->stats.bytesSent += n;
+            }
+            else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            else if (errno != EINTR)
+            {
+                return false;
+            }
+        }
+
+        while (conn->received < conn->sent)
+        {
+            uint64_t wanted = conn->sent - conn->received;
+
+            n = recv(conn->fd, thread->scratch, wanted < SCRATCH_SIZE ? wanted : SCRATCH_SIZE, 0);
+            if (n > 0)
+            {
+                conn->received += n;
+                thread->stats.bytesReceived += n;
+            }
+            else if (n == 0)
+            {
+                return false;
+            }
+            else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            else if (errno != EINTR)
+            {
+                return false;
+            }
+        }
+
+        // count every message whose whole echo is back
+        if (conn->received >= (uint64_t)(conn->completed + 1) * config.size)
+        {
+            uint64_t now = nowNs();
+
+            while (conn->received >= (uint64_t)(conn->completed + 1) * config.size)
+            {
+                if (thread->rate > 0)
+                {
+                    uint64_t intended = intendedNs(thread, (uint64_t)conn->completed * thread->count + conn->index);
+                    histogramRecord(&thread->latency, now > intended ? now - intended : 0);
+                }
+                conn->completed++;
+                thread->stats.messages++;
+            }
+        }
+
+        if (conn->completed == config.messages)
+        {
+            finishConnection(thread, conn, false);
+        }
+        else if (thread->rate == 0 && config.delayMs == 0 && conn->scheduled < config.messages
+                 && conn->scheduled < conn->completed + config.depth)
+        {
+            conn->scheduled = conn->completed + config.depth < config.messages
+                                  ? conn->completed + config.depth : config.messages;
+        }
+        else if (thread->rate > 0 || conn->completed < conn->scheduled)
+        {
+            return true;
+        }
+        else
+        {
+            conn->state = LOADGEN_WAITING;
+            conn->due = nowNs() + (uint64_t)config.delayMs * 1000000;
+            thread->timers[thread->timerTail] = conn;
+            thread->timerTail = (thread->timerTail + 1) % (thread->count + 1);
+        }
+    }
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                finishConnection
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void finishConnection(struct loadgen_thread *thread, struct loadgen_conn *conn,
+--                                                const bool failed)
+--                              struct loadgen_thread *thread: The worker.
+--                              struct loadgen_conn *conn: The connection that is done.
+--                              const bool failed: Whether the connection ended with an error.
+--
+-- NOTES:
+-- Closes the connection and counts it as done.
+--------------------------------------------------------------------------------------------------*/
+void finishConnection(struct loadgen_thread *thread, struct loadgen_conn *conn, const bool failed)
+{
+    if (failed)
+    {
+        thread->stats.failed++;
+    }
+
+    if (conn->state == LOADGEN_CONNECTING)
+    {
+        thread->connecting--;
+    }
+
+    conn->state = LOADGEN_DONE;
+    close(conn->fd);
+    thread->active--;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                scheduleMessages
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void scheduleMessages(struct loadgen_thread *thread, const uint64_t now)
+--                              struct loadgen_thread *thread: The worker.
+--                              const uint64_t now: The current time.
+--
+-- NOTES:
+-- Hands out every open loop message that is due by now. Message k of the thread goes to connection
+-- k % count, so each connection gets one message per round over all connections. Messages of
+-- connections that already failed are skipped.
+--------------------------------------------------------------------------------------------------*/
+void scheduleMessages(struct loadgen_thread *thread, const uint64_t now)
+{
+    const uint64_t total = (uint64_t)thread->count * config.messages;
+
+    while (thread->nextMessage < total && intendedNs(thread, thread->nextMessage) <= now)
+    {
+        struct loadgen_conn *conn = &thread->conns[thread->nextMessage % thread->count];
+        thread->nextMessage++;
+
+        if (conn->state == LOADGEN_DONE)
+        {
+            continue;
+        }
+
+        conn->scheduled++;
+        if (!progressConnection(thread, conn))
+        {
+            finishConnection(thread, conn, true);
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                intendedNs
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               uint64_t intendedNs(const struct loadgen_thread *thread, const uint64_t message)
+--                              const struct loadgen_thread *thread: The worker.
+--                              const uint64_t message: The number of the message in the thread's schedule.
+--
+-- RETURNS:                 The time the message is meant to be sent at.
+--------------------------------------------------------------------------------------------------*/
+uint64_t intendedNs(const struct loadgen_thread *thread, const uint64_t message)
+{
+    return thread->scheduleNs + (uint64_t)(message * 1e9 / thread->rate);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                nowNs
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               uint64_t nowNs()
+--
+-- RETURNS:                 The monotonic time in nanoseconds.
+--------------------------------------------------------------------------------------------------*/
+uint64_t nowNs()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                printReport
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void printReport(const struct loadgen_stats *stats)
+--                              const struct loadgen_stats *stats: The combined results.
+--
+-- NOTES:
+-- Prints the connection, message and byte rates of the run. The connection rate is measured up to
+-- the last successful connect, the other rates over the whole run.
+--------------------------------------------------------------------------------------------------*/
+void printReport(const struct loadgen_stats *stats)
+{
+    double seconds = (stats->endNs - stats->startNs) / 1e9;
+    double connectSeconds = stats->lastConnectNs > stats->startNs ? (stats->lastConnectNs - stats->startNs) / 1e9
+                                                                   : seconds;
+
+    printf("connections: %lu connected, %lu failed in %.3fs (%.0f/s)\n",
+           stats->connected, stats->failed, connectSeconds, stats->connected / connectSeconds);
+    printf("messages:    %lu in %.3fs (%.0f/s)\n", stats->messages, seconds, stats->messages / seconds);
+    printf("bytes:       %lu sent, %lu received (%.0f/s)\n",
+           stats->bytesSent, stats->bytesReceived, stats->bytesReceived / seconds);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                printLatency
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void printLatency(const struct histogram *latency)
+--                              const struct histogram *latency: The open loop latencies.
+--
+-- NOTES:
+-- Prints the percentiles of the open loop latencies in microseconds.
+--------------------------------------------------------------------------------------------------*/
+void printLatency(const struct histogram *latency)
+{
+    printf("latency:     p50 %.1fus, p99 %.1fus, p99.9 %.1fus, max %.1fus\n",
+           histogramPercentile(latency, 50) / 1e3, histogramPercentile(latency, 99) / 1e3,
+           histogramPercentile(latency, 99.9) / 1e3, latency->max / 1e3);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                printSweepRow
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void printSweepRow(const double rate, const struct loadgen_stats *stats,
+--                                             const struct histogram *latency)
+--                              const double rate: The rate that was offered.
+--                              const struct loadgen_stats *stats: The results of the run.
+--                              const struct histogram *latency: The latencies of the run.
+--
+-- NOTES:
+-- Prints one line of the sweep table. The achieved rate is measured from the last connect, when the
+-- schedule started, so that opening the connections does not count against it.
+--------------------------------------------------------------------------------------------------*/
+void printSweepRow(const double rate, const struct loadgen_stats *stats, const struct histogram *latency)
+{
+    uint64_t start = stats->lastConnectNs > stats->startNs ? stats->lastConnectNs : stats->startNs;
+    double seconds = (stats->endNs - start) / 1e9;
+
+    printf("%12.0f %12.0f %10.1f %10.1f %10.1f %10.1f\n", rate, stats->messages / seconds,
+           histogramPercentile(latency, 50) / 1e3, histogramPercentile(latency, 99) / 1e3,
+           histogramPercentile(latency, 99.9) / 1e3, latency->max / 1e3);
+}
@@ -0,0 +1,92 @@
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "frame.h"
+#include "histogram.h"
+
+#define LOADGEN_CONNECTING 0
+#define LOADGEN_MESSAGE 1
+#define LOADGEN_WAITING 2
+#define LOADGEN_DONE 3
+
+struct loadgen_config
+{
+    char host[64];
+    short port;
+    int connections;
+    int size;
+    int messages;
+    int delayMs;
+    int addresses;
+    int threads;
+    double rate;
+    int steps;
+    int depth;
+    bool framed;
+};
+
+struct loadgen_conn
+{
+    int fd;
+    int state;
+    int index;
+    int scheduled;
+    int completed;
+    uint64_t sent;
+    uint64_t received;
+    uint64_t due;
+    // the header of the message being sent with -F
+    char header[FRAME_HEADER_SIZE];
+};
+
+struct loadgen_stats
+{
+    uint64_t connected;
+    uint64_t failed;
+    uint64_t messages;
+    uint64_t bytesSent;
+    uint64_t bytesReceived;
+    uint64_t startNs;
+    uint64_t lastConnectNs;
+    uint64_t endNs;
+};
+
+struct loadgen_thread
+{
+    int id;
+    pthread_t thread;
+    int epoll_fd;
+    int count;
+    int active;
+    int connecting;
+    struct loadgen_conn *conns;
+    struct loadgen_conn **timers;
+    int timerHead;
+    int timerTail;
+    double rate;
+    uint64_t scheduleNs;
+    uint64_t nextMessage;
+    char *scratch;
+    struct loadgen_stats stats;
+    struct histogram latency;
+};
+
+void parseArguments(int argc, char *argv[]);
+void printHelp(const char *name);
+void runLoad(const double rate, struct loadgen_stats *total, struct histogram *latency);
+void *loadgenWorker(void *args);
+bool startConnection(struct loadgen_thread *thread, struct loadgen_conn *conn, const int index);
+bool progressConnection(struct loadgen_thread *thread, struct loadgen_conn *conn);
+void finishConnection(struct loadgen_thread *thread, struct loadgen_conn *conn, const bool failed);
+void scheduleMessages(struct loadgen_thread *thread, const uint64_t now);
+uint64_t intendedNs(const struct loadgen_thread *thread, const uint64_t message);
+uint64_t nowNs();
+void printReport(const struct loadgen_stats *stats);
+void printLatency(const struct histogram *latency);
+void printSweepRow(const double rate, const struct loadgen_stats *stats, const struct histogram *latency);
+
+#endif // LOADGEN_H
@@ -0,0 +1,260 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            logcat.c
+--
+-- PROGRAM:                logcat.out
+--
+-- FUNCTIONS:
+--                         int main(int argc, char *argv[])
+--                         void printCsv(const struct log_file *file, FILE *out)
+--                         void printSummary(const struct log_file *file, const char *name, FILE *out)
+--
+-- DATE:                   Oct 17, 2026
+--
+-- REVISIONS:              N/A
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- Reads a binary server log written with -l binary.
+--
+-- Usage: logcat.out [-s] [-o output] server.bin
+--     -s - Print the totals and per second counts that log_parser.py computes instead of the CSV.
+--     -o - Write to output instead of stdout.
+--
+-- Without -s the log is converted back to the CSV format of server.log.
+---------------------------------------------------------------------------------------*/
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "logfile.h"
+#include "tools.h"
+
+#define CSV_BUFFER_SIZE (1 << 20)
+
+void printCsv(const struct log_file *file, FILE *out);
+void printSummary(const struct log_file *file, const char *name, FILE *out);
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                main
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int main(int argc, char *argv[])
+--                              int argc: The number of command line arguments.
+--                              char *argv[]: The command line arguments.
+--
+-- RETURNS:                 The exit code of the program.
+--
+-- NOTES:
+-- The main entry point of the program.
+--------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+    int c;
+    int summary = 0;
+    FILE *out = stdout;
+    struct log_file file;
+
+    while ((c = getopt(argc, argv, "so:")) != -1)
+    {
+        switch (c)
+        {
+        case 's':
+            summary = 1;
+            break;
+        case 'o':
+            if ((out = fopen(optarg, "w")) == NULL)
+            {
+                systemFatal("fopen");
+            }
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-s] [-o output] server.bin\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind >= argc)
+    {
+        fprintf(stderr, "Usage: %s [-s] [-o output] server.bin\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (!openLogFile(&file, argv[optind]))
+    {
+        fprintf(stderr, "%s is not a binary server log of version %d\n", argv[optind], LOG_FILE_VERSION);
+        exit(EXIT_FAILURE);
+    }
+
+    if (summary)
+    {
+        printSummary(&file, argv[optind], out);
+    }
+    else
+    {
+        printCsv(&file, out);
+    }
+
+    closeLogFile(&file);
+    fclose(out);
+
+    return 0;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                printCsv
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void printCsv(const struct log_file *file, FILE *out)
+--                              const struct log_file *file: The binary log.
+--                              FILE *out: Where to write the CSV.
+--
+-- NOTES:
+-- Converts every record to its server.log line, writing the lines out in large blocks.
+--------------------------------------------------------------------------------------------------*/
+void printCsv(const struct log_file *file, FILE *out)
+{
+    char *buffer;
+    size_t length = 0;
+
+    if ((buffer = malloc(CSV_BUFFER_SIZE)) == NULL)
+    {
+        systemFatal("malloc");
+    }
+
+    for (size_t i = 0; i < file->count; i++)
+    {
+        if (CSV_BUFFER_SIZE - length < 64)
+        {
+            fwrite(buffer, 1, length, out);
+            length = 0;
+        }
+        length += formatRecord(buffer + length, CSV_BUFFER_SIZE - length, &file->records[i]);
+    }
+
+    fwrite(buffer, 1, length, out);
+    free(buffer);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                printSummary
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void printSummary(const struct log_file *file, const char *name, FILE *out)
+--                              const struct log_file *file: The binary log.
+--                              const char *name: The name of the log for the heading.
+--                              FILE *out: Where to write the summary.
+--
+-- NOTES:
+-- Prints the same block log_parser.py writes to parsed-logs.txt for one log: the total number of
+-- accepts, receives and sends and their counts per one second window. Receives and sends of zero
+-- bytes are not counted, and a new window starts at the first event more than a second after the
+-- start of the current one.
+--------------------------------------------------------------------------------------------------*/
+void printSummary(const struct log_file *file, const char *name, FILE *out)
+{
+    static const char *events[] = { "new", "rcv", "snd" };
+    size_t totals[3] = { 0, 0, 0 };
+    size_t current[3] = { 0, 0, 0 };
+    size_t capacity = 1024;
+    size_t windows = 0;
+    uint64_t windowStart = 0;
+    uint64_t *starts;
+    size_t *counts;
+
+    if ((starts = malloc(capacity * sizeof(uint64_t))) == NULL
+        || (counts = malloc(capacity * 3 * sizeof(size_t))) == NULL)
+    {
+        systemFatal("malloc");
+    }
+
+    for (size_t i = 0; i <= file->count; i++)
+    {
+        const struct log_record *record = i < file->count ? &file->records[i] : NULL;
+        uint64_t us = record != NULL ? record->ns / 1000 : 0;
+
+        // close the window at the end or once an event is past it
+        if (record == NULL || us > windowStart + 1000000)
+        {
+            if (current[0] || current[1] || current[2])
+            {
+                if (windows == capacity)
+                {
+                    capacity *= 2;
+                    if ((starts = realloc(starts, capacity * sizeof(uint64_t))) == NULL
+                        || (counts = realloc(counts, capacity * 3 * sizeof(size_t))) == NULL)
+                    {
+                        systemFatal("realloc");
+                    }
+                }
+
+                starts[windows] = windowStart;
+                for (int e = 0; e < 3; e++)
+                {
+                    counts[windows * 3 + e] = current[e];
+                    totals[e] += current[e];
+                    current[e] = 0;
+                }
+                windows++;
+            }
+            windowStart = us;
+        }
+
+        if (record != NULL && record->event >= LOG_EVENT_NEW && record->event <= LOG_EVENT_SND
+            && (record->event == LOG_EVENT_NEW || record->amount > 0))
+        {
+            current[record->event]++;
+        }
+    }
+
+    fprintf(out, "%s\ntotal:\n{\n", name);
+    for (int e = 0; e < 3; e++)
+    {
+        fprintf(out, "  \"%s\":%lu%s\n", events[e], totals[e], e < 2 ? "," : "");
+    }
+    fprintf(out, "}\ncount:\n{\n");
+    for (int e = 0; e < 3; e++)
+    {
+        int first = 1;
+
+        fprintf(out, "  \"%s\":[", events[e]);
+        for (size_t w = 0; w < windows; w++)
+        {
+            if (counts[w * 3 + e] == 0)
+            {
+                continue;
+            }
+            fprintf(out, "%s\n    [\n      %lu.%03lu,\n      %lu\n    ]", first ? "" : ",",
+                    starts[w] / 1000, starts[w] % 1000, counts[w * 3 + e]);
+            first = 0;
+        }
+        fprintf(out, "%s]%s\n", first ? "" : "\n  ", e < 2 ? "," : "");
+    }
+    fprintf(out, "}\n\n\n\n");
+
+    free(starts);
+    free(counts);
+}
@@ -0,0 +1,194 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            logfile.c
+--
+-- PROGRAM:                server.out, logcat.out
+--
+-- FUNCTIONS:
+--                         void initLogFileHeader(struct log_file_header *header, const uint64_t startNs)
+--                         bool openLogFile(struct log_file *file, const char *path)
+--                         void closeLogFile(struct log_file *file)
+--                         int formatRecord(char *line, const size_t size, const struct log_record *record)
+--
+-- DATE:                   Oct 17, 2026
+--
+-- REVISIONS:              N/A
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- The binary log format and a reader for it.
+--
+-- A binary log is a log_file_header followed by log_record structs exactly as the workers wrote them
+-- into their log rings. The header carries a version and the record size so that a reader can refuse
+-- files it does not understand. Files are read by mapping them, so iterating the records costs no
+-- parsing and no copies.
+---------------------------------------------------------------------------------------*/
+#include "logfile.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "tools.h"
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                initLogFileHeader
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void initLogFileHeader(struct log_file_header *header, const uint64_t startNs)
+--                              struct log_file_header *header: The header to fill in.
+--                              const uint64_t startNs: The time logging started in nanoseconds.
+--
+-- NOTES:
+-- Fills in the header of a binary log for the current version.
+--------------------------------------------------------------------------------------------------*/
+void initLogFileHeader(struct log_file_header *header, const uint64_t startNs)
+{
+    memset(header, 0, sizeof(struct log_file_header));
+    memcpy(header->magic, LOG_FILE_MAGIC, sizeof(header->magic));
+    header->version = LOG_FILE_VERSION;
+    header->recordSize = sizeof(struct log_record);
+    header->startNs = startNs;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                openLogFile
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool openLogFile(struct log_file *file, const char *path)
+--                              struct log_file *file: The reader to set up.
+--                              const char *path: The binary log to open.
+--
+-- RETURNS:                 True if the file is a binary log of a known version, false otherwise.
+--
+-- NOTES:
+-- Maps the binary log read only and checks its header. A partial record at the end, left by a server
+-- that was killed while writing, is ignored.
+--------------------------------------------------------------------------------------------------*/
+bool openLogFile(struct log_file *file, const char *path)
+{
+    struct stat info;
+
+    memset(file, 0, sizeof(struct log_file));
+
+    if ((file->fd = open(path, O_RDONLY)) == -1)
+    {
+        return false;
+    }
+
+    if (fstat(file->fd, &info) == -1 || (size_t)info.st_size < sizeof(struct log_file_header))
+    {
+        close(file->fd);
+        return false;
+    }
+    file->size = info.st_size;
+
+    if ((file->map = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, file->fd, 0)) == MAP_FAILED)
+    {
+        close(file->fd);
+        return false;
+    }
+    madvise(file->map, file->size, MADV_SEQUENTIAL);
+
+    file->header = file->map;
+    if (memcmp(file->header->magic, LOG_FILE_MAGIC, sizeof(file->header->magic))
+        || file->header->version != LOG_FILE_VERSION
+        || file->header->recordSize != sizeof(struct log_record))
+    {
+        closeLogFile(file);
+        return false;
+    }
+
+    file->records = (const struct log_record *)(file->header + 1);
+    file->count = (file->size - sizeof(struct log_file_header)) / sizeof(struct log_record);
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                closeLogFile
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void closeLogFile(struct log_file *file)
+--                              struct log_file *file: The reader to close.
+--
+-- NOTES:
+-- Unmaps and closes the binary log.
+--------------------------------------------------------------------------------------------------*/
+void closeLogFile(struct log_file *file)
+{
+    munmap(file->map, file->size);
+    close(file->fd);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                formatRecord
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int formatRecord(char *line, const size_t size, const struct log_record *record)
+--                              char *line: The buffer for the line.
+--                              const size_t size: The size of line.
+--                              const struct log_record *record: The record to format.
+--
+-- RETURNS:                 The length of the line.
+--
+-- NOTES:
+-- Formats a record as a line of the CSV log. The line formats are socket,timestamp(ms),new and
+-- socket,timestamp(ms),rcv|snd,amount(B).
+--------------------------------------------------------------------------------------------------*/
+int formatRecord(char *line, const size_t size, const struct log_record *record)
+{
+    size_t ms;
+    size_t us;
+    struct timeval timestamp;
+
+    timestamp.tv_sec = record->ns / 1000000000;
+    timestamp.tv_usec = (record->ns % 1000000000) / 1000;
+    formatTime(&ms, &us, &timestamp);
+
+    switch (record->event)
+    {
+    case LOG_EVENT_NEW:
+        return snprintf(line, size, "%d,%lu.%03lu,new\n", record->sock, ms, us);
+    case LOG_EVENT_RCV:
+        return snprintf(line, size, "%d,%lu.%03lu,rcv,%d\n", record->sock, ms, us, record->amount);
+    case LOG_EVENT_SND:
+        return snprintf(line, size, "%d,%lu.%03lu,snd,%d\n", record->sock, ms, us, record->amount);
+    }
+
+    return 0;
+}
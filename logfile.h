@@ -0,0 +1,50 @@
+#ifndef LOGFILE_H
+#define LOGFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_FORMAT_CSV 0
+#define LOG_FORMAT_BINARY 1
+
+#define LOG_EVENT_NEW 0
+#define LOG_EVENT_RCV 1
+#define LOG_EVENT_SND 2
+
+#define LOG_FILE_MAGIC "SVRLOG\0"
+#define LOG_FILE_VERSION 1
+
+struct log_record
+{
+    uint64_t ns;
+    int32_t sock;
+    int32_t amount;
+    int32_t event;
+    int32_t pad;
+};
+
+struct log_file_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t startNs;
+};
+
+struct log_file
+{
+    int fd;
+    size_t size;
+    void *map;
+    const struct log_file_header *header;
+    const struct log_record *records;
+    size_t count;
+};
+
+void initLogFileHeader(struct log_file_header *header, const uint64_t startNs);
+bool openLogFile(struct log_file *file, const char *path);
+void closeLogFile(struct log_file *file);
+int formatRecord(char *line, const size_t size, const struct log_record *record);
+
+#endif // LOGFILE_H
@@ -6,7 +6,6 @@
 -- FUNCTIONS:
 --                         parseArguments(int argc, char *argv[])
 --                         printHelp(const char *name)
---                         signalHandler(int sig)
 --
 -- DATE:                   Feb 19, 2019
 --
@@ -18,14 +17,18 @@
 --
 -- NOTES:
 -- The main entry point the program. Parses the command line arguments and then if all
--- the argements are okay, starts the server in either epoll or select mode.
+-- the argements are okay, starts the server in either epoll, select, poll or io_uring mode, or in
+-- epoll mode with a fiber per connection.
 -- 
 -- For usage see the printHelp() function or README.md file.
 ---------------------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+
 #include "main.h"
 
 #include <getopt.h>
 #include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -33,17 +36,24 @@
 #include <pthread.h>
 #include <unistd.h>
 
+#include "affinity.h"
+#include "bufpool.h"
+#include "config.h"
+#include "connection.h"
+#include "control.h"
+#include "fiber.h"
+#include "handler.h"
+#include "http.h"
+#include "metrics.h"
 #include "net.h"
+#include "stats.h"
 #include "tools.h"
 #include "select_svr.h"
+#include "poll_svr.h"
 #include "epoll_svr.h"
+#include "uring_svr.h"
 
-#define SELECT_MODE 1
-#define EPOLL_MODE 2
-
-short port;
-int mode;
-int bufferLength;
+struct server_config config;
 
 /*---------------------------------------------------------------------------------------
 -- FUNCTION:                main
@@ -67,33 +77,86 @@ int bufferLength;
 ---------------------------------------------------------------------------------------*/
 int main(int argc, char *argv[])
 {
-    int listenSocket;
+    int listenSocket = -1;
 
     // grab arguements
     parseArguments(argc, argv);
 
+    // block the signals before any other thread exists and take over the listeners of an old server
+    if (!startControl(&config))
+    {
+        systemFatal("startControl");
+    }
+
+    // start the metrics before any other thread so that they all inherit its signal mask
+    if (!startMetrics())
+    {
+        systemFatal("startMetrics");
+    }
+
+    // buffers for the output connections could not send yet
+    startBufferPool(config.memoryBudget, config.hugePages);
+
+    // the stacks of every fiber the workers may run
+    if (config.fibers && !startFiberPool(config.fiberLimit, config.workers, config.fiberStack, config.bufferLength))
+    {
+        systemFatal("startFiberPool");
+    }
+
+    // the state of every connection, indexed by fd
+    if (!startConnectionTable())
+    {
+        systemFatal("startConnectionTable");
+    }
+
+    // publish the live counters
+    if (!startStats(config.mode, config.port))
+    {
+        systemFatal("startStats");
+    }
+
     // open logging file
-    if (!startLogging())
+    if (!startLogging(config.logPolicy, config.logFormat))
     {
         systemFatal("startLogging");
     }
 
-    // create listening socket
-    if (!createBoundSocket(&listenSocket, port))
+    // create listening socket, with reuse port each epoll worker makes its own instead
+    if (!config.reusePort)
     {
-        systemFatal("createBoundSocket");
-    }
+        if ((listenSocket = inheritedListener(0)) == -1)
+        {
+            if (!createBoundSocket(&listenSocket, config.port, false))
+            {
+                systemFatal("createBoundSocket");
+            }
 
-    listen(listenSocket, 5);
+            if (listen(listenSocket, config.backlog) == -1)
+            {
+                systemFatal("listen");
+            }
+        }
+
+        if (!registerListener(listenSocket))
+        {
+            systemFatal("registerListener");
+        }
+    }
 
     // pick mode
-    switch (mode)
+    switch (config.mode)
     {
     case SELECT_MODE:
-        runSelect(listenSocket, bufferLength);
+        runSelect(listenSocket, &config);
+        break;
+    case POLL_MODE:
+        runPoll(listenSocket, &config);
         break;
     case EPOLL_MODE:
-        runEpoll(listenSocket, bufferLength);
+        runEpoll(listenSocket, &config);
+        break;
+    case URING_MODE:
+        runUring(listenSocket, &config);
         break;
     default:
         printHelp(argv[0]);
@@ -101,11 +164,29 @@ int main(int argc, char *argv[])
     }
 
     // close the listen socket
-    close(listenSocket);
+    if (listenSocket != -1)
+    {
+        close(listenSocket);
+    }
 
     // close logging file
     stopLogging();
 
+    // remove the live counters
+    stopStats();
+
+    // remove the upgrade socket
+    stopControl();
+
+    stopConnectionTable();
+
+    stopFiberPool();
+
+    // write the final metrics
+    stopMetrics();
+
+    free(config.workerCpus);
+
     return 0;
 }
 
@@ -130,23 +211,62 @@ int main(int argc, char *argv[])
 void parseArguments(int argc, char *argv[])
 {
     int c;
+    int cpuCount;
+    long megabytes;
+    char *end;
+    const char *cpuList = NULL;
 
-    mode = 0;
-    port = 0;
-    bufferLength = 0;
+    config.mode = 0;
+    config.port = 0;
+    config.workers = 0;
+    config.workerCpus = NULL;
+    config.bufferLength = 0;
+    config.backlog = SOMAXCONN;
+    config.acceptCap = 0;
+    config.readTimeout = -1;
+    config.idleTimeout = -1;
+    config.writeTimeout = -1;
+    config.drainTimeout = -1;
+    config.upgradePath = NULL;
+    config.handler = &echoHandler;
+    config.httpBody = NULL;
+    config.fibers = false;
+    config.fiberStack = 0;
+    config.fiberLimit = 0;
+    config.reusePort = false;
+    config.steerToCpu = false;
+    config.splice = false;
+    config.zeroCopyThreshold = 0;
+    config.memoryBudget = 0;
+    config.hugePages = false;
+    config.logPolicy = LOG_BLOCK;
+    config.logFormat = LOG_FORMAT_CSV;
 
-    while ((c = getopt(argc, argv, "m:p:b:")) != -1)
+    while ((c = getopt(argc, argv, "m:p:w:C:b:B:A:R:I:W:D:U:P:E:S:F:rcsz:M:HL:l:")) != -1)
     {
         switch (c)
         {
         case 'm':
             if (!strcmp(optarg, "select"))
             {
-                mode = SELECT_MODE;
+                config.mode = SELECT_MODE;
+            }
+            else if (!strcmp(optarg, "poll"))
+            {
+                config.mode = POLL_MODE;
             }
             else if (!strcmp(optarg, "epoll"))
             {
-                mode = EPOLL_MODE;
+                config.mode = EPOLL_MODE;
+            }
+            else if (!strcmp(optarg, "uring"))
+            {
+                config.mode = URING_MODE;
+            }
+            else if (!strcmp(optarg, "fiber"))
+            {
+                config.mode = EPOLL_MODE;
+                config.fibers = true;
             }
             else
             {
@@ -155,15 +275,157 @@ void parseArguments(int argc, char *argv[])
             }
             break;
         case 'p':
-            port = atoi(optarg);
-            if (port < 1024)
+            config.port = atoi(optarg);
+            if (config.port < 1024)
             {
                 fprintf(stderr, "Port must be higher than 1024\n");
                 exit(EXIT_FAILURE);
             }
             break;
+        case 'w':
+            if ((config.workers = atoi(optarg)) < 1)
+            {
+                fprintf(stderr, "There must be at least 1 worker\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'C':
+            cpuList = optarg;
+            break;
         case 'b':
-            bufferLength = atoi(optarg);
+            config.bufferLength = atoi(optarg);
+            break;
+        case 'B':
+            if ((config.backlog = atoi(optarg)) < 1)
+            {
+                fprintf(stderr, "The backlog must be at least 1\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'A':
+            if ((config.acceptCap = atoi(optarg)) < 1)
+            {
+                fprintf(stderr, "The accept cap must be at least 1\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'R':
+            if ((config.readTimeout = atoi(optarg)) < 0)
+            {
+                fprintf(stderr, "The read timeout cannot be negative\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'I':
+            if ((config.idleTimeout = atoi(optarg)) < 0)
+            {
+                fprintf(stderr, "The idle timeout cannot be negative\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'W':
+            if ((config.writeTimeout = atoi(optarg)) < 0)
+            {
+                fprintf(stderr, "The write timeout cannot be negative\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'D':
+            if ((config.drainTimeout = atoi(optarg)) < 0)
+            {
+                fprintf(stderr, "The drain timeout cannot be negative\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'U':
+            config.upgradePath = optarg;
+            break;
+        case 'P':
+            if ((config.handler = findHandler(optarg)) == NULL)
+            {
+                fprintf(stderr, "Unknown handler %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'E':
+            config.httpBody = optarg;
+            break;
+        case 'S':
+            if ((config.fiberStack = atoi(optarg) * 1024) < FIBER_STACK_MIN)
+            {
+                fprintf(stderr, "The fiber stack must be at least %dKB\n", FIBER_STACK_MIN / 1024);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'F':
+            if ((config.fiberLimit = atoi(optarg)) < 1)
+            {
+                fprintf(stderr, "There must be at least 1 fiber\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'r':
+            config.reusePort = true;
+            break;
+        case 'c':
+            config.reusePort = true;
+            config.steerToCpu = true;
+            break;
+        case 's':
+            config.splice = true;
+            break;
+        case 'z':
+            if ((config.zeroCopyThreshold = atoi(optarg)) < 1)
+            {
+                fprintf(stderr, "The zero copy threshold must be at least 1 byte\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'M':
+            megabytes = strtol(optarg, &end, 10);
+            if (*end != '\0' || megabytes < 1 || (unsigned long)megabytes > SIZE_MAX / (1024 * 1024))
+            {
+                fprintf(stderr, "The memory budget must be a number of MB from 1 to %zu\n", SIZE_MAX / (1024 * 1024));
+                exit(EXIT_FAILURE);
+            }
+            config.memoryBudget = (size_t)megabytes * 1024 * 1024;
+            break;
+        case 'H':
+            config.hugePages = true;
+            break;
+        case 'L':
+            if (!strcmp(optarg, "block"))
+            {
+                config.logPolicy = LOG_BLOCK;
+            }
+            else if (!strcmp(optarg, "drop"))
+            {
+                config.logPolicy = LOG_DROP;
+            }
+            else if (!strcmp(optarg, "overwrite"))
+            {
+                config.logPolicy = LOG_OVERWRITE;
+            }
+            else
+            {
+                printHelp(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'l':
+            if (!strcmp(optarg, "csv"))
+            {
+                config.logFormat = LOG_FORMAT_CSV;
+            }
+            else if (!strcmp(optarg, "binary"))
+            {
+                config.logFormat = LOG_FORMAT_BINARY;
+            }
+            else
+            {
+                printHelp(argv[0]);
+                exit(EXIT_FAILURE);
+            }
             break;
         default:
             printHelp(argv[0]);
@@ -172,11 +434,126 @@ void parseArguments(int argc, char *argv[])
     }
 
     // check that all options have been given
-    if (!mode || !port || !bufferLength)
+    if (!config.mode || !config.port || !config.bufferLength)
     {
         printHelp(argv[0]);
         exit(EXIT_FAILURE);
     }
+
+    // per worker listeners only exist in epoll mode
+    if (config.reusePort && config.mode != EPOLL_MODE)
+    {
+        fprintf(stderr, "-r and -c are only supported in epoll mode\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // splice and zero copy are only wired into the epoll echo
+    if ((config.splice || config.zeroCopyThreshold) && config.mode != EPOLL_MODE)
+    {
+        fprintf(stderr, "-s and -z are only supported in epoll mode\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // both echo in the kernel without ever calling the handler
+    if ((config.splice || config.zeroCopyThreshold) && config.handler != &echoHandler)
+    {
+        fprintf(stderr, "-s and -z are only supported with the echo handler\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // and without ever resuming the fiber of the connection
+    if ((config.splice || config.zeroCopyThreshold) && config.fibers)
+    {
+        fprintf(stderr, "-s and -z are not supported in fiber mode\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // a handler that only reads for itself needs a fiber to block on
+    if (config.handler->onData == NULL && config.handler->onFiber != NULL && !config.fibers)
+    {
+        fprintf(stderr, "The %s handler is only supported in fiber mode\n", config.handler->name);
+        exit(EXIT_FAILURE);
+    }
+
+    if ((config.fiberStack || config.fiberLimit) && !config.fibers)
+    {
+        fprintf(stderr, "-S and -F are only supported in fiber mode\n");
+        exit(EXIT_FAILURE);
+    }
+    if (!config.fiberStack)
+    {
+        config.fiberStack = FIBER_STACK_DEFAULT;
+    }
+    if (!config.fiberLimit)
+    {
+        config.fiberLimit = FIBER_LIMIT_DEFAULT;
+    }
+
+    if (config.httpBody != NULL && config.handler != &httpHandler)
+    {
+        fprintf(stderr, "-E is only supported with the http handler\n");
+        exit(EXIT_FAILURE);
+    }
+    if (config.handler == &httpHandler && !httpInit(config.httpBody))
+    {
+        perror(config.httpBody != NULL ? config.httpBody : "httpInit");
+        exit(EXIT_FAILURE);
+    }
+
+    // the other modes accept on a thread of their own or with io_uring
+    if (config.acceptCap && config.mode != EPOLL_MODE)
+    {
+        fprintf(stderr, "-A is only supported in epoll mode\n");
+        exit(EXIT_FAILURE);
+    }
+    if (!config.acceptCap)
+    {
+        config.acceptCap = ACCEPT_CAP_DEFAULT;
+    }
+
+    // only epoll keeps a timing wheel
+    if ((config.readTimeout != -1 || config.idleTimeout != -1 || config.writeTimeout != -1)
+        && config.mode != EPOLL_MODE)
+    {
+        fprintf(stderr, "-R, -I and -W are only supported in epoll mode\n");
+        exit(EXIT_FAILURE);
+    }
+    if (config.readTimeout == -1)
+    {
+        config.readTimeout = TIMEOUT_READ_DEFAULT;
+    }
+    if (config.idleTimeout == -1)
+    {
+        config.idleTimeout = TIMEOUT_IDLE_DEFAULT;
+    }
+    if (config.writeTimeout == -1)
+    {
+        config.writeTimeout = TIMEOUT_WRITE_DEFAULT;
+    }
+
+    // select and poll echo before they look at the next socket, so they drain in one pass
+    if (config.drainTimeout != -1 && config.mode != EPOLL_MODE && config.mode != URING_MODE)
+    {
+        fprintf(stderr, "-D is only supported in epoll and uring mode\n");
+        exit(EXIT_FAILURE);
+    }
+    if (config.drainTimeout == -1)
+    {
+        config.drainTimeout = DRAIN_TIMEOUT_DEFAULT;
+    }
+
+    if ((config.workerCpus = assignWorkerCpus(cpuList, &config.workers, &cpuCount)) == NULL)
+    {
+        perror(cpuList != NULL ? "Invalid cpu list" : "assignWorkerCpus");
+        exit(EXIT_FAILURE);
+    }
+
+    // steering sends each connection to the worker of the cpu that received it, so no two may share one
+    if (config.steerToCpu && config.workers > cpuCount)
+    {
+        fprintf(stderr, "-c needs a cpu per worker, %d workers on %d cpus\n", config.workers, cpuCount);
+        exit(EXIT_FAILURE);
+    }
 }
 
 /*--------------------------------------------------------------------------------------------------
@@ -198,8 +575,31 @@ void parseArguments(int argc, char *argv[])
 --------------------------------------------------------------------------------------------------*/
 void printHelp(const char *name)
 {
-    fprintf(stderr, "Usage: %s -m [select|epoll] -p [port] -b [buffer size]\n", name);
-    fprintf(stderr, "    -m - The operatin mode. Either 'select' or 'epoll.'\n");
+    fprintf(stderr, "Usage: %s -m [select|poll|epoll|uring|fiber] -p [port] [-w workers] [-C cpus] -b [buffer size] [-B backlog] [-A accepts] [-R seconds] [-I seconds] [-W seconds] [-D seconds] [-U path] [-P handler] [-E path] [-S kilobytes] [-F fibers] [-r] [-c] [-s] [-z bytes] [-M megabytes] [-H] [-L policy] [-l format]\n", name);
+    fprintf(stderr, "    -m - The operatin mode. Either 'select', 'poll', 'epoll', 'uring' or 'fiber'. Fiber is epoll running\n"
+                    "         every connection on a fiber of its own, and takes the epoll options but -s and -z.\n");
     fprintf(stderr, "    -p - The port to listen on. Must be greater than 1024.\n");
+    fprintf(stderr, "    -w - The number of workers. Default one per cpu.\n");
+    fprintf(stderr, "    -C - The cpus to pin the workers to in order, like 0-3,8. Default the cpus the server may run on.\n");
     fprintf(stderr, "    -b - The buffer size. Recommendation is less than 1000.\n");
+    fprintf(stderr, "    -B - The listen backlog. Default SOMAXCONN, the kernel caps it at net.core.somaxconn.\n");
+    fprintf(stderr, "    -A - Epoll only. The most connections a worker accepts in a row. Default %d.\n", ACCEPT_CAP_DEFAULT);
+    fprintf(stderr, "    -R - Epoll only. Seconds a new connection may take to send its first data, 0 for never. Default %d.\n", TIMEOUT_READ_DEFAULT);
+    fprintf(stderr, "    -I - Epoll only. Seconds a connection may go without sending, 0 for never. Default %d.\n", TIMEOUT_IDLE_DEFAULT);
+    fprintf(stderr, "    -W - Epoll only. Seconds a connection may leave its echo unread, 0 for never. Default %d.\n", TIMEOUT_WRITE_DEFAULT);
+    fprintf(stderr, "    -D - Epoll and uring only. Seconds a draining worker lets its connections finish. Default %d.\n", DRAIN_TIMEOUT_DEFAULT);
+    fprintf(stderr, "    -U - Hand the listeners to a new server started with the same path, and take them from one running there.\n");
+    fprintf(stderr, "    -P - The protocol spoken on every connection. 'echo' (default), 'frame', 'http'\n"
+                    "         or 'grant', which is fiber only.\n");
+    fprintf(stderr, "    -E - Http only. The file every request is answered with. Default a short text.\n");
+    fprintf(stderr, "    -S - Fiber only. The stack of every fiber in KB. Default %d.\n", FIBER_STACK_DEFAULT / 1024);
+    fprintf(stderr, "    -F - Fiber only. The most fibers, and so connections, all workers have at once. Default %d.\n", FIBER_LIMIT_DEFAULT);
+    fprintf(stderr, "    -r - Epoll only. Give each worker its own SO_REUSEPORT listener.\n");
+    fprintf(stderr, "    -c - Epoll only. Like -r, but steer each connection to the worker on the CPU that received it.\n");
+    fprintf(stderr, "    -s - Epoll only. Echo with splice through a pipe so the data is never copied to the server.\n");
+    fprintf(stderr, "    -z - Epoll only. Send reads of at least this many bytes with MSG_ZEROCOPY.\n");
+    fprintf(stderr, "    -M - The most memory in MB connections may hold for data they could not send yet.\n");
+    fprintf(stderr, "    -H - Back the buffers of that data with huge pages.\n");
+    fprintf(stderr, "    -L - What a worker does when its log ring is full. 'block' (default), 'drop' or 'overwrite'.\n");
+    fprintf(stderr, "    -l - The log format. 'csv' (default) writes server.log, 'binary' writes server.bin.\n");
 }
@@ -3,6 +3,5 @@
 
 void parseArguments(int argc, char *argv[]);
 void printHelp(const char *name);
-void signalHandler(int sig);
 
 #endif // MAIN_H
\ No newline at end of file
@@ -0,0 +1,361 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            metrics.c
+--
+-- PROGRAM:                server.out
+--
+-- FUNCTIONS:
+--                         bool startMetrics()
+--                         void stopMetrics()
+--                         uint64_t metricsNow()
+--                         void metricsRecord(const int metric, const uint64_t ns)
+--                         struct worker_metrics *createLocalMetrics()
+--                         void *metricsDumper(void *arg)
+--                         void dumpMetrics(const char *reason)
+--                         void printHistogramJson(FILE *out, const char *name, const struct histogram *histogram)
+--
+-- DATE:                   Oct 17, 2026
+--
+-- REVISIONS:              Oct 17, 2026 - Time the protocol handler.
+--                         Oct 18, 2026 - Never cancel the dumper in the middle of a dump.
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- Latency histograms kept by the server itself.
+--
+-- Every worker times how long it takes to accept and register a connection, how long it takes from
+-- receiving data to having echoed it, how long it spends handling one batch of ready events and how
+-- long the protocol handler takes with each read. Like the log rings, each thread gets its own
+-- histograms the first time it records and records into them without locks. The histograms of all workers are merged when they are dumped, which happens on
+-- SIGUSR1 and once more when the server stops.
+--
+-- Every dump appends one line of JSON to server-metrics.json holding the merged histograms and those
+-- of each worker. All times are in nanoseconds.
+---------------------------------------------------------------------------------------*/
+#include "metrics.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+
+#include "tools.h"
+
+static const char *metricNames[METRIC_COUNT] = { "accept", "service", "loop", "handler" };
+
+static FILE *metricsFile = NULL;
+static struct worker_metrics *workerMetrics = NULL;
+static __thread struct worker_metrics *localMetrics = NULL;
+static pthread_t dumper;
+static pthread_mutex_t dumpLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                startMetrics
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool startMetrics()
+--
+-- RETURNS:                 True if the metrics file was opened and the dumper started, false otherwise.
+--
+-- NOTES:
+-- Opens the metrics file and starts the thread that dumps the metrics on SIGUSR1. SIGUSR1 is blocked
+-- here, before any other thread exists, so that every thread inherits the mask and the signal is only
+-- ever taken by the dumper.
+--------------------------------------------------------------------------------------------------*/
+bool startMetrics()
+{
+    sigset_t set;
+
+    if ((metricsFile = fopen(METRICS_FILE, "w")) == NULL)
+    {
+        return false;
+    }
+
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    if (pthread_sigmask(SIG_BLOCK, &set, NULL))
+    {
+        fclose(metricsFile);
+        return false;
+    }
+
+    if (pthread_create(&dumper, NULL, metricsDumper, NULL))
+    {
+        fclose(metricsFile);
+        return false;
+    }
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                stopMetrics
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void stopMetrics()
+--
+-- NOTES:
+-- Stops the dumper, writes the final dump and frees the histograms of every worker. Must be called
+-- once the workers have stopped.
+--------------------------------------------------------------------------------------------------*/
+void stopMetrics()
+{
+    pthread_cancel(dumper);
+    pthread_join(dumper, NULL);
+
+    dumpMetrics("shutdown");
+
+    while (workerMetrics != NULL)
+    {
+        struct worker_metrics *metrics = workerMetrics;
+        workerMetrics = metrics->next;
+        free(metrics);
+    }
+
+    fclose(metricsFile);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                metricsNow
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               uint64_t metricsNow()
+--
+-- RETURNS:                 The monotonic time in nanoseconds.
+--------------------------------------------------------------------------------------------------*/
+uint64_t metricsNow()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                metricsRecord
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void metricsRecord(const int metric, const uint64_t ns)
+--                              const int metric: One of the METRIC values.
+--                              const uint64_t ns: The time taken in nanoseconds.
+--
+-- NOTES:
+-- Records a time into the histogram of the calling thread.
+--------------------------------------------------------------------------------------------------*/
+void metricsRecord(const int metric, const uint64_t ns)
+{
+    struct worker_metrics *metrics = localMetrics != NULL ? localMetrics : createLocalMetrics();
+
+    histogramRecord(&metrics->histograms[metric], ns);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                createLocalMetrics
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               struct worker_metrics *createLocalMetrics()
+--
+-- RETURNS:                 The histograms of the calling thread.
+--
+-- NOTES:
+-- Allocates the histograms of the calling thread and publishes them for dumping. Only runs the first
+-- time a thread records.
+--------------------------------------------------------------------------------------------------*/
+struct worker_metrics *createLocalMetrics()
+{
+    struct worker_metrics *metrics;
+
+    if ((metrics = aligned_alloc(64, sizeof(struct worker_metrics))) == NULL)
+    {
+        systemFatal("aligned_alloc");
+    }
+
+    for (int i = 0; i < METRIC_COUNT; i++)
+    {
+        histogramReset(&metrics->histograms[i]);
+    }
+
+    metrics->next = __atomic_load_n(&workerMetrics, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&workerMetrics, &metrics->next, metrics, true, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED));
+
+    localMetrics = metrics;
+    return metrics;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                metricsDumper
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Only let it be cancelled while it waits.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void *metricsDumper(void *arg)
+--                              void *arg: Unused.
+--
+-- RETURNS:                 NULL - unused.
+--
+-- NOTES:
+-- The main function of the dumper thread. Waits for SIGUSR1 and dumps the metrics every time it
+-- arrives, until it is cancelled. Cancellation is disabled while it dumps, the writes to the file
+-- are cancellation points and a dumper cancelled in one would leave dumpLock held for the final dump.
+--------------------------------------------------------------------------------------------------*/
+void *metricsDumper(void *arg)
+{
+    sigset_t set;
+    int sig;
+
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+
+    while (true)
+    {
+        if (sigwait(&set, &sig) == 0)
+        {
+            pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+            dumpMetrics("signal");
+            pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                dumpMetrics
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void dumpMetrics(const char *reason)
+--                              const char *reason: Why the dump was taken, written into the dump.
+--
+-- NOTES:
+-- Merges the histograms of every worker and appends them, followed by those of each worker, to the
+-- metrics file as one line of JSON. The workers keep recording while this runs, so a dump taken while
+-- the server is busy can be off by the few values recorded while it was being read.
+--------------------------------------------------------------------------------------------------*/
+void dumpMetrics(const char *reason)
+{
+    struct histogram *total;
+    struct worker_metrics *first = __atomic_load_n(&workerMetrics, __ATOMIC_ACQUIRE);
+    struct timespec now;
+
+    if ((total = malloc(METRIC_COUNT * sizeof(struct histogram))) == NULL)
+    {
+        perror("malloc");
+        return;
+    }
+
+    for (int i = 0; i < METRIC_COUNT; i++)
+    {
+        histogramReset(&total[i]);
+        for (struct worker_metrics *metrics = first; metrics != NULL; metrics = metrics->next)
+        {
+            histogramMerge(&total[i], &metrics->histograms[i]);
+        }
+    }
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    pthread_mutex_lock(&dumpLock);
+
+    fprintf(metricsFile, "{\"reason\":\"%s\",\"time\":%ld.%06ld,\"total\":{", reason, now.tv_sec,
+            now.tv_nsec / 1000);
+    for (int i = 0; i < METRIC_COUNT; i++)
+    {
+        printHistogramJson(metricsFile, metricNames[i], &total[i]);
+        fprintf(metricsFile, i < METRIC_COUNT - 1 ? "," : "},\"workers\":[");
+    }
+    for (struct worker_metrics *metrics = first; metrics != NULL; metrics = metrics->next)
+    {
+        fprintf(metricsFile, "{");
+        for (int i = 0; i < METRIC_COUNT; i++)
+        {
+            printHistogramJson(metricsFile, metricNames[i], &metrics->histograms[i]);
+            fprintf(metricsFile, i < METRIC_COUNT - 1 ? "," : "}");
+        }
+        fprintf(metricsFile, metrics->next != NULL ? "," : "");
+    }
+    fprintf(metricsFile, "]}\n");
+    fflush(metricsFile);
+
+    pthread_mutex_unlock(&dumpLock);
+
+    free(total);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                printHistogramJson
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void printHistogramJson(FILE *out, const char *name, const struct histogram *histogram)
+--                              FILE *out: Where to write.
+--                              const char *name: The key of the histogram.
+--                              const struct histogram *histogram: The histogram.
+--
+-- NOTES:
+-- Writes "name":{...} with the count, min, mean, max and the usual percentiles of the histogram.
+--------------------------------------------------------------------------------------------------*/
+void printHistogramJson(FILE *out, const char *name, const struct histogram *histogram)
+{
+    fprintf(out, "\"%s\":{\"count\":%lu,\"min\":%lu,\"mean\":%lu,\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,"
+                 "\"p99.9\":%lu,\"max\":%lu}",
+            name, histogram->count, histogram->count ? histogram->min : 0,
+            histogram->count ? histogram->total / histogram->count : 0, histogramPercentile(histogram, 50),
+            histogramPercentile(histogram, 90), histogramPercentile(histogram, 99),
+            histogramPercentile(histogram, 99.9), histogram->max);
+}
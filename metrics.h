@@ -0,0 +1,38 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "histogram.h"
+
+// what the server times, each worker keeps one histogram per metric
+#define METRIC_ACCEPT 0
+#define METRIC_SERVICE 1
+#define METRIC_LOOP 2
+#define METRIC_HANDLER 3
+#define METRIC_COUNT 4
+
+#define METRICS_FILE "server-metrics.json"
+
+struct worker_metrics
+{
+    // written by the owning worker only
+    _Alignas(64) struct histogram histograms[METRIC_COUNT];
+
+    struct worker_metrics *next;
+};
+
+bool startMetrics();
+void stopMetrics();
+
+uint64_t metricsNow();
+void metricsRecord(const int metric, const uint64_t ns);
+
+struct worker_metrics *createLocalMetrics();
+void *metricsDumper(void *arg);
+void dumpMetrics(const char *reason);
+void printHistogramJson(FILE *out, const char *name, const struct histogram *histogram);
+
+#endif // METRICS_H
@@ -0,0 +1,1210 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            microbench.c
+--
+-- PROGRAM:                microbench.out
+--
+-- FUNCTIONS:
+--                         int main(int argc, char *argv[])
+--                         void parseArguments(int argc, char *argv[])
+--                         void printHelp(const char *name)
+--                         void runCase(const struct microbench_case *bench, const int threads)
+--                         void *microbenchWorker(void *args)
+--                         bool caseSelected(const char *name)
+--                         int openCycleCounter(const bool kernel)
+--                         uint64_t readCycles(const int fd)
+--                         uint64_t nowNs()
+--                         int batchMessages()
+--                         bool setupPair(struct microbench_thread *thread)
+--                         bool setupListener(struct microbench_thread *thread)
+--                         bool setupNothing(struct microbench_thread *thread)
+--                         uint64_t benchReadAll(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+--                         uint64_t benchSend(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+--                         uint64_t benchSendVector(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+--                         uint64_t benchClear(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+--                         uint64_t benchAccept(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+--                         uint64_t benchLogRcv(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+--                         uint64_t benchLogSnd(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+--                         uint64_t benchFormatTime(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+--                         void fillPeer(struct microbench_thread *thread, const int count)
+--                         void drainPeer(struct microbench_thread *thread, const int count)
+--
+-- DATE:                   Oct 18, 2026
+--
+-- REVISIONS:              Oct 18, 2026 - No Nagle on the loopback tcp pairs.
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- Measures what a single call of each primitive of net.c and tools.c the server is built on costs,
+-- so a server that got slower can be narrowed down to its syscalls, its logging or its stats.
+--
+-- Every benchmark runs on 1 or more threads at once, each with a socket of its own over loopback TCP
+-- or with -u a unix socketpair, so running the same benchmark with more threads shows what the
+-- threads contend on, like the log rings and the stats of tools.c and stats.c. A sample is a number
+-- of calls on every thread, started together behind a barrier. The socket benchmarks work in
+-- batches that fit in the socket buffers: the peer fills or drains the socket between the batches,
+-- and only the batches themselves are timed. Each benchmark prints the mean ns per call over the
+-- samples, their standard deviation and the best sample, the cpu cycles per call where perf counters
+-- can be opened, and the calls per second of all threads together.
+--
+-- Logging runs just like in the server, with its flusher writing to a file that is deleted as soon
+-- as it is opened. The stats are kept in the segment of port 0, so svrstat -p 0 can watch a run.
+--
+-- For usage see the printHelp() function or README.md file.
+---------------------------------------------------------------------------------------*/
+#include "microbench.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <linux/perf_event.h>
+#include <math.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "net.h"
+#include "stats.h"
+#include "tools.h"
+
+struct microbench_config config;
+
+static const struct microbench_case cases[] = {
+    { "readAll", 1, setupPair, benchReadAll },
+    { "send", 1, setupPair, benchSend },
+    { "sendVector", 1, setupPair, benchSendVector },
+    { "clear", 1, setupPair, benchClear },
+    { "accept", 20, setupListener, benchAccept },
+    { "logRcv", 1, setupNothing, benchLogRcv },
+    { "logSnd", 1, setupNothing, benchLogSnd },
+    { "formatTime", 1, setupNothing, benchFormatTime },
+};
+
+static pthread_barrier_t barrier;
+static bool cyclesCounted = false;
+static bool cyclesKernel = false;
+// keeps the results of formatTime from being thrown away
+static volatile size_t sink;
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                main
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int main(int argc, char *argv[])
+--                              int argc: The number of command line arguments.
+--                              char *argv[]: The command line arguments.
+--
+-- RETURNS:                 EXIT_SUCCESS once every benchmark ran.
+--
+-- NOTES:
+-- Starts logging and stats the way the server does, then runs every selected benchmark once for
+-- every thread count.
+--------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+    char logDir[] = "/tmp/microbench-XXXXXX";
+    int fd;
+
+    parseArguments(argc, argv);
+
+    // the log goes to a directory of its own so no log of a server is overwritten
+    if (mkdtemp(logDir) == NULL || chdir(logDir) == -1)
+    {
+        systemFatal("mkdtemp");
+    }
+    if (!startLogging(config.logPolicy, config.logFormat))
+    {
+        systemFatal("startLogging");
+    }
+    unlink(config.logFormat == LOG_FORMAT_BINARY ? "server.bin" : "server.log");
+    rmdir(logDir);
+
+    if (!startStats(0, 0))
+    {
+        fprintf(stderr, "Could not create the stats segment, all threads share one set of counters\n");
+    }
+
+    if ((fd = openCycleCounter(true)) != -1)
+    {
+        cyclesCounted = true;
+        cyclesKernel = true;
+    }
+    else if ((fd = openCycleCounter(false)) != -1)
+    {
+        cyclesCounted = true;
+    }
+    if (fd != -1)
+    {
+        close(fd);
+    }
+
+    printf("%d byte messages over %s, %d samples, cycles %s\n", config.size,
+           config.unixSockets ? "a unix socketpair" : "loopback tcp", config.samples,
+           !cyclesCounted ? "not available" : cyclesKernel ? "in user and kernel space" : "in user space only");
+    printf("%-12s %7s %12s %10s %12s %12s %12s\n", "benchmark", "threads", "ns/op", "stddev", "best ns/op",
+           "cycles/op", "Mops/s");
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        if (!caseSelected(cases[i].name))
+        {
+            continue;
+        }
+        for (int j = 0; j < config.runs; j++)
+        {
+            runCase(&cases[i], config.threads[j]);
+        }
+    }
+
+    stopLogging();
+    stopStats();
+
+    return EXIT_SUCCESS;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                parseArguments
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void parseArguments(int argc, char *argv[])
+--                              int argc: Argc from main.
+--                              char *argv[]: Argv from main.
+--
+-- NOTES:
+-- Parses the command line arguments and configures the approriate settings.
+--------------------------------------------------------------------------------------------------*/
+void parseArguments(int argc, char *argv[])
+{
+    int c;
+    char *list;
+
+    config.threads[0] = 1;
+    config.runs = 1;
+    config.iterations = 100000;
+    config.samples = 10;
+    config.size = 100;
+    config.unixSockets = false;
+    config.logPolicy = LOG_BLOCK;
+    config.logFormat = LOG_FORMAT_CSV;
+    config.only = NULL;
+
+    while ((c = getopt(argc, argv, "b:t:n:r:s:uL:l:")) != -1)
+    {
+        switch (c)
+        {
+        case 'b':
+            config.only = optarg;
+            break;
+        case 't':
+            config.runs = 0;
+            for (list = strtok(optarg, ","); list != NULL && config.runs < MICROBENCH_MAX_RUNS;
+                 list = strtok(NULL, ","))
+            {
+                if ((config.threads[config.runs++] = atoi(list)) < 1)
+                {
+                    printHelp(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+            }
+            break;
+        case 'n':
+            config.iterations = atoi(optarg);
+            break;
+        case 'r':
+            config.samples = atoi(optarg);
+            break;
+        case 's':
+            config.size = atoi(optarg);
+            break;
+        case 'u':
+            config.unixSockets = true;
+            break;
+        case 'L':
+            if (!strcmp(optarg, "block"))
+            {
+                config.logPolicy = LOG_BLOCK;
+            }
+            else if (!strcmp(optarg, "drop"))
+            {
+                config.logPolicy = LOG_DROP;
+            }
+            else if (!strcmp(optarg, "overwrite"))
+            {
+                config.logPolicy = LOG_OVERWRITE;
+            }
+            else
+            {
+                printHelp(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'l':
+            if (!strcmp(optarg, "csv"))
+            {
+                config.logFormat = LOG_FORMAT_CSV;
+            }
+            else if (!strcmp(optarg, "binary"))
+            {
+                config.logFormat = LOG_FORMAT_BINARY;
+            }
+            else
+            {
+                printHelp(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        default:
+            printHelp(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (config.runs < 1 || config.iterations < 1 || config.samples < 2 || config.size < 2
+        || config.size > MICROBENCH_BATCH_BYTES)
+    {
+        printHelp(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                printHelp
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void printHelp(const char *name)
+--                              name: The name of the application.
+--
+-- NOTES:
+-- Prints the help menu with instructions on how to run the program.
+--------------------------------------------------------------------------------------------------*/
+void printHelp(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-b benchmarks] [-t threads] [-n calls] [-r samples] [-s size] [-u] [-L policy]"
+                    " [-l format]\n", name);
+    fprintf(stderr, "    -b - The benchmarks to run, like logSnd,readAll. Default all of readAll, send, sendVector,\n"
+                    "         clear, accept, logRcv, logSnd and formatTime.\n");
+    fprintf(stderr, "    -t - The numbers of threads to run every benchmark with, like 1,2,4,8. Default 1.\n");
+    fprintf(stderr, "    -n - The calls each thread makes per sample. Default 100000, accept makes 20 times fewer.\n");
+    fprintf(stderr, "    -r - The number of samples, at least 2. Default 10.\n");
+    fprintf(stderr, "    -s - The message size in bytes, at most %d. Default 100.\n", MICROBENCH_BATCH_BYTES);
+    fprintf(stderr, "    -u - Use a unix socketpair instead of loopback tcp.\n");
+    fprintf(stderr, "    -L - What a thread does when its log ring is full. 'block' (default), 'drop' or 'overwrite'.\n");
+    fprintf(stderr, "    -l - The log format. 'csv' (default) or 'binary'.\n");
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                runCase
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void runCase(const struct microbench_case *bench, const int threads)
+--                              const struct microbench_case *bench: The benchmark to run.
+--                              const int threads: The number of threads to run it on.
+--
+-- NOTES:
+-- Runs the benchmark on every thread and prints one line for it. The ns per call of a sample is the
+-- mean over the threads, and the mean, standard deviation and best are taken over the samples.
+--------------------------------------------------------------------------------------------------*/
+void runCase(const struct microbench_case *bench, const int threads)
+{
+    struct microbench_thread *workers;
+    double mean = 0;
+    double variance = 0;
+    double best = INFINITY;
+    double cycles = 0;
+    char cycleText[16];
+
+    if ((workers = calloc(threads, sizeof(struct microbench_thread))) == NULL)
+    {
+        systemFatal("calloc");
+    }
+
+    pthread_barrier_init(&barrier, NULL, threads);
+    for (int i = 0; i < threads; i++)
+    {
+        workers[i].id = i;
+        workers[i].bench = bench;
+        if ((workers[i].nsPerOp = calloc(config.samples, sizeof(double))) == NULL
+            || (workers[i].cyclesPerOp = calloc(config.samples, sizeof(double))) == NULL)
+        {
+            systemFatal("calloc");
+        }
+        if (pthread_create(&workers[i].thread, NULL, microbenchWorker, &workers[i]))
+        {
+            systemFatal("pthread_create");
+        }
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+    }
+    pthread_barrier_destroy(&barrier);
+
+    for (int s = 0; s < config.samples; s++)
+    {
+        double sample = 0;
+
+        for (int i = 0; i < threads; i++)
+        {
+            sample += workers[i].nsPerOp[s] / threads;
+            cycles += workers[i].cyclesPerOp[s] / threads / config.samples;
+        }
+
+        mean += sample / config.samples;
+        best = sample < best ? sample : best;
+    }
+    for (int s = 0; s < config.samples; s++)
+    {
+        double sample = 0;
+
+        for (int i = 0; i < threads; i++)
+        {
+            sample += workers[i].nsPerOp[s] / threads;
+        }
+        variance += (sample - mean) * (sample - mean) / (config.samples - 1);
+    }
+
+    if (cyclesCounted)
+    {
+        snprintf(cycleText, sizeof(cycleText), "%.1f", cycles);
+    }
+    else
+    {
+        strcpy(cycleText, "n/a");
+    }
+
+    printf("%-12s %7d %12.1f %10.1f %12.1f %12s %12.3f\n", bench->name, threads, mean, sqrt(variance), best,
+           cycleText, threads * 1000 / mean);
+    fflush(stdout);
+
+    for (int i = 0; i < threads; i++)
+    {
+        free(workers[i].nsPerOp);
+        free(workers[i].cyclesPerOp);
+    }
+    free(workers);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                microbenchWorker
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void *microbenchWorker(void *args)
+--                              void *args: The struct microbench_thread of the thread.
+--
+-- RETURNS:                 NULL.
+--
+-- NOTES:
+-- Sets up the sockets of the thread, warms up with a tenth of a sample, then runs every sample in
+-- step with the other threads.
+--------------------------------------------------------------------------------------------------*/
+void *microbenchWorker(void *args)
+{
+    struct microbench_thread *thread = (struct microbench_thread *)args;
+    const int ops = config.iterations / thread->bench->scale > 0 ? config.iterations / thread->bench->scale : 1;
+    uint64_t cycles = 0;
+
+    thread->sock = -1;
+    thread->peer = -1;
+    if ((thread->buffer = malloc(config.size)) == NULL)
+    {
+        systemFatal("malloc");
+    }
+    memset(thread->buffer, 'a', config.size);
+
+    if (!thread->bench->setup(thread))
+    {
+        systemFatal(thread->bench->name);
+    }
+    thread->perfFd = cyclesCounted ? openCycleCounter(cyclesKernel) : -1;
+
+    thread->bench->run(thread, ops / 10 + 1, &cycles);
+
+    for (int s = 0; s < config.samples; s++)
+    {
+        uint64_t ns;
+
+        pthread_barrier_wait(&barrier);
+        cycles = 0;
+        ns = thread->bench->run(thread, ops, &cycles);
+        thread->nsPerOp[s] = (double)ns / ops;
+        thread->cyclesPerOp[s] = (double)cycles / ops;
+    }
+
+    if (thread->perfFd != -1)
+    {
+        close(thread->perfFd);
+    }
+    if (thread->sock != -1)
+    {
+        close(thread->sock);
+    }
+    if (thread->peer != -1)
+    {
+        close(thread->peer);
+    }
+    free(thread->buffer);
+
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                caseSelected
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool caseSelected(const char *name)
+--                              const char *name: The name of a benchmark.
+--
+-- RETURNS:                 True if -b was not given or lists the benchmark, false otherwise.
+--------------------------------------------------------------------------------------------------*/
+bool caseSelected(const char *name)
+{
+    size_t length = strlen(name);
+
+    if (config.only == NULL)
+    {
+        return true;
+    }
+
+    for (const char *item = config.only; item != NULL; item = strchr(item, ','))
+    {
+        if (*item == ',')
+        {
+            item++;
+        }
+        if (!strncmp(item, name, length) && (item[length] == ',' || item[length] == '\0'))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                openCycleCounter
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int openCycleCounter(const bool kernel)
+--                              const bool kernel: Whether to count the cycles spent in the kernel too.
+--
+-- RETURNS:                 The counter or -1 if perf counters can not be opened.
+--
+-- NOTES:
+-- Opens a counter of the cpu cycles of the calling thread on any cpu. Counting the kernel is usually
+-- only allowed with a perf_event_paranoid of 1 or less, and inside containers and virtual machines
+-- the counters are often missing altogether.
+--------------------------------------------------------------------------------------------------*/
+int openCycleCounter(const bool kernel)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = !kernel;
+    attr.exclude_hv = 1;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                readCycles
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               uint64_t readCycles(const int fd)
+--                              const int fd: A counter from openCycleCounter() or -1.
+--
+-- RETURNS:                 The cycles counted so far, 0 without a counter.
+--------------------------------------------------------------------------------------------------*/
+uint64_t readCycles(const int fd)
+{
+    uint64_t value = 0;
+
+    if (fd == -1 || read(fd, &value, sizeof(value)) != sizeof(value))
+    {
+        return 0;
+    }
+
+    return value;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                nowNs
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               uint64_t nowNs()
+--
+-- RETURNS:                 The monotonic time in nanoseconds.
+--------------------------------------------------------------------------------------------------*/
+uint64_t nowNs()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                batchMessages
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int batchMessages()
+--
+-- RETURNS:                 The messages a socket benchmark moves between two fills or drains of the peer.
+--
+-- NOTES:
+-- A batch has to fit in the socket buffers, or the timed calls would block on the peer.
+--------------------------------------------------------------------------------------------------*/
+int batchMessages()
+{
+    const int messages = MICROBENCH_BATCH_BYTES / config.size;
+
+    return messages < MICROBENCH_BATCH_MESSAGES ? messages : MICROBENCH_BATCH_MESSAGES;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                setupPair
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Set TCP_NODELAY on both ends.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool setupPair(struct microbench_thread *thread)
+--                              struct microbench_thread *thread: The thread to connect.
+--
+-- RETURNS:                 False if the sockets could not be connected, true otherwise.
+--
+-- NOTES:
+-- Connects a blocking socket under test to its peer, over loopback tcp through a listener on an
+-- ephemeral port or with -u as a unix socketpair. Both ends of a tcp pair have Nagle turned off, or
+-- every echo of a batch would wait for the delayed ack of the one before it.
+--------------------------------------------------------------------------------------------------*/
+bool setupPair(struct microbench_thread *thread)
+{
+    struct sockaddr_in address;
+    socklen_t length = sizeof(address);
+    int listener;
+    int sockets[2];
+    int on = 1;
+
+    if (config.unixSockets)
+    {
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) == -1)
+        {
+            return false;
+        }
+        thread->sock = sockets[0];
+        thread->peer = sockets[1];
+        return true;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if ((listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+    {
+        return false;
+    }
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) == -1 || listen(listener, 1) == -1
+        || getsockname(listener, (struct sockaddr *)&address, &length) == -1
+        || (thread->peer = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1
+        || connect(thread->peer, (struct sockaddr *)&address, sizeof(address)) == -1
+        || (thread->sock = accept(listener, NULL, NULL)) == -1)
+    {
+        close(listener);
+        return false;
+    }
+    close(listener);
+
+    return setsockopt(thread->sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) == 0
+           && setsockopt(thread->peer, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) == 0;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                setupListener
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool setupListener(struct microbench_thread *thread)
+--                              struct microbench_thread *thread: The thread to listen for.
+--
+-- RETURNS:                 False if the listener could not be created, true otherwise.
+--
+-- NOTES:
+-- Listens on an ephemeral loopback port of the thread's own and keeps its address to connect to.
+--------------------------------------------------------------------------------------------------*/
+bool setupListener(struct microbench_thread *thread)
+{
+    socklen_t length = sizeof(thread->address);
+
+    memset(&thread->address, 0, sizeof(thread->address));
+    thread->address.sin_family = AF_INET;
+    thread->address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    return (thread->sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) != -1
+           && bind(thread->sock, (struct sockaddr *)&thread->address, sizeof(thread->address)) == 0
+           && listen(thread->sock, MICROBENCH_ACCEPT_BATCH * 2) == 0
+           && getsockname(thread->sock, (struct sockaddr *)&thread->address, &length) == 0;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                setupNothing
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool setupNothing(struct microbench_thread *thread)
+--                              struct microbench_thread *thread: The thread.
+--
+-- RETURNS:                 True.
+--
+-- NOTES:
+-- The setup of the benchmarks that need no sockets.
+--------------------------------------------------------------------------------------------------*/
+bool setupNothing(struct microbench_thread *thread)
+{
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                benchReadAll
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               uint64_t benchReadAll(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+--                              struct microbench_thread *thread: The thread.
+--                              const int ops: The number of calls.
+--                              uint64_t *cycles: Has the cycles of the calls added.
+--
+-- RETURNS:                 The ns the calls took.
+--
+-- NOTES:
+-- Times readAllFromSocket of a message that is already waiting in the socket.
+--------------------------------------------------------------------------------------------------*/
+uint64_t benchReadAll(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+{
+    const int batch = batchMessages();
+    uint64_t total = 0;
+
+    for (int done = 0; done < ops; done += batch)
+    {
+        int count = ops - done < batch ? ops - done : batch;
+        uint64_t startCycles;
+        uint64_t start;
+
+        fillPeer(thread, count);
+
+        startCycles = readCycles(thread->perfFd);
+        start = nowNs();
+        for (int i = 0; i < count; i++)
+        {
+            readAllFromSocket(thread->sock, thread->buffer, config.size);
+        }
+        total += nowNs() - start;
+        *cycles += readCycles(thread->perfFd) - startCycles;
+    }
+
+    return total;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                benchSend
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               uint64_t benchSend(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+--                              struct microbench_thread *thread: The thread.
+--                              const int ops: The number of calls.
+--                              uint64_t *cycles: Has the cycles of the calls added.
+--
+-- RETURNS:                 The ns the calls took.
+--
+-- NOTES:
+-- Times sendToSocket of a message into a socket with room for it.
+--------------------------------------------------------------------------------------------------*/
+uint64_t benchSend(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+{
+    const int batch = batchMessages();
+    uint64_t total = 0;
+
+    for (int done = 0; done < ops; done += batch)
+    {
+        int count = ops - done < batch ? ops - done : batch;
+        uint64_t startCycles = readCycles(thread->perfFd);
+        uint64_t start = nowNs();
+
+        for (int i = 0; i < count; i++)
+        {
+            sendToSocket(thread->sock, thread->buffer, config.size);
+        }
+        total += nowNs() - start;
+        *cycles += readCycles(thread->perfFd) - startCycles;
+
+        drainPeer(thread, count);
+    }
+
+    return total;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                benchSendVector
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               uint64_t benchSendVector(struct microbench_thread *thread, const int ops,
+--                                                   uint64_t *cycles)
+--                              struct microbench_thread *thread: The thread.
+--                              const int ops: The number of calls.
+--                              uint64_t *cycles: Has the cycles of the calls added.
+--
+-- RETURNS:                 The ns the calls took.
+--
+-- NOTES:
+-- Times sendVectorToSocket of a message in two pieces, the way handlers queue a header and a payload.
+--------------------------------------------------------------------------------------------------*/
+uint64_t benchSendVector(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+{
+    const int batch = batchMessages();
+    struct iovec iov[2];
+    uint64_t total = 0;
+
+    iov[0].iov_base = thread->buffer;
+    iov[0].iov_len = config.size / 2;
+    iov[1].iov_base = thread->buffer + config.size / 2;
+    iov[1].iov_len = config.size - config.size / 2;
+
+    for (int done = 0; done < ops; done += batch)
+    {
+        int count = ops - done < batch ? ops - done : batch;
+        uint64_t startCycles = readCycles(thread->perfFd);
+        uint64_t start = nowNs();
+
+        for (int i = 0; i < count; i++)
+        {
+            sendVectorToSocket(thread->sock, iov, 2, 0);
+        }
+        total += nowNs() - start;
+        *cycles += readCycles(thread->perfFd) - startCycles;
+
+        drainPeer(thread, count);
+    }
+
+    return total;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                benchClear
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               uint64_t benchClear(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+--                              struct microbench_thread *thread: The thread.
+--                              const int ops: The number of calls.
+--                              uint64_t *cycles: Has the cycles of the calls added.
+--
+-- RETURNS:                 The ns the calls took.
+--
+-- NOTES:
+-- Times clearSocket, a read of a waiting message and its echo.
+--------------------------------------------------------------------------------------------------*/
+uint64_t benchClear(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+{
+    const int batch = batchMessages();
+    uint64_t total = 0;
+
+    for (int done = 0; done < ops; done += batch)
+    {
+        int count = ops - done < batch ? ops - done : batch;
+        uint64_t startCycles;
+        uint64_t start;
+
+        fillPeer(thread, count);
+
+        startCycles = readCycles(thread->perfFd);
+        start = nowNs();
+        for (int i = 0; i < count; i++)
+        {
+            clearSocket(thread->sock, thread->buffer, config.size);
+        }
+        total += nowNs() - start;
+        *cycles += readCycles(thread->perfFd) - startCycles;
+
+        drainPeer(thread, count);
+    }
+
+    return total;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                benchAccept
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               uint64_t benchAccept(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+--                              struct microbench_thread *thread: The thread.
+--                              const int ops: The number of calls.
+--                              uint64_t *cycles: Has the cycles of the calls added.
+--
+-- RETURNS:                 The ns the calls took.
+--
+-- NOTES:
+-- Times acceptNewConnection of a connection that is already waiting in the backlog. The clients are
+-- reset on close so that a long run does not use up the ephemeral ports with TIME_WAIT.
+--------------------------------------------------------------------------------------------------*/
+uint64_t benchAccept(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+{
+    const struct linger reset = { 1, 0 };
+    int clients[MICROBENCH_ACCEPT_BATCH];
+    int accepted[MICROBENCH_ACCEPT_BATCH];
+    uint64_t total = 0;
+
+    for (int done = 0; done < ops; done += MICROBENCH_ACCEPT_BATCH)
+    {
+        int count = ops - done < MICROBENCH_ACCEPT_BATCH ? ops - done : MICROBENCH_ACCEPT_BATCH;
+        struct sockaddr_in client;
+        uint64_t startCycles;
+        uint64_t start;
+
+        for (int i = 0; i < count; i++)
+        {
+            if ((clients[i] = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1
+                || connect(clients[i], (struct sockaddr *)&thread->address, sizeof(thread->address)) == -1)
+            {
+                systemFatal("connect");
+            }
+            setsockopt(clients[i], SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+        }
+
+        startCycles = readCycles(thread->perfFd);
+        start = nowNs();
+        for (int i = 0; i < count; i++)
+        {
+            if (!acceptNewConnection(thread->sock, &accepted[i], &client, SOCK_CLOEXEC))
+            {
+                systemFatal("acceptNewConnection");
+            }
+        }
+        total += nowNs() - start;
+        *cycles += readCycles(thread->perfFd) - startCycles;
+
+        for (int i = 0; i < count; i++)
+        {
+            close(clients[i]);
+            close(accepted[i]);
+        }
+    }
+
+    return total;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                benchLogRcv
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               uint64_t benchLogRcv(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+--                              struct microbench_thread *thread: The thread.
+--                              const int ops: The number of calls.
+--                              uint64_t *cycles: Has the cycles of the calls added.
+--
+-- RETURNS:                 The ns the calls took.
+--
+-- NOTES:
+-- Times logRcv, including any time the thread waits for the flusher with the block policy.
+--------------------------------------------------------------------------------------------------*/
+uint64_t benchLogRcv(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+{
+    uint64_t startCycles = readCycles(thread->perfFd);
+    uint64_t start = nowNs();
+
+    for (int i = 0; i < ops; i++)
+    {
+        logRcv(thread->id, config.size);
+    }
+
+    *cycles += readCycles(thread->perfFd) - startCycles;
+    return nowNs() - start;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                benchLogSnd
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               uint64_t benchLogSnd(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+--                              struct microbench_thread *thread: The thread.
+--                              const int ops: The number of calls.
+--                              uint64_t *cycles: Has the cycles of the calls added.
+--
+-- RETURNS:                 The ns the calls took.
+--
+-- NOTES:
+-- Times logSnd, including any time the thread waits for the flusher with the block policy.
+--------------------------------------------------------------------------------------------------*/
+uint64_t benchLogSnd(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+{
+    uint64_t startCycles = readCycles(thread->perfFd);
+    uint64_t start = nowNs();
+
+    for (int i = 0; i < ops; i++)
+    {
+        logSnd(thread->id, config.size);
+    }
+
+    *cycles += readCycles(thread->perfFd) - startCycles;
+    return nowNs() - start;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                benchFormatTime
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               uint64_t benchFormatTime(struct microbench_thread *thread, const int ops,
+--                                                   uint64_t *cycles)
+--                              struct microbench_thread *thread: The thread.
+--                              const int ops: The number of calls.
+--                              uint64_t *cycles: Has the cycles of the calls added.
+--
+-- RETURNS:                 The ns the calls took.
+--------------------------------------------------------------------------------------------------*/
+uint64_t benchFormatTime(struct microbench_thread *thread, const int ops, uint64_t *cycles)
+{
+    struct timeval time;
+    size_t ms;
+    size_t us;
+    size_t sum = 0;
+    uint64_t startCycles;
+    uint64_t start;
+
+    gettimeofday(&time, NULL);
+
+    startCycles = readCycles(thread->perfFd);
+    start = nowNs();
+    for (int i = 0; i < ops; i++)
+    {
+        time.tv_usec = i % 1000000;
+        formatTime(&ms, &us, &time);
+        sum += ms + us;
+    }
+    *cycles += readCycles(thread->perfFd) - startCycles;
+    start = nowNs() - start;
+
+    sink = sum;
+    return start;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                fillPeer
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void fillPeer(struct microbench_thread *thread, const int count)
+--                              struct microbench_thread *thread: The thread.
+--                              const int count: The number of messages.
+--
+-- NOTES:
+-- Sends count messages from the peer to the socket under test with plain sends, so neither the
+-- stats nor the log see them.
+--------------------------------------------------------------------------------------------------*/
+void fillPeer(struct microbench_thread *thread, const int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        for (int sent = 0; sent < config.size;)
+        {
+            ssize_t n = send(thread->peer, thread->buffer + sent, config.size - sent, MSG_NOSIGNAL);
+
+            if (n == -1 && errno != EINTR)
+            {
+                systemFatal("send");
+            }
+            sent += n > 0 ? n : 0;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                drainPeer
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void drainPeer(struct microbench_thread *thread, const int count)
+--                              struct microbench_thread *thread: The thread.
+--                              const int count: The number of messages.
+--
+-- NOTES:
+-- Reads count messages the socket under test sent at the peer with plain recvs.
+--------------------------------------------------------------------------------------------------*/
+void drainPeer(struct microbench_thread *thread, const int count)
+{
+    char scratch[MICROBENCH_BATCH_BYTES];
+    size_t left = (size_t)count * config.size;
+
+    while (left > 0)
+    {
+        ssize_t n = recv(thread->peer, scratch, left < sizeof(scratch) ? left : sizeof(scratch), 0);
+
+        if (n == 0 || (n == -1 && errno != EINTR))
+        {
+            systemFatal("recv");
+        }
+        left -= n > 0 ? n : 0;
+    }
+}
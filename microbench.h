@@ -0,0 +1,84 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// the most thread counts -t takes
+#define MICROBENCH_MAX_RUNS 16
+// bytes a batch of socket operations moves, small enough to sit in the socket buffers untouched
+#define MICROBENCH_BATCH_BYTES (32 * 1024)
+// messages a batch moves at most, unix sockets charge every small send a whole skb of the buffer
+#define MICROBENCH_BATCH_MESSAGES 64
+// connections an accept batch queues, below the listen backlog
+#define MICROBENCH_ACCEPT_BATCH 64
+
+struct microbench_config
+{
+    int threads[MICROBENCH_MAX_RUNS];
+    int runs;
+    int iterations;
+    int samples;
+    int size;
+    bool unixSockets;
+    int logPolicy;
+    int logFormat;
+    const char *only;
+};
+
+struct microbench_thread
+{
+    int id;
+    pthread_t thread;
+    const struct microbench_case *bench;
+    // the socket under test and its peer, or the listener for accept and its address
+    int sock;
+    int peer;
+    struct sockaddr_in address;
+    char *buffer;
+    // -1 when the cpu cycles can not be counted
+    int perfFd;
+    // ns and cycles per op of every sample
+    double *nsPerOp;
+    double *cyclesPerOp;
+};
+
+struct microbench_case
+{
+    const char *name;
+    // a sample does iterations / scale operations, for the ones much slower than the rest
+    int scale;
+    bool (*setup)(struct microbench_thread *thread);
+    // does ops operations and returns the ns they took, adding the cycles they took to cycles
+    uint64_t (*run)(struct microbench_thread *thread, const int ops, uint64_t *cycles);
+};
+
+void parseArguments(int argc, char *argv[]);
+void printHelp(const char *name);
+void runCase(const struct microbench_case *bench, const int threads);
+void *microbenchWorker(void *args);
+bool caseSelected(const char *name);
+int openCycleCounter(const bool kernel);
+uint64_t readCycles(const int fd);
+uint64_t nowNs();
+int batchMessages();
+
+bool setupPair(struct microbench_thread *thread);
+bool setupListener(struct microbench_thread *thread);
+bool setupNothing(struct microbench_thread *thread);
+
+uint64_t benchReadAll(struct microbench_thread *thread, const int ops, uint64_t *cycles);
+uint64_t benchSend(struct microbench_thread *thread, const int ops, uint64_t *cycles);
+uint64_t benchSendVector(struct microbench_thread *thread, const int ops, uint64_t *cycles);
+uint64_t benchClear(struct microbench_thread *thread, const int ops, uint64_t *cycles);
+uint64_t benchAccept(struct microbench_thread *thread, const int ops, uint64_t *cycles);
+uint64_t benchLogRcv(struct microbench_thread *thread, const int ops, uint64_t *cycles);
+uint64_t benchLogSnd(struct microbench_thread *thread, const int ops, uint64_t *cycles);
+uint64_t benchFormatTime(struct microbench_thread *thread, const int ops, uint64_t *cycles);
+
+void fillPeer(struct microbench_thread *thread, const int count);
+void drainPeer(struct microbench_thread *thread, const int count);
+
+#endif // MICROBENCH_H
@@ -5,13 +5,20 @@
 --
 -- FUNCTIONS:
 --                         bool setSocketToReuse(int sock)
+--                         bool setSocketToReusePort(int sock)
+--                         bool setSocketZeroCopy(int sock)
 --                         bool setSocketToNonBlocking(int sock)
 --                         bool setSocketTimeout(const size_t sec, const size_t usec, const int sock)
 --                         bool createTCPSocket(int *sock)
---                         bool createBoundSocket(int *sock, const short port)
---                         bool acceptNewConnection(const int listenSocket, int *newSocket, struct sockaddr_in *client)
+--                         bool createBoundSocket(int *sock, const short port, const bool reusePort)
+--                         bool attachReusePortSteering(int sock, const int *cpus, const int groupSize)
+--                         bool acceptNewConnection(const int listenSocket, int *newSocket, struct sockaddr_in *client,
+--                                                  const int flags)
 --                         int readAllFromSocket(const int sock, char *buffer, const int size)
+--                         int readFromSocket(const int sock, char *buffer, const int size)
 --                         int sendToSocket(const int sock, char *buffer, const int size)
+--                         size_t sendVectorToSocket(const int sock, const struct iovec *iov, const int count,
+--                                                   const int flags)
 --                         bool clearSocket(int socket, char* buf, const int len)
 --
 -- DATE:                   Feb 19, 2019
@@ -25,12 +32,18 @@
 -- NOTES:
 -- Contains wrapper functions for network related system calls.
 ---------------------------------------------------------------------------------------*/
+#define _GNU_SOURCE
 #include "net.h"
 
+#include <errno.h>
 #include <fcntl.h>
+#include <linux/filter.h>
+#include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 #include <unistd.h>
 
+#include "stats.h"
 #include "tools.h"
 
 /*--------------------------------------------------------------------------------------------------
@@ -64,6 +77,70 @@ bool setSocketToReuse(int sock)
     return true;
 }
 
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                setSocketToReusePort
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool setSocketToReusePort(int sock)
+--                              int sock: The socket to configure.
+--
+-- RETURNS:                 True if the socket reuse port flag was set, false otherwise.
+--
+-- NOTES:
+-- Sets the socket's reuse port flag so that several sockets can bind the same port and the kernel
+-- balances incoming connections between them.
+--------------------------------------------------------------------------------------------------*/
+bool setSocketToReusePort(int sock)
+{
+    const int arg = 1;
+
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &arg, sizeof(int)) == -1)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                setSocketZeroCopy
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool setSocketZeroCopy(int sock)
+--                              int sock: The socket to configure.
+--
+-- RETURNS:                 True if the zero copy flag was set, false otherwise.
+--
+-- NOTES:
+-- Sets SO_ZEROCOPY so that sends with MSG_ZEROCOPY pin the user buffer instead of copying it. The
+-- kernel reports when it is done with the buffer on the error queue of the socket.
+--------------------------------------------------------------------------------------------------*/
+bool setSocketZeroCopy(int sock)
+{
+    const int arg = 1;
+
+    if (setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &arg, sizeof(int)) == -1)
+    {
+        return false;
+    }
+
+    return true;
+}
+
 /*--------------------------------------------------------------------------------------------------
 -- FUNCTION:                setSocketToNonBlocking
 --
@@ -174,17 +251,18 @@ bool createTCPSocket(int *sock)
 --
 -- PROGRAMMER:              Benny Wang
 --
--- INTERFACE:               bool createBoundSocket(int *sock, const short port)
+-- INTERFACE:               bool createBoundSocket(int *sock, const short port, const bool reusePort)
 --                              int *sock: A pointer to hold the new socket.
 --                              const short port: The port to bind on.
+--                              const bool reusePort: Whether to set SO_REUSEPORT before binding.
 --
 -- RETURNS:                 True of a bound TCP socket was created, false otherwise.
 --
 -- NOTES:
 -- Creates a bound TCP socket on port port and places it into sock. The socket will be bound for
--- address INADDR_ANY.
+-- address INADDR_ANY. If reusePort is set, other sockets with the flag may bind the same port.
 --------------------------------------------------------------------------------------------------*/
-bool createBoundSocket(int *sock, const short port)
+bool createBoundSocket(int *sock, const short port, const bool reusePort)
 {
     struct sockaddr_in server;
 
@@ -193,6 +271,11 @@ bool createBoundSocket(int *sock, const short port)
         return false;
     }
 
+    if (reusePort && !setSocketToReusePort(*sock))
+    {
+        return false;
+    }
+
     bzero(&server, sizeof(struct sockaddr_in));
     server.sin_family = AF_INET;
     server.sin_port = htons(port);
@@ -206,33 +289,101 @@ bool createBoundSocket(int *sock, const short port)
     return true;
 }
 
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                attachReusePortSteering
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Steer to the cpu of each socket instead of its index.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool attachReusePortSteering(int sock, const int *cpus, const int groupSize)
+--                              int sock: Any listening socket in the reuse port group.
+--                              const int *cpus: The cpu of the worker of each socket in the group.
+--                              const int groupSize: The number of sockets in the group.
+--
+-- RETURNS:                 True if the program was attached, false otherwise.
+--
+-- NOTES:
+-- Attaches a classic BPF program to the reuse port group of sock that picks the socket whose worker
+-- runs on the CPU that received the packet. Classic BPF has no maps, so the program compares the CPU
+-- to the cpu of every socket in turn, and a packet received on a CPU no worker runs on goes to the
+-- socket at the CPU modulo groupSize. The program applies to the whole group, so it only has to be
+-- attached once, after every socket in the group is listening. Sockets join the group in the order
+-- they start listening.
+--------------------------------------------------------------------------------------------------*/
+bool attachReusePortSteering(int sock, const int *cpus, const int groupSize)
+{
+    struct sock_filter *code;
+    struct sock_fprog prog;
+    int len = 0;
+    bool attached;
+
+    if (groupSize > (BPF_MAXINSNS - 3) / 2)
+    {
+        errno = E2BIG;
+        return false;
+    }
+
+    if ((code = calloc(2 * groupSize + 3, sizeof(struct sock_filter))) == NULL)
+    {
+        return false;
+    }
+
+    // A = the current CPU
+    code[len++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU);
+    for (int i = 0; i < groupSize; i++)
+    {
+        // if A == cpus[i] return i, else skip the return
+        code[len++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, cpus[i], 0, 1);
+        code[len++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, i);
+    }
+    // A = A % groupSize
+    code[len++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, groupSize);
+    // return A as the socket index
+    code[len++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_A, 0);
+
+    prog.len = len;
+    prog.filter = code;
+    attached = setsockopt(sock, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) != -1;
+
+    free(code);
+    return attached;
+}
+
 /*--------------------------------------------------------------------------------------------------
 -- FUNCTION:                acceptNewConnection
 --
 -- DATE:                    Feb 19, 2019
 --
--- REVISIONS:               N/A
+-- REVISIONS:               Oct 17, 2026 - Take accept4 flags.
 --
 -- DESIGNER:                Benny Wang
 --
 -- PROGRAMMER:              Benny Wang
 --
--- INTERFACE:               bool acceptNewConnection(const int listenSocket, int *newSocket, struct sockaddr_in *client)
+-- INTERFACE:               bool acceptNewConnection(const int listenSocket, int *newSocket, struct sockaddr_in *client,
+--                                                   const int flags)
 --                              const int listenSocket: The listening socket.
 --                              int *newSocket: A pointer hold the new socket.
 --                              struct sockaddr_in *client: A pointer to hold the new client.
+--                              const int flags: SOCK_NONBLOCK and SOCK_CLOEXEC as for accept4.
 --
 -- RETURNS:                 True if the client was accepted, false otherwise.
 --
 -- NOTES:
 -- Accepts a new connection and places the new socket into newSocket and new sockaddr_in of the new
 -- client into client. Must call startLogging() located in tools.h once before executing this funciton.
+-- The flags are set by the accept itself, which saves the fcntl calls of setting them afterwards.
 --------------------------------------------------------------------------------------------------*/
-bool acceptNewConnection(const int listenSocket, int *newSocket, struct sockaddr_in *client)
+bool acceptNewConnection(const int listenSocket, int *newSocket, struct sockaddr_in *client, const int flags)
 {
     unsigned int length = sizeof(struct sockaddr_in);
     bzero(client, length);
-    if ((*newSocket = accept(listenSocket, (struct sockaddr *)client, &length)) == -1)
+    if ((*newSocket = accept4(listenSocket, (struct sockaddr *)client, &length, flags)) == -1)
     {
         return false;
     }
@@ -266,13 +417,25 @@ bool acceptNewConnection(const int listenSocket, int *newSocket, struct sockaddr
 --------------------------------------------------------------------------------------------------*/
 int readAllFromSocket(const int sock, char *buffer, const int size)
 {
-    int n = 1;
+    int n;
     char *bufferPointer = buffer;
     int remaining = size;
 
-    while (n > 0 && remaining > 0)
+    while (remaining > 0)
     {
         n = recv(sock, bufferPointer, remaining, 0);
+        if (n <= 0)
+        {
+            if (n == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n == -1)
+            {
+                statsAdd(errno == EAGAIN || errno == EWOULDBLOCK ? STAT_EAGAINS : STAT_ERRORS, 1);
+            }
+            break;
+        }
         bufferPointer += n;
         remaining -= n;
     }
@@ -280,11 +443,57 @@ int readAllFromSocket(const int sock, char *buffer, const int size)
     if (size - remaining > 0)
     {
         logRcv(sock, size - remaining);
+        statsAdd(STAT_BYTES_IN, size - remaining);
+        statsAdd(STAT_MESSAGES_IN, 1);
     }
 
     return size - remaining;
 }
 
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                readFromSocket
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int readFromSocket(const int sock, char *buffer, const int size)
+--                              const int sock: The socket to read.
+--                              char *buffer: The buffer for read data.
+--                              const int size: The size of the buffer.
+--
+-- RETURNS:                 The number of bytes read, 0 if the peer closed, -1 on error with errno set.
+--
+-- NOTES:
+-- Like readAllFromSocket, but only takes what a single recv returns, so a socket that does not block
+-- gives back EAGAIN instead of waiting for the rest of the buffer.
+--------------------------------------------------------------------------------------------------*/
+int readFromSocket(const int sock, char *buffer, const int size)
+{
+    int n;
+
+    while ((n = recv(sock, buffer, size, 0)) == -1 && errno == EINTR)
+    {
+    }
+
+    if (n > 0)
+    {
+        logRcv(sock, n);
+        statsAdd(STAT_BYTES_IN, n);
+        statsAdd(STAT_MESSAGES_IN, 1);
+    }
+    else if (n == -1)
+    {
+        statsAdd(errno == EAGAIN || errno == EWOULDBLOCK ? STAT_EAGAINS : STAT_ERRORS, 1);
+    }
+
+    return n;
+}
+
 /*--------------------------------------------------------------------------------------------------
 -- FUNCTION:                sendToSocket
 --
@@ -304,21 +513,110 @@ int readAllFromSocket(const int sock, char *buffer, const int size)
 -- RETURNS:                 The number of bytes sent.
 --
 -- NOTES:
--- Sends the contents of buffer to sock and logs the amount of data that was sent. Must call
--- startLogging() located in tools.h once before executing this function.
+-- Sends the contents of buffer to sock and logs the amount of data that was sent. Keeps sending after
+-- a short write until everything was sent or the send fails, so a result smaller than size means the
+-- socket failed. Must call startLogging() located in tools.h once before executing this function.
 --------------------------------------------------------------------------------------------------*/
 int sendToSocket(const int sock, char *buffer, const int size)
 {
-    if (size <= 0)
+    int n;
+    int sent = 0;
+
+    while (sent < size)
     {
-        return 0;
+        n = send(sock, buffer + sent, size - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            if (n == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n == -1)
+            {
+                statsAdd(errno == EAGAIN || errno == EWOULDBLOCK ? STAT_EAGAINS : STAT_ERRORS, 1);
+            }
+            break;
+        }
+        logSnd(sock, n);
+        statsAdd(STAT_BYTES_OUT, n);
+        statsAdd(STAT_MESSAGES_OUT, 1);
+        sent += n;
     }
-    int n = send(sock, buffer, size, 0);
-    if (n > 0)
+
+    return sent;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                sendVectorToSocket
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Take flags for sendmsg.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               size_t sendVectorToSocket(const int sock, const struct iovec *iov, const int count,
+--                                                    const int flags)
+--                              const int sock: The socket to write.
+--                              const struct iovec *iov: The pieces to send in order.
+--                              const int count: The number of pieces, at most IOV_MAX.
+--                              const int flags: Flags for sendmsg besides MSG_NOSIGNAL, like MSG_MORE.
+--
+-- RETURNS:                 The number of bytes sent.
+--
+-- NOTES:
+-- Like sendToSocket, but gathers all pieces into one sendmsg and only sends again after a short
+-- write, starting from the first byte that was not sent.
+--------------------------------------------------------------------------------------------------*/
+size_t sendVectorToSocket(const int sock, const struct iovec *iov, const int count, const int flags)
+{
+    struct iovec rest[count];
+    struct msghdr msg;
+    size_t sent = 0;
+
+    memcpy(rest, iov, count * sizeof(struct iovec));
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = rest;
+    msg.msg_iovlen = count;
+
+    while (msg.msg_iovlen > 0)
     {
+        ssize_t n = sendmsg(sock, &msg, MSG_NOSIGNAL | flags);
+
+        if (n <= 0)
+        {
+            if (n == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n == -1)
+            {
+                statsAdd(errno == EAGAIN || errno == EWOULDBLOCK ? STAT_EAGAINS : STAT_ERRORS, 1);
+            }
+            break;
+        }
         logSnd(sock, n);
+        statsAdd(STAT_BYTES_OUT, n);
+        statsAdd(STAT_MESSAGES_OUT, 1);
+        sent += n;
+
+        // skip what went out, the first piece left may have been sent in part
+        while (msg.msg_iovlen > 0 && (size_t)n >= msg.msg_iov->iov_len)
+        {
+            n -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0)
+        {
+            msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + n;
+            msg.msg_iov->iov_len -= n;
+        }
     }
-    return n;
+
+    return sent;
 }
 
 /*--------------------------------------------------------------------------------------------------
@@ -337,7 +635,7 @@ int sendToSocket(const int sock, char *buffer, const int size)
 --                              char *buf: The buffer to place the data.
 --                              const int len: The length of the buffer.
 --
--- RETURNS:                 The number of bytes received, -1 if receiving failed.
+-- RETURNS:                 The number of bytes received, -1 if sending the echo failed.
 --
 -- NOTES:
 -- Reads all the data from the sock into buf and then sends buf to sock.
@@ -345,6 +643,9 @@ int sendToSocket(const int sock, char *buffer, const int size)
 int clearSocket(int sock, char *buf, const int len)
 {
     int n = readAllFromSocket(sock, buf, len);
-    sendToSocket(sock, buf, n);
+    if (sendToSocket(sock, buf, n) < n)
+    {
+        return -1;
+    }
     return n;
 }
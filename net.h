@@ -5,15 +5,21 @@
 #include <stdbool.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 bool setSocketToReuse(int sock);
+bool setSocketToReusePort(int sock);
+bool setSocketZeroCopy(int sock);
 bool setSocketToNonBlocking(int sock);
 bool setSocketTimeout(const size_t sec, const size_t usec, const int sock);
 bool createTCPSocket(int *sock);
-bool createBoundSocket(int *sock, const short port);
-bool acceptNewConnection(const int listenSocket, int *newSocket, struct sockaddr_in *client);
+bool createBoundSocket(int *sock, const short port, const bool reusePort);
+bool attachReusePortSteering(int sock, const int *cpus, const int groupSize);
+bool acceptNewConnection(const int listenSocket, int *newSocket, struct sockaddr_in *client, const int flags);
 int readAllFromSocket(const int sock, char *buffer, const int size);
+int readFromSocket(const int sock, char *buffer, const int size);
 int sendToSocket(const int sock, char *buffer, const int size);
+size_t sendVectorToSocket(const int sock, const struct iovec *iov, const int count, const int flags);
 int clearSocket(int socket, char* buf, const int len);
 
 #endif // NET_H
\ No newline at end of file
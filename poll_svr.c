@@ -0,0 +1,441 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            poll_svr.c
+--
+-- PROGRAM:                server.out
+--
+-- FUNCTIONS:
+--                         void runPoll(const int listenSocket, const struct server_config *config)
+--                         void *pollWorker(void *args)
+--                         void adoptPollConnections(struct poll_worker_arg *args)
+--                         void addPollConnection(struct poll_worker_arg *args, const int newSocket)
+--                         void handlePollData(struct poll_worker_arg *args, int num, char *buffer)
+--                         void stopPoll(const int action)
+--
+-- DATE:                   Oct 17, 2026
+--
+-- REVISIONS:              Oct 18, 2026 - Share the acceptor with select mode and read without blocking.
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- Contains all functions used for running the server in poll mode.
+--
+-- Poll mode is select mode without FD_SETSIZE. Connections are accepted by the acceptor thread of
+-- acceptor.c and handed to the least loaded worker the same way, but every worker keeps its clients
+-- in a compact pollfd array that doubles when it fills up. A closed client is replaced by the last
+-- entry of the array, so the array never has holes and poll only ever looks at live sockets. The
+-- first entry is always the eventfd the acceptor wakes the worker with.
+--
+-- The sockets do not block. A ready client gets a single recv of whatever it has sent, so a client
+-- that sent half a message holds up nobody else.
+---------------------------------------------------------------------------------------*/
+#define _REENTRANT
+#define DCE_COMPAT
+
+#include "poll_svr.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "affinity.h"
+#include "control.h"
+#include "metrics.h"
+#include "stats.h"
+#include "tools.h"
+#include "net.h"
+
+static struct poll_worker_arg *workers;
+static int nWorkers;
+static struct acceptor acceptor;
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                runPoll
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - The configured number of workers, each with its cpu.
+--                          Oct 17, 2026 - Wait for the server to be stopped or drained.
+--                          Oct 17, 2026 - Pass on the protocol handler.
+--                          Oct 18, 2026 - Use the shared acceptor, with sockets that do not block.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void runPoll(const int listenSocket, const struct server_config *config)
+--                              const int listenSocket: The listening socket.
+--                              const struct server_config *config: The server configuration.
+--
+-- NOTES:
+-- The main entry point for poll mode. Creates the acceptor with a queue for each worker, spawns the
+-- workers, each given the cpu it runs on, and the acceptor thread, waits to be stopped or drained and
+-- then for all of them to exit.
+--------------------------------------------------------------------------------------------------*/
+void runPoll(const int listenSocket, const struct server_config *config)
+{
+    nWorkers = config->workers;
+    if ((workers = calloc(nWorkers, sizeof(struct poll_worker_arg))) == NULL)
+    {
+        systemFatal("calloc");
+    }
+
+    createAcceptor(&acceptor, listenSocket, nWorkers, 0);
+
+    // prepare args
+    for (int i = 0; i < nWorkers; i++)
+    {
+        struct poll_worker_arg *arg = workers + i;
+
+        arg->cpu = config->workerCpus[i];
+        arg->bufferLength = config->bufferLength;
+        arg->handler = config->handler;
+        arg->queue = acceptor.queues + i;
+    }
+
+    for (int i = 0; i < nWorkers; i++)
+    {
+        if (pthread_create(&workers[i].thread, NULL, pollWorker, (void *)(workers + i)))
+        {
+            systemFatal("pthread_create");
+        }
+    }
+
+    startAcceptor(&acceptor);
+
+    stopPoll(awaitControl());
+
+    for (int i = 0; i < nWorkers; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        free(workers[i].fds);
+        free(workers[i].conns);
+    }
+
+    destroyAcceptor(&acceptor);
+    free(workers);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                pollWorker
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Pin to the cpu and allocate on its node.
+--                          Oct 17, 2026 - Close the clients and return when draining.
+--                          Oct 17, 2026 - Let the handler free the clients closed when draining.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void *pollWorker(void *args)
+--                              void *args: A poll_worker_arg struct.
+--
+-- RETURNS:                 NULL - unused.
+--
+-- NOTES:
+-- The main function of each worker thread for poll. Pins itself to its cpu, allocates a buffer for
+-- storing data and a pollfd array holding only its eventfd, with the handler side of its clients
+-- next to it, on the node of that cpu and then goes
+-- into a forever loop that blocks on poll and then handles requests accordingly. The time spent
+-- handling each batch of ready sockets is recorded in the worker's metrics. A worker told to drain
+-- keeps echoing, closing every client it echoed, until none of its clients sent anything for
+-- POLL_DRAIN_GRACE_MS, then closes the rest and returns.
+--------------------------------------------------------------------------------------------------*/
+void *pollWorker(void *args)
+{
+    int numReady;
+    char *buffer;
+    bool draining = false;
+
+    struct poll_worker_arg *argPtr = (struct poll_worker_arg *)args;
+
+    // before anything is allocated so that it all lands on the node of the cpu
+    if (!pinWorker(argPtr->cpu))
+    {
+        fprintf(stderr, "pinWorker: could not pin worker to cpu %d\n", argPtr->cpu);
+    }
+
+    if ((buffer = calloc(sizeof(char), argPtr->bufferLength)) == NULL)
+    {
+        systemFatal("calloc");
+    }
+
+    if ((argPtr->fds = calloc(POLL_INITIAL_FDS, sizeof(struct pollfd))) == NULL
+        || (argPtr->conns = calloc(POLL_INITIAL_FDS, sizeof(struct handler_conn))) == NULL)
+    {
+        systemFatal("calloc");
+    }
+    argPtr->capacity = POLL_INITIAL_FDS;
+    argPtr->nfds = 1;
+    argPtr->fds[0].fd = argPtr->queue->wakeFd;
+    argPtr->fds[0].events = POLLIN;
+
+    // claim a stats slot up front so that idle workers show up too
+    createLocalStats();
+
+    while (true)
+    {
+        uint64_t loopStart;
+
+        if ((numReady = poll(argPtr->fds, argPtr->nfds, draining ? POLL_DRAIN_GRACE_MS : -1)) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            systemFatal("poll");
+        }
+
+        // drained, nobody is in the middle of anything
+        if (numReady == 0)
+        {
+            break;
+        }
+        loopStart = metricsNow();
+
+        // handle the clients first, adopting may move the array
+        if (argPtr->fds[0].revents)
+        {
+            --numReady;
+        }
+
+        if (numReady > 0)
+        {
+            handlePollData(argPtr, numReady, buffer);
+        }
+
+        if (argPtr->fds[0].revents)
+        {
+            adoptPollConnections(argPtr);
+        }
+
+        metricsRecord(METRIC_LOOP, metricsNow() - loopStart);
+        statsAdd(STAT_LOOPS, 1);
+
+        draining = __atomic_load_n(&argPtr->queue->draining, __ATOMIC_ACQUIRE);
+    }
+
+    // the acceptor is gone, take what it queued last and let every client go
+    adoptPollConnections(argPtr);
+    for (int i = 1; i < argPtr->nfds; i++)
+    {
+        handlerClose(argPtr->conns + i);
+        statsAdd(STAT_CLOSES, 1);
+        close(argPtr->fds[i].fd);
+    }
+
+    free(buffer);
+
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                adoptPollConnections
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Take the sockets from the shared handoff queue.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void adoptPollConnections(struct poll_worker_arg *args)
+--                              struct poll_worker_arg *args: The worker arguments.
+--
+-- NOTES:
+-- Clears the eventfd of the worker and adds every socket the acceptor has queued for it. The eventfd
+-- is cleared first so that a socket queued while this runs wakes the worker again.
+--------------------------------------------------------------------------------------------------*/
+void adoptPollConnections(struct poll_worker_arg *args)
+{
+    int sock;
+
+    clearHandoffWake(args->queue);
+    while (takeHandedOffSocket(args->queue, &sock))
+    {
+        addPollConnection(args, sock);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                addPollConnection
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Start the protocol handler of the connection.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void addPollConnection(struct poll_worker_arg *args, const int newSocket)
+--                              struct poll_worker_arg *args: The worker arguments.
+--                              const int newSocket: The accepted socket.
+--
+-- NOTES:
+-- Appends a new connection to the pollfd array of the worker, doubling the array and the handler
+-- side of the clients next to it when it is full. The handler of the worker is started on the
+-- connection first, and a connection it refuses is closed instead.
+--------------------------------------------------------------------------------------------------*/
+void addPollConnection(struct poll_worker_arg *args, const int newSocket)
+{
+    struct handler_conn *conn;
+
+    if (args->nfds == args->capacity)
+    {
+        struct pollfd *fds;
+        struct handler_conn *conns = NULL;
+
+        if ((fds = realloc(args->fds, args->capacity * 2 * sizeof(struct pollfd))) != NULL)
+        {
+            args->fds = fds;
+            conns = realloc(args->conns, args->capacity * 2 * sizeof(struct handler_conn));
+        }
+
+        if (conns == NULL)
+        {
+            perror("realloc");
+            statsAdd(STAT_ERRORS, 1);
+            close(newSocket);
+            return;
+        }
+
+        args->conns = conns;
+        args->capacity *= 2;
+    }
+
+    statsAdd(STAT_ACCEPTS, 1);
+
+    conn = args->conns + args->nfds;
+    conn->fd = newSocket;
+    conn->handler = args->handler;
+    conn->write = writeBlocking;
+    conn->read = NULL;
+    if (!handlerAccept(conn))
+    {
+        handlerClose(conn);
+        statsAdd(STAT_CLOSES, 1);
+        close(newSocket);
+        return;
+    }
+
+    args->fds[args->nfds].fd = newSocket;
+    args->fds[args->nfds].events = POLLIN;
+    args->fds[args->nfds].revents = 0;
+    args->nfds++;
+
+    __atomic_store_n(&args->queue->clientCount, args->queue->clientCount + 1, __ATOMIC_RELAXED);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                handlePollData
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Close echoed clients when draining.
+--                          Oct 17, 2026 - Hand what was read to the protocol handler.
+--                          Oct 18, 2026 - One recv of whatever a ready client sent.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void handlePollData(struct poll_worker_arg *args, int num, char *buffer)
+--                              struct poll_worker_arg *args: The worker arguments.
+--                              int num: The number of ready clients.
+--                              char *buffer: The buffer to store the data.
+--
+-- NOTES:
+-- Handles all the client sockets that were flagged by the poll call. Reads whatever one recv of up to
+-- the buffer size returns from each and hands it to the handler, which answers it before the next
+-- socket is looked at. A socket that turns out to have nothing to read is left open.
+-- A closed socket is replaced by the last entry of the array, which is then looked at in its place,
+-- so every entry is looked at once. The time taken to answer each socket is recorded in the worker's
+-- metrics. While the worker drains every client is closed once it has its answer.
+--------------------------------------------------------------------------------------------------*/
+void handlePollData(struct poll_worker_arg *args, int num, char *buffer)
+{
+    int i = 1;
+
+    while (i < args->nfds && num > 0)
+    {
+        struct pollfd *client = args->fds + i;
+        uint64_t start;
+        int n = -1;
+        bool echoed = false;
+
+        if (!client->revents)
+        {
+            i++;
+            continue;
+        }
+
+        --num;
+        start = metricsNow();
+
+        if (!(client->revents & (POLLERR | POLLNVAL))
+            && (n = readFromSocket(client->fd, buffer, args->bufferLength)) > 0
+            && (echoed = handlerData(args->conns + i, buffer, n)))
+        {
+            metricsRecord(METRIC_SERVICE, metricsNow() - start);
+        }
+
+        // woken for nothing, the client is still there
+        if (n == -1 && !(client->revents & (POLLERR | POLLNVAL)) && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            i++;
+            continue;
+        }
+
+        // a draining worker lets a client go once it has its echo
+        if (echoed && !__atomic_load_n(&args->queue->draining, __ATOMIC_RELAXED))
+        {
+            i++;
+            continue;
+        }
+
+        handlerClose(args->conns + i);
+        statsAdd(STAT_CLOSES, 1);
+        close(client->fd);
+        *client = args->fds[--args->nfds];
+        args->conns[i] = args->conns[args->nfds];
+        __atomic_store_n(&args->queue->clientCount, args->queue->clientCount - 1, __ATOMIC_RELAXED);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                stopPoll
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Stop the shared acceptor.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void stopPoll(const int action)
+--                             const int action: CONTROL_STOP or CONTROL_DRAIN.
+--
+-- NOTES:
+-- Stops the acceptor and then the workers, see stopAcceptor. Stopping cancels the workers, draining
+-- leaves them to adopt what the acceptor queued last and finish their echoes.
+--------------------------------------------------------------------------------------------------*/
+void stopPoll(const int action)
+{
+    stopAcceptor(&acceptor, action);
+
+    if (action == CONTROL_STOP)
+    {
+        for (int i = 0; i < nWorkers; i++)
+        {
+            pthread_cancel(workers[i].thread);
+        }
+    }
+}
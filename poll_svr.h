@@ -0,0 +1,42 @@
+#ifndef POLL_SVR_H
+#define POLL_SVR_H
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "acceptor.h"
+#include "config.h"
+#include "handler.h"
+
+#define POLL_INITIAL_FDS 64
+
+// how long a draining worker waits for its clients to send before it lets them all go
+#define POLL_DRAIN_GRACE_MS 100
+
+struct poll_worker_arg
+{
+    pthread_t thread;
+    int cpu;
+    int bufferLength;
+    const struct protocol_handler *handler;
+    // where the acceptor hands the worker its connections
+    struct handoff_queue *queue;
+    int nfds;
+    int capacity;
+    struct pollfd *fds;
+    // the handler side of the client at the same index of fds
+    struct handler_conn *conns;
+};
+
+void runPoll(const int listenSocket, const struct server_config *config);
+
+void *pollWorker(void *args);
+
+void adoptPollConnections(struct poll_worker_arg *args);
+void addPollConnection(struct poll_worker_arg *args, const int newSocket);
+void handlePollData(struct poll_worker_arg *args, int num, char *buffer);
+
+void stopPoll(const int action);
+
+#endif // POLL_SVR_H
@@ -0,0 +1,259 @@
+# Reruns the data/graphs matrix on one host and compares the results of two runs.
+#
+#   python3 scripts/bench.py run [-o results.csv] [--modes select,epoll] [--connections 1000] ...
+#   python3 scripts/bench.py diff old.csv new.csv [--threshold 5]
+#
+# run starts server.out in every mode, drives it over loopback with loadgen.out for every number of
+# connections and messages, and writes one csv row per run: the throughput loadgen saw, the cpu time
+# and peak rss of the server, and the latency percentiles loadgen saw when it ran the same load open
+# loop at a fraction of that throughput. The latency is measured by the client from when a message
+# was meant to be sent until its echo was back, the same way for every mode, unlike the service
+# histogram of the server, which times something different in uring mode.
+#
+# diff lines up the rows of two result files and prints how every number moved. A run that got
+# slower, or used more cpu or memory, by more than the threshold is marked and makes diff exit 1.
+
+import argparse
+import csv
+import os
+import re
+import resource
+import shutil
+import signal
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SERVER = os.path.join(ROOT, 'server.out')
+LOADGEN = os.path.join(ROOT, 'loadgen.out')
+
+FIELDS = [
+    'mode', 'connections', 'messages', 'connected', 'failed', 'seconds', 'messages_per_s', 'bytes_per_s',
+    'cpu_s', 'rss_kb', 'latency_rate', 'latency_p50_us', 'latency_p99_us', 'latency_p999_us'
+]
+
+# which way is better for every number diff compares
+HIGHER_IS_BETTER = {'messages_per_s': True, 'bytes_per_s': True, 'cpu_s': False, 'rss_kb': False,
+                    'latency_p50_us': False, 'latency_p99_us': False, 'latency_p999_us': False}
+
+
+def raise_fd_limit():
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    resource.setrlimit(resource.RLIMIT_NOFILE, (hard, hard))
+
+
+def wait_for_port(port, process, timeout=10):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        if process.poll() is not None:
+            return False
+        try:
+            socket.create_connection(('127.0.0.1', port), timeout=1).close()
+            return True
+        except OSError:
+            time.sleep(0.1)
+    return False
+
+
+def server_usage(pid):
+    # utime and stime are fields 14 and 15 of stat, counted after the command name
+    with open('/proc/%d/stat' % pid) as stat_file:
+        fields = stat_file.read().rsplit(')', 1)[1].split()
+    cpu = (int(fields[11]) + int(fields[12])) / os.sysconf('SC_CLK_TCK')
+
+    rss = 0
+    with open('/proc/%d/status' % pid) as status_file:
+        for line in status_file:
+            if line.startswith('VmHWM:'):
+                rss = int(line.split()[1])
+    return cpu, rss
+
+
+def parse_loadgen(output):
+    row = {'connected': 0, 'failed': 0, 'seconds': 0, 'messages_per_s': 0, 'bytes_per_s': 0}
+
+    match = re.search(r'connections:\s+(\d+) connected, (\d+) failed', output)
+    if match:
+        row['connected'] = int(match.group(1))
+        row['failed'] = int(match.group(2))
+    match = re.search(r'messages:\s+\d+ in ([\d.]+)s \((\d+)/s\)', output)
+    if match:
+        row['seconds'] = float(match.group(1))
+        row['messages_per_s'] = int(match.group(2))
+    match = re.search(r'bytes:.*\((\d+)/s\)', output)
+    if match:
+        row['bytes_per_s'] = int(match.group(1))
+    return row
+
+
+def parse_latency(output):
+    row = {'latency_p50_us': 0, 'latency_p99_us': 0, 'latency_p999_us': 0}
+
+    match = re.search(r'latency:\s+p50 ([\d.]+)us, p99 ([\d.]+)us, p99.9 ([\d.]+)us', output)
+    if match:
+        row['latency_p50_us'] = float(match.group(1))
+        row['latency_p99_us'] = float(match.group(2))
+        row['latency_p999_us'] = float(match.group(3))
+    return row
+
+
+def run_loadgen(args, client_cmd, mode, connections, messages):
+    try:
+        client = subprocess.run(client_cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                                timeout=args.timeout, universal_newlines=True)
+        return client.stdout
+    except subprocess.TimeoutExpired:
+        print('%s %d x %d timed out' % (mode, connections, messages), file=sys.stderr)
+        return None
+
+
+def run_one(args, mode, connections, messages):
+    run_dir = tempfile.mkdtemp(prefix='bench-')
+    row = {'mode': mode, 'connections': connections, 'messages': messages, 'latency_rate': 0}
+    row.update(parse_latency(''))
+
+    # the binary log keeps the disk out of the way of the larger runs
+    server_cmd = [SERVER, '-m', mode, '-p', str(args.port), '-b', str(args.size), '-l', 'binary']
+    if args.workers:
+        server_cmd += ['-w', str(args.workers)]
+    client_cmd = [LOADGEN, '-p', str(args.port), '-c', str(connections), '-n', str(messages),
+                  '-s', str(args.size), '-t', str(args.threads)]
+
+    server = subprocess.Popen(server_cmd, cwd=run_dir, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL,
+                              preexec_fn=raise_fd_limit)
+    try:
+        if not wait_for_port(args.port, server):
+            print('%s did not start' % mode, file=sys.stderr)
+            row.update(parse_loadgen(''))
+            row['failed'] = connections
+        else:
+            output = run_loadgen(args, client_cmd, mode, connections, messages)
+            row.update(parse_loadgen(output or ''))
+            if output is None:
+                row['failed'] = connections
+
+        # taken before the latency run, so cpu and rss are those of the throughput run alone
+        if server.poll() is None:
+            row['cpu_s'], row['rss_kb'] = server_usage(server.pid)
+        else:
+            row['cpu_s'], row['rss_kb'] = 0, 0
+
+        # the same load again open loop, offered at a fraction of the throughput the mode reached
+        if args.load > 0 and row['messages_per_s'] > 0 and server.poll() is None:
+            row['latency_rate'] = max(1, int(row['messages_per_s'] * args.load))
+            output = run_loadgen(args, client_cmd + ['-r', str(row['latency_rate'])], mode, connections, messages)
+            row.update(parse_latency(output or ''))
+
+        if server.poll() is None:
+            server.send_signal(signal.SIGINT)
+        server.wait(timeout=30)
+    finally:
+        if server.poll() is None:
+            server.kill()
+            server.wait()
+
+    shutil.rmtree(run_dir, ignore_errors=True)
+    return row
+
+
+def run(args):
+    for binary in (SERVER, LOADGEN):
+        if not os.access(binary, os.X_OK):
+            sys.exit('%s is missing, run make first' % binary)
+
+    raise_fd_limit()
+
+    with open(args.output, 'w', newline='') as output_file:
+        writer = csv.DictWriter(output_file, fieldnames=FIELDS)
+        writer.writeheader()
+
+        for mode in args.modes.split(','):
+            for connections in [int(c) for c in args.connections.split(',')]:
+                for messages in [int(m) for m in args.messages.split(',')]:
+                    row = run_one(args, mode, connections, messages)
+                    writer.writerow(row)
+                    output_file.flush()
+                    print('%-6s %6d x %-5d %10d msg/s  p99 %8.1fus  cpu %7.2fs  rss %8dKB  failed %d' %
+                          (mode, connections, messages, row['messages_per_s'], row['latency_p99_us'],
+                           row['cpu_s'], row['rss_kb'], row['failed']))
+
+    print('results written to %s' % args.output)
+
+
+def read_results(path):
+    with open(path, newline='') as results_file:
+        return {(row['mode'], row['connections'], row['messages']): row for row in csv.DictReader(results_file)}
+
+
+def diff(args):
+    old = read_results(args.old)
+    new = read_results(args.new)
+    regressed = False
+
+    print('%-6s %6s %5s  %-16s %14s %14s %9s' % ('mode', 'conns', 'msgs', 'metric', 'old', 'new', 'change'))
+    for key in sorted(old, key=lambda k: (k[0], int(k[1]), int(k[2]))):
+        if key not in new:
+            print('%-6s %6s %5s  only in %s' % (key + (args.old,)))
+            continue
+
+        for metric, higher_is_better in HIGHER_IS_BETTER.items():
+            # files written before a column existed do not have it
+            if not old[key].get(metric) or not new[key].get(metric):
+                continue
+            before = float(old[key][metric])
+            after = float(new[key][metric])
+            change = (after - before) / before * 100 if before else 0
+            worse = change < -args.threshold if higher_is_better else change > args.threshold
+            regressed = regressed or worse
+
+            print('%-6s %6s %5s  %-16s %14.2f %14.2f %+8.1f%%%s' %
+                  (key + (metric, before, after, change, '  REGRESSED' if worse else '')))
+
+        if int(new[key]['failed']) > int(old[key]['failed']):
+            regressed = True
+            print('%-6s %6s %5s  %-16s %14s %14s  REGRESSED' % (key + ('failed', old[key]['failed'],
+                                                                      new[key]['failed'])))
+
+    for key in sorted(set(new) - set(old)):
+        print('%-6s %6s %5s  only in %s' % (key + (args.new,)))
+
+    sys.exit(1 if regressed else 0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark the server on one host.')
+    commands = parser.add_subparsers(dest='command')
+
+    run_parser = commands.add_parser('run', help='run the benchmark matrix')
+    run_parser.add_argument('-o', '--output', default='bench-results.csv')
+    run_parser.add_argument('--modes', default='select,poll,epoll,uring')
+    run_parser.add_argument('--connections', default='1000,10000,30000')
+    run_parser.add_argument('--messages', default='10,1000')
+    run_parser.add_argument('--size', type=int, default=100, help='bytes per message and -b of the server')
+    run_parser.add_argument('--workers', type=int, default=0, help='workers of the server, 0 for one per cpu')
+    run_parser.add_argument('--threads', type=int, default=4, help='threads of loadgen')
+    run_parser.add_argument('--port', type=int, default=8000)
+    run_parser.add_argument('--timeout', type=int, default=600, help='seconds a single run may take')
+    run_parser.add_argument('--load', type=float, default=0.5,
+                            help='fraction of the throughput reached to measure latency at, 0 to skip it')
+
+    diff_parser = commands.add_parser('diff', help='compare two result files')
+    diff_parser.add_argument('old')
+    diff_parser.add_argument('new')
+    diff_parser.add_argument('--threshold', type=float, default=5, help='percent a number may get worse')
+
+    args = parser.parse_args()
+    if args.command == 'run':
+        run(args)
+    elif args.command == 'diff':
+        diff(args)
+    else:
+        parser.print_help()
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
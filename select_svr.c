@@ -4,15 +4,19 @@
 -- PROGRAM:                server.out
 --
 -- FUNCTIONS:
---                         void runSelect(const int listenSocket, const int bufferLength)
+--                         void runSelect(const int listenSocket, const struct server_config *config)
 --                         void *selectWorker(void *args)
---                         void handleNewConnection(struct select_worker_arg *args)
+--                         void adoptConnections(struct select_worker_arg *args)
+--                         void handleNewConnection(struct select_worker_arg *args, const int newSocket)
 --                         void handleIncomingData(struct select_worker_arg *args, fd_set *set, int num, char *buffer)
---                         void selectSignalHandler(int sig)
+--                         void stopSelect(const int action)
 --
 -- DATE:                   Feb 19, 2019
 --
--- REVISIONS:              N/A
+-- REVISIONS:              Oct 17, 2026 - Give every worker its own fd set and hand connections out from
+--                                        an acceptor thread.
+--                         Oct 18, 2026 - Share the acceptor with poll mode.
+--                         Oct 18, 2026 - Read without blocking.
 --
 -- DESIGNERS:              Benny Wang, William Murpy
 --
@@ -20,6 +24,18 @@
 --
 -- NOTES:
 -- Contains all functions used for running the server in select mode.
+--
+-- Every worker owns a private fd set and client array that no other thread touches. The acceptor
+-- thread of acceptor.c blocks in accept and hands each new socket to the worker with the fewest
+-- clients through a small single producer, single consumer ring, then wakes the worker with its
+-- eventfd. Each worker only ever scans its own clients, so a scan costs the clients of one worker
+-- instead of all of them.
+--
+-- The sockets do not block. A ready client gets a single recv of whatever it has sent, so messages
+-- of any size and pipelined frames are answered as they arrive.
+--
+-- select can only watch descriptors below FD_SETSIZE, and descriptors are numbered per process, so
+-- sharding does not raise the number of clients past FD_SETSIZE. Sockets at or above it are refused.
 ---------------------------------------------------------------------------------------*/
 #define _REENTRANT
 #define DCE_COMPAT
@@ -28,76 +44,93 @@
 
 #include <errno.h>
 #include <pthread.h>
-#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/sysinfo.h>
 #include <unistd.h>
 
+#include "affinity.h"
+#include "control.h"
+#include "metrics.h"
+#include "stats.h"
 #include "tools.h"
 #include "net.h"
 
-pthread_t *workers;
+static struct select_worker_arg *workers;
+static int nWorkers;
+static struct acceptor acceptor;
 
 /*--------------------------------------------------------------------------------------------------
 -- FUNCTION:                runSelect
 --
 -- DATE:                    Feb 19, 2019
 --
--- REVISIONS:               N/A
+-- REVISIONS:               Oct 17, 2026 - One set of arguments per worker and an acceptor thread.
+--                          Oct 17, 2026 - The configured number of workers, each with its cpu.
+--                          Oct 17, 2026 - Wait for the server to be stopped or drained.
+--                          Oct 17, 2026 - Pass on the protocol handler.
+--                          Oct 18, 2026 - Use the shared acceptor.
 --
 -- DESIGNER:                Benny Wang
 --
 -- PROGRAMMER:              Benny Wang
 --
--- INTERFACE:               void runSelect(const int listenSocket, const int bufferLength)
+-- INTERFACE:               void runSelect(const int listenSocket, const struct server_config *config)
 --                              const int listenSocket: The listening socket.
---                              const int bufferLength: The size of the buffer.
+--                              const struct server_config *config: The server configuration.
 --
 -- NOTES:
--- The main entry point for select mode. Prepares the arguments for select and then spawns one worker
--- thread per cpu and waits for all workers to exit.
+-- The main entry point for select mode. Prepares an empty fd set holding only the eventfd of each
+-- worker, spawns the workers, each given the cpu it runs on, and the acceptor thread, waits to be
+-- stopped or drained and then for all of them to exit.
 --------------------------------------------------------------------------------------------------*/
-void runSelect(const int listenSocket, const int bufferLength)
+void runSelect(const int listenSocket, const struct server_config *config)
 {
-    struct select_worker_arg arg;
-    arg.listenSocket = listenSocket;
-
-    if (!setSocketToNonBlocking(arg.listenSocket))
-    {
-        systemFatal("setSocketToNonBlocking");
-    }
-
-    signal(SIGINT, selectSignalHandler);
-
-    if ((workers = calloc(get_nprocs(), sizeof(pthread_t))) == NULL)
+    nWorkers = config->workers;
+    if ((workers = calloc(nWorkers, sizeof(struct select_worker_arg))) == NULL)
     {
         systemFatal("calloc");
     }
 
-    // prepare arg
-    arg.bufferLength = bufferLength;
-    arg.bundle.maxfd = listenSocket;
-    arg.bundle.clientSize = -1;
-    for (int i = 0; i < FD_SETSIZE; i++)
+    createAcceptor(&acceptor, listenSocket, nWorkers, FD_SETSIZE);
+
+    // prepare args
+    for (int i = 0; i < nWorkers; i++)
     {
-        arg.bundle.clients[i] = -1;
+        struct select_worker_arg *arg = workers + i;
+
+        arg->cpu = config->workerCpus[i];
+        arg->bufferLength = config->bufferLength;
+        arg->handler = config->handler;
+        arg->queue = acceptor.queues + i;
+        arg->bundle.maxfd = arg->queue->wakeFd;
+        arg->bundle.clientSize = -1;
+        for (int j = 0; j < FD_SETSIZE; j++)
+        {
+            arg->bundle.clients[j] = -1;
+        }
+        FD_ZERO(&arg->bundle.set);
+        FD_SET(arg->queue->wakeFd, &arg->bundle.set);
     }
-    FD_ZERO(&arg.bundle.set);
-    FD_SET(listenSocket, &arg.bundle.set);
 
-    for (int i = 0; i < get_nprocs(); i++)
+    for (int i = 0; i < nWorkers; i++)
     {
-        if (pthread_create(workers + i, NULL, selectWorker, (void *)&arg))
+        if (pthread_create(&workers[i].thread, NULL, selectWorker, (void *)(workers + i)))
         {
             systemFatal("pthread_create");
         }
     }
 
-    for (int i = 0; i < get_nprocs(); i++)
+    startAcceptor(&acceptor);
+
+    stopSelect(awaitControl());
+
+    for (int i = 0; i < nWorkers; i++)
     {
-        pthread_join(workers[i], NULL);
+        pthread_join(workers[i].thread, NULL);
     }
+
+    destroyAcceptor(&acceptor);
+    free(workers);
 }
 
 /*--------------------------------------------------------------------------------------------------
@@ -105,50 +138,102 @@ void runSelect(const int listenSocket, const int bufferLength)
 --
 -- DATE:                    Feb 19, 2019
 --
--- REVISIONS:               N/A
+-- REVISIONS:               Oct 17, 2026 - Time each batch of ready sockets.
+--                          Oct 17, 2026 - Count into the shared memory stats.
+--                          Oct 17, 2026 - Select on a private set and adopt handed off connections.
+--                          Oct 17, 2026 - Pin to the cpu and allocate on its node.
+--                          Oct 17, 2026 - Close the clients and return when draining.
+--                          Oct 17, 2026 - Let the handler free the clients closed when draining.
 --
 -- DESIGNER:                Benny Wang
 --
 -- PROGRAMMER:              Benny Wang
 --
 -- INTERFACE:               void *selectWorker(void *args)
---                              void *args: A select_workera_arg struct.
+--                              void *args: A select_worker_arg struct.
 --
 -- RETURNS:                 NULL - unused.
 --
 -- NOTES:
--- The main function of each worker thread for select. Allocates a buffer for storing data and then
--- goes into a forever loop that blocks on select and then handles requests accordingly.
+-- The main function of each worker thread for select. Pins itself to its cpu so that its memory is
+-- on the node of that cpu, allocates a buffer for storing data and then goes into a forever loop
+-- that blocks on select and then handles requests accordingly. The time spent handling each batch
+-- of ready sockets is recorded in the worker's metrics. A worker told to drain keeps echoing, closing
+-- every client it echoed, until none of its clients sent anything for SELECT_DRAIN_GRACE_MS, then
+-- closes the rest and returns.
 --------------------------------------------------------------------------------------------------*/
 void *selectWorker(void *args)
 {
     int numSelected;
     char *buffer;
     fd_set readSet;
+    bool draining = false;
 
     struct select_worker_arg *argPtr = (struct select_worker_arg *)args;
 
+    // before anything is allocated so that it all lands on the node of the cpu
+    if (!pinWorker(argPtr->cpu))
+    {
+        fprintf(stderr, "pinWorker: could not pin worker to cpu %d\n", argPtr->cpu);
+    }
+
     if ((buffer = calloc(sizeof(char), argPtr->bufferLength)) == NULL)
     {
         systemFatal("calloc");
     }
 
+    // claim a stats slot up front so that idle workers show up too
+    createLocalStats();
+
     while (true)
     {
-        readSet = argPtr->bundle.set;
-        numSelected = select(argPtr->bundle.maxfd + 1, &readSet, NULL, NULL, NULL);
+        uint64_t loopStart;
+        struct timeval grace = { 0, SELECT_DRAIN_GRACE_MS * 1000 };
 
-        if (FD_ISSET(argPtr->listenSocket, &readSet))
+        readSet = argPtr->bundle.set;
+        if ((numSelected = select(argPtr->bundle.maxfd + 1, &readSet, NULL, NULL, draining ? &grace : NULL)) == -1)
         {
-            handleNewConnection(argPtr);
-
-            if (--numSelected <= 0)
+            if (errno == EINTR)
             {
                 continue;
             }
+            systemFatal("select");
+        }
+
+        // drained, nobody is in the middle of anything
+        if (numSelected == 0)
+        {
+            break;
         }
+        loopStart = metricsNow();
 
-        handleIncomingData(argPtr, &readSet, numSelected, buffer);
+        if (FD_ISSET(argPtr->queue->wakeFd, &readSet))
+        {
+            adoptConnections(argPtr);
+            --numSelected;
+        }
+
+        if (numSelected > 0)
+        {
+            handleIncomingData(argPtr, &readSet, numSelected, buffer);
+        }
+
+        metricsRecord(METRIC_LOOP, metricsNow() - loopStart);
+        statsAdd(STAT_LOOPS, 1);
+
+        draining = __atomic_load_n(&argPtr->queue->draining, __ATOMIC_ACQUIRE);
+    }
+
+    // the acceptor is gone, take what it queued last and let every client go
+    adoptConnections(argPtr);
+    for (int i = 0; i <= argPtr->bundle.clientSize; i++)
+    {
+        if (argPtr->bundle.clients[i] >= 0)
+        {
+            handlerClose(argPtr->bundle.conns + argPtr->bundle.clients[i]);
+            statsAdd(STAT_CLOSES, 1);
+            close(argPtr->bundle.clients[i]);
+        }
     }
 
     free(buffer);
@@ -156,33 +241,76 @@ void *selectWorker(void *args)
     return NULL;
 }
 
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                adoptConnections
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Take the sockets from the shared handoff queue.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void adoptConnections(struct select_worker_arg *args)
+--                              struct select_worker_arg *args: The worker arguments.
+--
+-- NOTES:
+-- Clears the eventfd of the worker and adds every socket the acceptor has queued for it. The eventfd
+-- is cleared first so that a socket queued while this runs wakes the worker again.
+--------------------------------------------------------------------------------------------------*/
+void adoptConnections(struct select_worker_arg *args)
+{
+    int sock;
+
+    clearHandoffWake(args->queue);
+    while (takeHandedOffSocket(args->queue, &sock))
+    {
+        handleNewConnection(args, sock);
+    }
+}
+
 /*--------------------------------------------------------------------------------------------------
 -- FUNCTION:                handleNewConnection
 --
 -- DATE:                    Feb 19, 2019
 --
--- REVISIONS:               N/A
+-- REVISIONS:               Oct 17, 2026 - Time the accept.
+--                          Oct 17, 2026 - Count into the shared memory stats.
+--                          Oct 17, 2026 - Take a socket accepted by the acceptor instead of accepting.
+--                          Oct 17, 2026 - Start the protocol handler of the connection.
 --
 -- DESIGNER:                Benny Wang
 --
 -- PROGRAMMER:              Benny Wang
 --
--- INTERFACE:               void handleNewConnection(struct select_worker_arg *args)
+-- INTERFACE:               void handleNewConnection(struct select_worker_arg *args, const int newSocket)
 --                              struct select_worker_arg *args: The worker arguments.
+--                              const int newSocket: The accepted socket.
 --
 -- NOTES:
--- Accepts a new connection and set the associated select parameters.
+-- Adds a new connection to the worker and sets the associated select parameters. The acceptor only
+-- hands off sockets below FD_SETSIZE, so there is always a free slot for it. The handler of the
+-- worker is started on the connection first, and a connection it refuses is closed instead.
 --------------------------------------------------------------------------------------------------*/
-void handleNewConnection(struct select_worker_arg *args)
+void handleNewConnection(struct select_worker_arg *args, const int newSocket)
 {
     int i = 0;
-    int newSocket = -1;
-    struct sockaddr_in newClient;
 
     struct select_worker_arg *argPtr = (struct select_worker_arg *)args;
+    struct handler_conn *conn = argPtr->bundle.conns + newSocket;
 
-    if (!acceptNewConnection(argPtr->listenSocket, &newSocket, &newClient))
+    statsAdd(STAT_ACCEPTS, 1);
+
+    conn->fd = newSocket;
+    conn->handler = argPtr->handler;
+    conn->write = writeBlocking;
+    conn->read = NULL;
+    if (!handlerAccept(conn))
     {
+        handlerClose(conn);
+        statsAdd(STAT_CLOSES, 1);
+        close(newSocket);
         return;
     }
 
@@ -190,24 +318,11 @@ void handleNewConnection(struct select_worker_arg *args)
     {
         if (argPtr->bundle.clients[i] < 0)
         {
-            if (!setSocketTimeout(10, 0, newSocket))
-            {
-                perror("setSocketTimeout");
-                close(newSocket);
-                return;
-            }
             argPtr->bundle.clients[i] = newSocket;
             break;
         }
     }
 
-    if (i == FD_SETSIZE)
-    {
-        fprintf(stderr, "Too many clients, cannot accept\n");
-        close(newSocket);
-        return;
-    }
-
     FD_SET(newSocket, &argPtr->bundle.set);
     if (newSocket > argPtr->bundle.maxfd)
     {
@@ -217,6 +332,8 @@ void handleNewConnection(struct select_worker_arg *args)
     {
         argPtr->bundle.clientSize = i;
     }
+
+    __atomic_store_n(&argPtr->queue->clientCount, argPtr->queue->clientCount + 1, __ATOMIC_RELAXED);
 }
 
 /*--------------------------------------------------------------------------------------------------
@@ -224,7 +341,12 @@ void handleNewConnection(struct select_worker_arg *args)
 --
 -- DATE:                    Feb 19, 2019
 --
--- REVISIONS:               N/A
+-- REVISIONS:               Oct 17, 2026 - Time each echo.
+--                          Oct 17, 2026 - Count into the shared memory stats.
+--                          Oct 17, 2026 - Only count down num for sockets that were set.
+--                          Oct 17, 2026 - Close echoed clients when draining.
+--                          Oct 17, 2026 - Hand what was read to the protocol handler.
+--                          Oct 18, 2026 - One recv of whatever a ready client sent.
 --
 -- DESIGNER:                Benny Wang
 --
@@ -237,7 +359,11 @@ void handleNewConnection(struct select_worker_arg *args)
 --                              char *buffer: The buffer to store the data.
 --
 -- NOTES:
--- Handles all the data sockets that were flagged by the select call.
+-- Handles all the data sockets that were flagged by the select call. Reads whatever one recv of up
+-- to the buffer size returns from each and hands it to the handler, which answers it before the next
+-- socket is looked at. A socket that turns out to have nothing to read is left open.
+-- The time taken to answer each socket is recorded in the worker's metrics. While the worker drains
+-- every client is closed once it has its answer.
 --------------------------------------------------------------------------------------------------*/
 void handleIncomingData(struct select_worker_arg *args, fd_set *set, int num, char *buffer)
 {
@@ -247,19 +373,33 @@ void handleIncomingData(struct select_worker_arg *args, fd_set *set, int num, ch
 
     for (int i = 0; i <= argPtr->bundle.clientSize; i++)
     {
-        if ((sock = argPtr->bundle.clients[i]) < 0)
+        uint64_t start;
+        int n;
+        bool echoed = false;
+
+        if ((sock = argPtr->bundle.clients[i]) < 0 || !FD_ISSET(sock, set))
         {
             continue;
         }
 
-        if (FD_ISSET(sock, set))
+        start = metricsNow();
+
+        if ((n = readFromSocket(sock, buffer, argPtr->bufferLength)) > 0
+            && (echoed = handlerData(argPtr->bundle.conns + sock, buffer, n)))
         {
-            if (clearSocket(sock, buffer, argPtr->bufferLength) <= 0)
-            {
-                FD_CLR(sock, &argPtr->bundle.set);
-                argPtr->bundle.clients[i] = -1;
-                close(sock);
-            }
+            metricsRecord(METRIC_SERVICE, metricsNow() - start);
+        }
+
+        // a draining worker lets a client go once it has its echo, woken for nothing it is still there
+        if ((!echoed && !(n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)))
+            || (echoed && __atomic_load_n(&argPtr->queue->draining, __ATOMIC_RELAXED)))
+        {
+            handlerClose(argPtr->bundle.conns + sock);
+            FD_CLR(sock, &argPtr->bundle.set);
+            argPtr->bundle.clients[i] = -1;
+            __atomic_store_n(&argPtr->queue->clientCount, argPtr->queue->clientCount - 1, __ATOMIC_RELAXED);
+            statsAdd(STAT_CLOSES, 1);
+            close(sock);
         }
 
         if (--num <= 0)
@@ -270,27 +410,32 @@ void handleIncomingData(struct select_worker_arg *args, fd_set *set, int num, ch
 }
 
 /*--------------------------------------------------------------------------------------------------
--- FUNCTION:                selectSignalHandler
+-- FUNCTION:                stopSelect
 --
--- DATE:                    Feb 19, 2019
+-- DATE:                    Oct 17, 2026
 --
--- REVISIONS:               N/A
+-- REVISIONS:               Oct 18, 2026 - Stop the shared acceptor.
 --
 -- DESIGNER:                Benny Wang
 --
 -- PROGRAMMER:              Benny Wang
 --
--- INTERFACE:               void selectSignalHandler(int sig)
---                             int sig: The signal that was caught.
+-- INTERFACE:               void stopSelect(const int action)
+--                             const int action: CONTROL_STOP or CONTROL_DRAIN.
 --
 -- NOTES:
--- Callback function to catch SIGINT. Kills all the worker threads.
+-- Stops the acceptor and then the workers, see stopAcceptor. Stopping cancels the workers, draining
+-- leaves them to adopt what the acceptor queued last and finish their echoes.
 --------------------------------------------------------------------------------------------------*/
-void selectSignalHandler(int sig)
+void stopSelect(const int action)
 {
-    fprintf(stdout, "Stopping server\n");
-    for (int i = 0; i < get_nprocs(); i++)
+    stopAcceptor(&acceptor, action);
+
+    if (action == CONTROL_STOP)
     {
-        pthread_cancel(workers[i]);
+        for (int i = 0; i < nWorkers; i++)
+        {
+            pthread_cancel(workers[i].thread);
+        }
     }
 }
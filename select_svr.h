@@ -1,30 +1,46 @@
 #ifndef SELECT_SVR_H
 #define SELECT_SVR_H
 
+#include <pthread.h>
+#include <stdbool.h>
 #include <sys/select.h>
 
+#include "acceptor.h"
+#include "config.h"
+#include "handler.h"
+
+// how long a draining worker waits for its clients to send before it lets them all go
+#define SELECT_DRAIN_GRACE_MS 100
+
 struct select_bundle
 {
     int maxfd;
     int clientSize;
     int clients[FD_SETSIZE];
+    // the handler side of every client, indexed by fd
+    struct handler_conn conns[FD_SETSIZE];
     fd_set set;
 };
 
 struct select_worker_arg
 {
-    int listenSocket;
+    pthread_t thread;
+    int cpu;
     int bufferLength;
+    const struct protocol_handler *handler;
+    // where the acceptor hands the worker its connections
+    struct handoff_queue *queue;
     struct select_bundle bundle;
 };
 
-void runSelect(const int listenSocket, const int bufferLength);
+void runSelect(const int listenSocket, const struct server_config *config);
 
 void *selectWorker(void *args);
 
-void handleNewConnection(struct select_worker_arg *args);
+void adoptConnections(struct select_worker_arg *args);
+void handleNewConnection(struct select_worker_arg *args, const int newSocket);
 void handleIncomingData(struct select_worker_arg *args, fd_set *set, int num, char *buffer);
 
-void selectSignalHandler(int sig);
+void stopSelect(const int action);
 
 #endif // SELECT_SVR_H
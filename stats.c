@@ -0,0 +1,224 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            stats.c
+--
+-- PROGRAM:                server.out
+--
+-- FUNCTIONS:
+--                         bool startStats(const int mode, const int port)
+--                         void stopStats()
+--                         void statsAdd(const int counter, const uint64_t amount)
+--                         struct worker_stats *createLocalStats()
+--
+-- DATE:                   Oct 17, 2026
+--
+-- REVISIONS:              N/A
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- Live counters published in POSIX shared memory.
+--
+-- The server creates one stats_page named after its port. Every thread that counts something claims
+-- the next worker slot of the page the first time it does, and from then on only ever adds to its own
+-- slot with plain stores, so counting takes no lock, no atomic read-modify-write and no syscall.
+-- svrstat.out maps the page read only and turns the counters into rates. The page starts with a magic,
+-- a version and the sizes of its parts so that a reader built against another layout refuses it.
+---------------------------------------------------------------------------------------*/
+#include "stats.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static struct stats_page *page = NULL;
+static char pageName[64];
+// which object the name pointed to when this server created it
+static dev_t pageDevice;
+static ino_t pageInode;
+static __thread struct worker_stats *localStats = NULL;
+
+// counts of threads beyond STATS_MAX_WORKERS go here and are not published
+static struct worker_stats overflowStats;
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                startStats
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Replace the name instead of truncating the page behind it.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool startStats(const int mode, const int port)
+--                              const int mode: The mode the server runs in.
+--                              const int port: The port the server listens on.
+--
+-- RETURNS:                 True if the page was created, false otherwise.
+--
+-- NOTES:
+-- Creates the shared memory page of the server, replacing one left behind by a server on the same
+-- port that did not stop cleanly, and fills in its header. The old page is unlinked rather than
+-- truncated, since the server it belongs to may still be draining after an upgrade and writing to
+-- it. svrstat picks up the new page the next time it starts.
+--------------------------------------------------------------------------------------------------*/
+bool startStats(const int mode, const int port)
+{
+    int fd;
+    struct stat info;
+
+    snprintf(pageName, sizeof(pageName), STATS_NAME_FORMAT, port);
+
+    shm_unlink(pageName);
+    if ((fd = shm_open(pageName, O_CREAT | O_EXCL | O_RDWR, 0644)) == -1)
+    {
+        return false;
+    }
+
+    if (fstat(fd, &info) == -1)
+    {
+        close(fd);
+        shm_unlink(pageName);
+        return false;
+    }
+    pageDevice = info.st_dev;
+    pageInode = info.st_ino;
+
+    if (ftruncate(fd, sizeof(struct stats_page)) == -1)
+    {
+        close(fd);
+        shm_unlink(pageName);
+        return false;
+    }
+
+    page = mmap(NULL, sizeof(struct stats_page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED)
+    {
+        page = NULL;
+        shm_unlink(pageName);
+        return false;
+    }
+
+    memcpy(page->magic, STATS_MAGIC, sizeof(page->magic));
+    page->version = STATS_VERSION;
+    page->counterCount = STAT_COUNT;
+    page->workerSize = sizeof(struct worker_stats);
+    page->maxWorkers = STATS_MAX_WORKERS;
+    page->workers = 0;
+    page->pid = getpid();
+    page->mode = mode;
+    page->port = port;
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                stopStats
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Only remove the page this server created.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void stopStats()
+--
+-- NOTES:
+-- Unmaps and removes the page. Must be called once the workers have stopped. A server that handed
+-- its listeners over leaves the name alone once the new server has put its own page there.
+--------------------------------------------------------------------------------------------------*/
+void stopStats()
+{
+    int fd;
+    struct stat info;
+
+    if (page == NULL)
+    {
+        return;
+    }
+
+    munmap(page, sizeof(struct stats_page));
+    page = NULL;
+
+    if ((fd = shm_open(pageName, O_RDONLY, 0)) == -1)
+    {
+        return;
+    }
+
+    if (fstat(fd, &info) == 0 && info.st_dev == pageDevice && info.st_ino == pageInode)
+    {
+        shm_unlink(pageName);
+    }
+    close(fd);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                statsAdd
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void statsAdd(const int counter, const uint64_t amount)
+--                              const int counter: One of the STAT values.
+--                              const uint64_t amount: How much to add.
+--
+-- NOTES:
+-- Adds amount to a counter of the calling thread. The store is atomic so that a reader never sees a
+-- torn value, but since only this thread writes the slot it needs no read-modify-write.
+--------------------------------------------------------------------------------------------------*/
+void statsAdd(const int counter, const uint64_t amount)
+{
+    struct worker_stats *stats = localStats != NULL ? localStats : createLocalStats();
+    uint64_t *value = &stats->counters[counter];
+
+    __atomic_store_n(value, *value + amount, __ATOMIC_RELAXED);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                createLocalStats
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               struct worker_stats *createLocalStats()
+--
+-- RETURNS:                 The counters of the calling thread.
+--
+-- NOTES:
+-- Claims the next worker slot of the page for the calling thread. Only runs the first time a thread
+-- counts. Threads that find no page or no free slot count into a slot that is never published.
+--------------------------------------------------------------------------------------------------*/
+struct worker_stats *createLocalStats()
+{
+    uint32_t slot;
+
+    if (page == NULL || (slot = __atomic_fetch_add(&page->workers, 1, __ATOMIC_RELAXED)) >= STATS_MAX_WORKERS)
+    {
+        localStats = &overflowStats;
+    }
+    else
+    {
+        localStats = &page->worker[slot];
+    }
+
+    return localStats;
+}
@@ -0,0 +1,57 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// the shared memory segment is named after the port so that svrstat can find it
+#define STATS_NAME_FORMAT "/scalable-server.%d"
+#define STATS_MAGIC "SVRSTAT"
+#define STATS_VERSION 5
+#define STATS_MAX_WORKERS 256
+
+// the counters of each worker, messages are the recv and send calls that moved data, accept
+// batches the runs of accepts a worker made on one wake up of its listener and timeouts the
+// connections closed for going quiet
+#define STAT_ACCEPTS 0
+#define STAT_CLOSES 1
+#define STAT_BYTES_IN 2
+#define STAT_BYTES_OUT 3
+#define STAT_MESSAGES_IN 4
+#define STAT_MESSAGES_OUT 5
+#define STAT_EAGAINS 6
+#define STAT_ERRORS 7
+#define STAT_LOOPS 8
+#define STAT_ZEROCOPY_SENDS 9
+#define STAT_ZEROCOPY_COPIED 10
+#define STAT_ACCEPT_BATCHES 11
+#define STAT_TIMEOUTS 12
+#define STAT_COUNT 13
+
+struct worker_stats
+{
+    // written by the owning worker only, padded to a page so that the worker's own first store places
+    // it on the numa node of the worker and no two workers share a cache line
+    _Alignas(4096) uint64_t counters[STAT_COUNT];
+};
+
+struct stats_page
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t counterCount;
+    uint32_t workerSize;
+    uint32_t maxWorkers;
+    uint32_t workers;
+    int32_t pid;
+    int32_t mode;
+    int32_t port;
+    struct worker_stats worker[STATS_MAX_WORKERS];
+};
+
+bool startStats(const int mode, const int port);
+void stopStats();
+void statsAdd(const int counter, const uint64_t amount);
+struct worker_stats *createLocalStats();
+
+#endif // STATS_H
@@ -0,0 +1,345 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            svrstat.c
+--
+-- PROGRAM:                svrstat.out
+--
+-- FUNCTIONS:
+--                         int main(int argc, char *argv[])
+--                         const struct stats_page *openStatsPage(const int port)
+--                         void takeSnapshot(const struct stats_page *page, uint64_t *snapshot, const int workers)
+--                         void printHeader()
+--                         void printRow(const char *name, const uint64_t *now, const uint64_t *before, const double seconds)
+--
+-- DATE:                   Oct 17, 2026
+--
+-- REVISIONS:              N/A
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- Prints the live counters of a running server, in the spirit of vmstat.
+--
+-- Usage: svrstat.out -p port [-a] [interval [count]]
+--     -p - The port of the server to watch.
+--     -a - Only print the line for all workers together.
+--     interval - Seconds between reports. Default 1.
+--     count - The number of reports. Default until the server stops.
+--
+-- The stats page of the server is mapped read only, so watching a server costs it nothing. Every
+-- report has one line per worker and one for all workers with the rates over the last interval and
+-- the number of connections open right now.
+---------------------------------------------------------------------------------------*/
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stats.h"
+#include "tools.h"
+
+const struct stats_page *openStatsPage(const int port);
+void takeSnapshot(const struct stats_page *page, uint64_t *snapshot, const int workers);
+void printHeader();
+void printRow(const char *name, const uint64_t *now, const uint64_t *before, const double seconds);
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                main
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int main(int argc, char *argv[])
+--                              int argc: The number of command line arguments.
+--                              char *argv[]: The command line arguments.
+--
+-- RETURNS:                 The exit code of the program.
+--
+-- NOTES:
+-- The main entry point of the program. Takes a snapshot of every counter each interval and prints
+-- the difference to the last one. Workers that show up after the first report start from zero.
+--------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+    int c;
+    int port = 0;
+    int allOnly = 0;
+    int interval = 1;
+    int count = -1;
+    int lines = 0;
+    const struct stats_page *page;
+    uint64_t *before;
+    uint64_t *now;
+    struct timespec last;
+
+    while ((c = getopt(argc, argv, "p:a")) != -1)
+    {
+        switch (c)
+        {
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 'a':
+            allOnly = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s -p port [-a] [interval [count]]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind < argc)
+    {
+        interval = atoi(argv[optind++]);
+    }
+    if (optind < argc)
+    {
+        count = atoi(argv[optind++]);
+    }
+
+    if (!port || interval < 1)
+    {
+        fprintf(stderr, "Usage: %s -p port [-a] [interval [count]]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    page = openStatsPage(port);
+
+    // one row per worker plus a last row for the sum
+    if ((before = calloc((STATS_MAX_WORKERS + 1) * STAT_COUNT, sizeof(uint64_t))) == NULL
+        || (now = calloc((STATS_MAX_WORKERS + 1) * STAT_COUNT, sizeof(uint64_t))) == NULL)
+    {
+        systemFatal("calloc");
+    }
+
+    takeSnapshot(page, before, STATS_MAX_WORKERS);
+    clock_gettime(CLOCK_MONOTONIC, &last);
+
+    while (count != 0)
+    {
+        struct timespec current;
+        double seconds;
+        int workers;
+        uint64_t *swap;
+
+        sleep(interval);
+
+        // the page outlives a server that was killed, so check that it is still there
+        if (kill(page->pid, 0) == -1 && errno == ESRCH)
+        {
+            fprintf(stderr, "server %d stopped\n", page->pid);
+            break;
+        }
+
+        workers = __atomic_load_n(&page->workers, __ATOMIC_RELAXED);
+        if (workers > STATS_MAX_WORKERS)
+        {
+            workers = STATS_MAX_WORKERS;
+        }
+
+        takeSnapshot(page, now, workers);
+        clock_gettime(CLOCK_MONOTONIC, &current);
+        seconds = (current.tv_sec - last.tv_sec) + (current.tv_nsec - last.tv_nsec) / 1e9;
+        last = current;
+
+        if (!allOnly || lines % 20 == 0)
+        {
+            printHeader();
+        }
+
+        if (!allOnly)
+        {
+            for (int w = 0; w < workers; w++)
+            {
+                char name[16];
+
+                snprintf(name, sizeof(name), "%d", w);
+                printRow(name, now + w * STAT_COUNT, before + w * STAT_COUNT, seconds);
+            }
+        }
+        printRow("all", now + STATS_MAX_WORKERS * STAT_COUNT, before + STATS_MAX_WORKERS * STAT_COUNT, seconds);
+        fflush(stdout);
+
+        swap = before;
+        before = now;
+        now = swap;
+        lines++;
+        if (count > 0)
+        {
+            count--;
+        }
+    }
+
+    free(before);
+    free(now);
+    munmap((void *)page, sizeof(struct stats_page));
+
+    return 0;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                openStatsPage
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               const struct stats_page *openStatsPage(const int port)
+--                              const int port: The port of the server.
+--
+-- RETURNS:                 The mapped page. Exits if there is none or it has another layout.
+--
+-- NOTES:
+-- Maps the stats page of the server on port read only and checks that its layout is the one this
+-- program was built with.
+--------------------------------------------------------------------------------------------------*/
+const struct stats_page *openStatsPage(const int port)
+{
+    char name[64];
+    int fd;
+    const struct stats_page *page;
+
+    snprintf(name, sizeof(name), STATS_NAME_FORMAT, port);
+
+    if ((fd = shm_open(name, O_RDONLY, 0)) == -1)
+    {
+        fprintf(stderr, "No server is running on port %d\n", port);
+        exit(EXIT_FAILURE);
+    }
+
+    page = mmap(NULL, sizeof(struct stats_page), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED)
+    {
+        systemFatal("mmap");
+    }
+
+    if (memcmp(page->magic, STATS_MAGIC, sizeof(page->magic)) || page->version != STATS_VERSION
+        || page->counterCount != STAT_COUNT || page->workerSize != sizeof(struct worker_stats)
+        || page->maxWorkers != STATS_MAX_WORKERS)
+    {
+        fprintf(stderr, "The stats of the server on port %d are not of version %d\n", port, STATS_VERSION);
+        exit(EXIT_FAILURE);
+    }
+
+    return page;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                takeSnapshot
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void takeSnapshot(const struct stats_page *page, uint64_t *snapshot,
+--                                            const int workers)
+--                              const struct stats_page *page: The stats page.
+--                              uint64_t *snapshot: Where to copy the counters to.
+--                              const int workers: The number of worker slots to copy.
+--
+-- NOTES:
+-- Copies the counters of the first workers slots into snapshot, one row of STAT_COUNT per worker, and
+-- their sums into the row after the last slot.
+--------------------------------------------------------------------------------------------------*/
+void takeSnapshot(const struct stats_page *page, uint64_t *snapshot, const int workers)
+{
+    uint64_t *total = snapshot + STATS_MAX_WORKERS * STAT_COUNT;
+
+    memset(total, 0, STAT_COUNT * sizeof(uint64_t));
+
+    for (int w = 0; w < workers; w++)
+    {
+        for (int i = 0; i < STAT_COUNT; i++)
+        {
+            snapshot[w * STAT_COUNT + i] = __atomic_load_n(&page->worker[w].counters[i], __ATOMIC_RELAXED);
+            total[i] += snapshot[w * STAT_COUNT + i];
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                printHeader
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Zero copy columns.
+--                          Oct 17, 2026 - Accepts per batch column.
+--                          Oct 17, 2026 - Timeouts column.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void printHeader()
+--
+-- NOTES:
+-- Prints the column names.
+--------------------------------------------------------------------------------------------------*/
+void printHeader()
+{
+    printf("%6s %8s %7s %8s %9s %9s %10s %10s %9s %7s %7s %9s %8s %8s\n", "worker", "acc/s", "acc/bat", "open",
+           "msgin/s", "msgout/s", "kBin/s", "kBout/s", "eagain/s", "err/s", "tmo/s", "loops/s", "zc/s", "zccp/s");
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                printRow
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Zero copy columns.
+--                          Oct 17, 2026 - Accepts per batch column.
+--                          Oct 17, 2026 - Timeouts column.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void printRow(const char *name, const uint64_t *now, const uint64_t *before,
+--                                        const double seconds)
+--                              const char *name: The name of the row.
+--                              const uint64_t *now: The counters now.
+--                              const uint64_t *before: The counters one interval ago.
+--                              const double seconds: The length of the interval.
+--
+-- NOTES:
+-- Prints one line of rates. Open connections are the accepts minus the closes so far. Zero copy sends
+-- the kernel copied anyway are counted when their completion is read. Accepts per batch is how many
+-- connections epoll workers took per wake up of their listener, the cap means they had a backlog.
+--------------------------------------------------------------------------------------------------*/
+void printRow(const char *name, const uint64_t *now, const uint64_t *before, const double seconds)
+{
+    double rate[STAT_COUNT];
+    uint64_t batches = now[STAT_ACCEPT_BATCHES] - before[STAT_ACCEPT_BATCHES];
+
+    for (int i = 0; i < STAT_COUNT; i++)
+    {
+        rate[i] = (now[i] - before[i]) / seconds;
+    }
+
+    printf("%6s %8.0f %7.1f %8ld %9.0f %9.0f %10.1f %10.1f %9.0f %7.0f %7.0f %9.0f %8.0f %8.0f\n", name,
+           rate[STAT_ACCEPTS], batches ? (double)(now[STAT_ACCEPTS] - before[STAT_ACCEPTS]) / batches : 0.0,
+           (long)(now[STAT_ACCEPTS] - now[STAT_CLOSES]), rate[STAT_MESSAGES_IN], rate[STAT_MESSAGES_OUT],
+           rate[STAT_BYTES_IN] / 1024, rate[STAT_BYTES_OUT] / 1024, rate[STAT_EAGAINS], rate[STAT_ERRORS],
+           rate[STAT_TIMEOUTS], rate[STAT_LOOPS], rate[STAT_ZEROCOPY_SENDS], rate[STAT_ZEROCOPY_COPIED]);
+}
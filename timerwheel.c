@@ -0,0 +1,330 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            timerwheel.c
+--
+-- PROGRAM:                server.out
+--
+-- FUNCTIONS:
+--                         struct timer_wheel *createTimerWheel()
+--                         void destroyTimerWheel(struct timer_wheel *wheel)
+--                         uint64_t wheelTicks(const int seconds)
+--                         void wheelSchedule(struct timer_wheel *wheel, struct wheel_timer *timer, const uint64_t ticks)
+--                         void wheelCancel(struct wheel_timer *timer)
+--                         bool wheelArmed(const struct wheel_timer *timer)
+--                         int wheelAdvance(struct timer_wheel *wheel, void (*expire)(struct wheel_timer *timer, void *arg),
+--                                          void *arg)
+--                         void wheelLink(struct timer_wheel *wheel, struct wheel_timer *timer, const uint64_t tick)
+--
+-- DATE:                   Oct 17, 2026
+--
+-- REVISIONS:              N/A
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- A hashed timing wheel of one worker, driven by a timerfd in the epoll set of the worker.
+--
+-- The wheel has WHEEL_SLOTS slots of WHEEL_TICK_MS each, and a timer is linked into the slot of the
+-- tick it fires at. Every tick of the timerfd visits the next slot. Scheduling and cancelling are an
+-- intrusive list insert and unlink, and a tick only looks at the timers of one slot. A timer more than
+-- a turn of the wheel out is visited early and simply linked back in, which cascades it the way the
+-- levels of a hierarchical wheel would without a second wheel.
+--
+-- Pushing a deadline back is the common case, every time a connection moves data, so it only stores
+-- the new deadline. The timer stays in the slot it is in and moves on when that slot is visited. Only
+-- a deadline brought forward has to move the timer. Timers embed in what they time and carry no
+-- pointer to their wheel, so a connection can cancel its timer when it is destroyed.
+---------------------------------------------------------------------------------------*/
+#include "timerwheel.h"
+
+#include <stdlib.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                createTimerWheel
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               struct timer_wheel *createTimerWheel()
+--
+-- RETURNS:                 The wheel, NULL if it or its timerfd could not be created.
+--
+-- NOTES:
+-- Creates an empty wheel and starts its non-blocking timerfd ticking every WHEEL_TICK_MS. The caller
+-- adds wheel->timerFd to its epoll set and calls wheelAdvance whenever it is readable.
+--------------------------------------------------------------------------------------------------*/
+struct timer_wheel *createTimerWheel()
+{
+    struct timer_wheel *wheel;
+    struct itimerspec tick;
+
+    if ((wheel = malloc(sizeof(struct timer_wheel))) == NULL)
+    {
+        return NULL;
+    }
+
+    wheel->now = 0;
+    for (int i = 0; i < WHEEL_SLOTS; i++)
+    {
+        wheel->slots[i].next = &wheel->slots[i];
+        wheel->slots[i].prev = &wheel->slots[i];
+    }
+
+    if ((wheel->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) == -1)
+    {
+        free(wheel);
+        return NULL;
+    }
+
+    tick.it_interval.tv_sec = WHEEL_TICK_MS / 1000;
+    tick.it_interval.tv_nsec = (WHEEL_TICK_MS % 1000) * 1000000;
+    tick.it_value = tick.it_interval;
+    if (timerfd_settime(wheel->timerFd, 0, &tick, NULL) == -1)
+    {
+        close(wheel->timerFd);
+        free(wheel);
+        return NULL;
+    }
+
+    return wheel;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                destroyTimerWheel
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void destroyTimerWheel(struct timer_wheel *wheel)
+--                              struct timer_wheel *wheel: The wheel to destroy.
+--
+-- NOTES:
+-- Closes the timerfd and frees the wheel. Timers still linked into it are left dangling, so every
+-- timer must have been cancelled or never be used again.
+--------------------------------------------------------------------------------------------------*/
+void destroyTimerWheel(struct timer_wheel *wheel)
+{
+    close(wheel->timerFd);
+    free(wheel);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                wheelTicks
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               uint64_t wheelTicks(const int seconds)
+--                              const int seconds: A timeout in seconds.
+--
+-- RETURNS:                 The number of ticks in seconds.
+--------------------------------------------------------------------------------------------------*/
+uint64_t wheelTicks(const int seconds)
+{
+    return (uint64_t)seconds * 1000 / WHEEL_TICK_MS;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                wheelSchedule
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void wheelSchedule(struct timer_wheel *wheel, struct wheel_timer *timer,
+--                                             const uint64_t ticks)
+--                              struct timer_wheel *wheel: The wheel of the calling worker.
+--                              struct wheel_timer *timer: The timer, armed or not.
+--                              const uint64_t ticks: How many ticks from now it fires, at least 1.
+--
+-- NOTES:
+-- Arms the timer or moves its deadline. A timer linked into a slot that is visited before the new
+-- deadline stays where it is.
+--------------------------------------------------------------------------------------------------*/
+void wheelSchedule(struct timer_wheel *wheel, struct wheel_timer *timer, const uint64_t ticks)
+{
+    timer->deadline = wheel->now + (ticks > 0 ? ticks : 1);
+
+    if (wheelArmed(timer) && timer->slotTick <= timer->deadline)
+    {
+        return;
+    }
+
+    wheelCancel(timer);
+    wheelLink(wheel, timer, timer->deadline);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                wheelCancel
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void wheelCancel(struct wheel_timer *timer)
+--                              struct wheel_timer *timer: The timer, armed or not.
+--
+-- NOTES:
+-- Unlinks the timer from whatever slot it is in. Does nothing for a timer that is not armed.
+--------------------------------------------------------------------------------------------------*/
+void wheelCancel(struct wheel_timer *timer)
+{
+    if (!wheelArmed(timer))
+    {
+        return;
+    }
+
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = NULL;
+    timer->prev = NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                wheelArmed
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool wheelArmed(const struct wheel_timer *timer)
+--                              const struct wheel_timer *timer: The timer.
+--
+-- RETURNS:                 True if the timer is linked into a wheel, false otherwise. A zeroed timer
+--                          is not armed.
+--------------------------------------------------------------------------------------------------*/
+bool wheelArmed(const struct wheel_timer *timer)
+{
+    return timer->next != NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                wheelAdvance
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int wheelAdvance(struct timer_wheel *wheel,
+--                                           void (*expire)(struct wheel_timer *timer, void *arg), void *arg)
+--                              struct timer_wheel *wheel: The wheel of the calling worker.
+--                              void (*expire)(...): Called with every timer that fired, unlinked.
+--                              void *arg: Passed on to expire.
+--
+-- RETURNS:                 The number of timers that fired.
+--
+-- NOTES:
+-- Reads how many ticks passed from the timerfd and visits a slot for each. The timers of a slot are
+-- moved to a list of their own first, so that one linked back into the same slot is not visited twice
+-- and expire may cancel any other timer.
+--------------------------------------------------------------------------------------------------*/
+int wheelAdvance(struct timer_wheel *wheel, void (*expire)(struct wheel_timer *timer, void *arg), void *arg)
+{
+    uint64_t ticks;
+    int fired = 0;
+
+    if (read(wheel->timerFd, &ticks, sizeof(ticks)) != sizeof(ticks))
+    {
+        return 0;
+    }
+
+    while (ticks-- > 0)
+    {
+        struct wheel_timer *slot;
+        struct wheel_timer visiting;
+
+        wheel->now++;
+        slot = &wheel->slots[wheel->now & (WHEEL_SLOTS - 1)];
+        if (slot->next == slot)
+        {
+            continue;
+        }
+
+        visiting.next = slot->next;
+        visiting.prev = slot->prev;
+        visiting.next->prev = &visiting;
+        visiting.prev->next = &visiting;
+        slot->next = slot;
+        slot->prev = slot;
+
+        while (visiting.next != &visiting)
+        {
+            struct wheel_timer *timer = visiting.next;
+
+            wheelCancel(timer);
+            if (timer->deadline <= wheel->now)
+            {
+                fired++;
+                expire(timer, arg);
+            }
+            else
+            {
+                wheelLink(wheel, timer, timer->deadline);
+            }
+        }
+    }
+
+    return fired;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                wheelLink
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void wheelLink(struct timer_wheel *wheel, struct wheel_timer *timer,
+--                                         const uint64_t tick)
+--                              struct timer_wheel *wheel: The wheel.
+--                              struct wheel_timer *timer: A timer that is not armed.
+--                              const uint64_t tick: The tick of the slot to link it into.
+--------------------------------------------------------------------------------------------------*/
+void wheelLink(struct timer_wheel *wheel, struct wheel_timer *timer, const uint64_t tick)
+{
+    struct wheel_timer *slot = &wheel->slots[tick & (WHEEL_SLOTS - 1)];
+
+    timer->slotTick = tick;
+    timer->next = slot->next;
+    timer->prev = slot;
+    slot->next->prev = timer;
+    slot->next = timer;
+}
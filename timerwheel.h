@@ -0,0 +1,37 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// must be a power of two, a timer further out than a turn of the wheel just goes around again
+#define WHEEL_SLOTS 1024
+#define WHEEL_TICK_MS 100
+
+struct wheel_timer
+{
+    struct wheel_timer *next;
+    struct wheel_timer *prev;
+    // the tick the timer fires at, and the tick of the slot it is linked into
+    uint64_t deadline;
+    uint64_t slotTick;
+};
+
+struct timer_wheel
+{
+    int timerFd;
+    uint64_t now;
+    // list heads only, their deadlines are unused
+    struct wheel_timer slots[WHEEL_SLOTS];
+};
+
+struct timer_wheel *createTimerWheel();
+void destroyTimerWheel(struct timer_wheel *wheel);
+uint64_t wheelTicks(const int seconds);
+void wheelSchedule(struct timer_wheel *wheel, struct wheel_timer *timer, const uint64_t ticks);
+void wheelCancel(struct wheel_timer *timer);
+bool wheelArmed(const struct wheel_timer *timer);
+int wheelAdvance(struct timer_wheel *wheel, void (*expire)(struct wheel_timer *timer, void *arg), void *arg);
+void wheelLink(struct timer_wheel *wheel, struct wheel_timer *timer, const uint64_t tick);
+
+#endif // TIMERWHEEL_H
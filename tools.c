@@ -6,11 +6,16 @@
 -- FUNCTIONS:
 --                         void systemFatal(const char *message)
 --                         void formatTime(size_t *ms, size_t *us, const struct timeval *time)
---                         bool startLogging()
+--                         bool startLogging(const int policy, const int format)
 --                         void stopLogging()
 --                         void logAcc(const int sock)
 --                         void logRcv(const int sock, const int amount)
 --                         void logSnd(const int sock, const int amount)
+--                         void logEvent(const int sock, const int event, const int amount)
+--                         struct log_ring *createLocalRing()
+--                         void *logFlusher(void *arg)
+--                         int flushRings()
+--                         void writeRecord(const struct log_record *record)
 --
 -- DATE:                   Feb 19, 2019
 --
@@ -22,14 +27,34 @@
 --
 -- NOTES:
 -- General functions that are useful tools which aide in IO.
+--
+-- Logging never takes a lock on the hot path. Each thread that logs gets its own single producer
+-- ring of fixed size records the first time it logs. A flusher thread drains all rings, merges the
+-- records of one pass by timestamp and writes them to the log file in large batches. What a thread
+-- does when its ring is full is set by the policy given to startLogging(). The log is either the CSV
+-- server.log or the binary server.bin described in logfile.c, in which case the flusher copies the
+-- records out as they are.
 ---------------------------------------------------------------------------------------*/
 #include "tools.h"
 
 #include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define LOG_OUT_SIZE (1 << 20)
+
+static FILE *logFile = NULL;
+static int logPolicy = LOG_BLOCK;
+static int logFormat = LOG_FORMAT_CSV;
+static struct log_ring *rings = NULL;
+static __thread struct log_ring *localRing = NULL;
+static pthread_t flusher;
+static volatile bool flusherRunning = false;
 
-FILE *logFile = NULL;
-pthread_mutex_t lock;
+static char *outBuffer = NULL;
+static size_t outLength = 0;
 
 /*--------------------------------------------------------------------------------------------------
 -- FUNCTION:                systemFatal
@@ -84,30 +109,59 @@ void formatTime(size_t *ms, size_t *us, const struct timeval *time)
 --
 -- DATE:                    Feb 19, 2019
 --
--- REVISIONS:               N/A
+-- REVISIONS:               Oct 17, 2026 - Start the flusher thread and take the full ring policy.
+--                          Oct 17, 2026 - Binary log format.
 --
 -- DESIGNER:                Benny Wang
 --
 -- PROGRAMMER:              Benny Wang
 --
--- INTERFACE:               int startLogging()
+-- INTERFACE:               int startLogging(const int policy, const int format)
+--                              const int policy: LOG_BLOCK, LOG_DROP or LOG_OVERWRITE.
+--                              const int format: LOG_FORMAT_CSV or LOG_FORMAT_BINARY.
 --
 -- RETURNS:                 True if logging was started, false otherwise.
 --
 -- NOTES:
--- Opens the logging file.
+-- Opens the logging file and starts the flusher thread. A binary log starts with its header.
 --------------------------------------------------------------------------------------------------*/
-bool startLogging()
+bool startLogging(const int policy, const int format)
 {
-    pthread_mutex_lock(&lock);
-    logFile = fopen("server.log", "wb+");
-    pthread_mutex_unlock(&lock);
+    logPolicy = policy;
+    logFormat = format;
+
+    if ((outBuffer = malloc(LOG_OUT_SIZE)) == NULL)
+    {
+        return false;
+    }
 
-    if (logFile == NULL)
+    if ((logFile = fopen(format == LOG_FORMAT_BINARY ? "server.bin" : "server.log", "wb+")) == NULL)
     {
-        return 0;
+        return false;
     }
-    return 1;
+
+    if (format == LOG_FORMAT_BINARY)
+    {
+        struct log_file_header header;
+        struct timespec now;
+
+        clock_gettime(CLOCK_REALTIME, &now);
+        initLogFileHeader(&header, (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec);
+        if (fwrite(&header, sizeof(header), 1, logFile) != 1)
+        {
+            fclose(logFile);
+            return false;
+        }
+    }
+
+    flusherRunning = true;
+    if (pthread_create(&flusher, NULL, logFlusher, NULL))
+    {
+        fclose(logFile);
+        return false;
+    }
+
+    return true;
 }
 
 /*--------------------------------------------------------------------------------------------------
@@ -115,7 +169,7 @@ bool startLogging()
 --
 -- DATE:                    Feb 19, 2019
 --
--- REVISIONS:               N/A
+-- REVISIONS:               Oct 17, 2026 - Drain the rings and report lost records.
 --
 -- DESIGNER:                Benny Wang
 --
@@ -124,14 +178,38 @@ bool startLogging()
 -- INTERFACE:               void stopLogging()
 --
 -- NOTES:
--- Flushs all writes to the log file and closes the log file.
+-- Stops the flusher once every ring is drained, flushs all writes to the log file and closes the log
+-- file. Prints how many records were dropped or overwritten if any were.
 --------------------------------------------------------------------------------------------------*/
 void stopLogging()
 {
-    pthread_mutex_lock(&lock);
+    uint64_t dropped = 0;
+    uint64_t overwritten = 0;
+
+    flusherRunning = false;
+    pthread_join(flusher, NULL);
+
+    while (rings != NULL)
+    {
+        struct log_ring *ring = rings;
+        rings = ring->next;
+
+        dropped += ring->dropped;
+        overwritten += ring->overwritten;
+
+        free(ring->records);
+        free(ring->batch);
+        free(ring);
+    }
+
+    if (dropped || overwritten)
+    {
+        fprintf(stderr, "log: %lu records dropped, %lu overwritten\n", dropped, overwritten);
+    }
+
     fflush(logFile);
     fclose(logFile);
-    pthread_mutex_unlock(&lock);
+    free(outBuffer);
 }
 
 /*--------------------------------------------------------------------------------------------------
@@ -153,15 +231,7 @@ void stopLogging()
 --------------------------------------------------------------------------------------------------*/
 void logAcc(const int sock)
 {
-    size_t ms;
-    size_t us;
-    struct timeval timestamp;
-    // try until it works
-    while (gettimeofday(&timestamp, 0) == -1);
-    formatTime(&ms, &us, &timestamp);
-    pthread_mutex_lock(&lock);
-    while (fprintf(logFile, "%d,%lu.%03lu,new\n", sock, ms, us) <= 0);
-    pthread_mutex_unlock(&lock);
+    logEvent(sock, LOG_EVENT_NEW, 0);
 }
 
 /*--------------------------------------------------------------------------------------------------
@@ -184,16 +254,7 @@ void logAcc(const int sock)
 --------------------------------------------------------------------------------------------------*/
 void logRcv(const int sock, const int amount)
 {
-    size_t ms;
-    size_t us;
-    struct timeval timestamp;
-
-    // try until it works
-    while (gettimeofday(&timestamp, 0) == -1);
-    formatTime(&ms, &us, &timestamp);
-    pthread_mutex_lock(&lock);
-    while (fprintf(logFile, "%d,%lu.%03lu,rcv,%d\n", sock, ms, us, amount) <= 0);
-    pthread_mutex_unlock(&lock);
+    logEvent(sock, LOG_EVENT_RCV, amount);
 }
 
 /*--------------------------------------------------------------------------------------------------
@@ -216,14 +277,267 @@ void logRcv(const int sock, const int amount)
 --------------------------------------------------------------------------------------------------*/
 void logSnd(const int sock, const int amount)
 {
-    size_t ms;
-    size_t us;
-    struct timeval timestamp;
+    logEvent(sock, LOG_EVENT_SND, amount);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                logEvent
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void logEvent(const int sock, const int event, const int amount)
+--                             const int sock: The socket of the event.
+--                             const int event: One of the LOG_EVENT values.
+--                             const int amount: The amount of data, 0 for accepts.
+--
+-- NOTES:
+-- Timestamps the event and places it in the ring of the calling thread. If the ring is full the
+-- record is dropped, the oldest record is overwritten, or the thread waits for the flusher, depending
+-- on the policy.
+--------------------------------------------------------------------------------------------------*/
+void logEvent(const int sock, const int event, const int amount)
+{
+    struct timespec timestamp;
+    struct log_record *record;
+    struct log_ring *ring = localRing != NULL ? localRing : createLocalRing();
+    uint64_t tail = ring->tail;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    while (tail - head >= LOG_RING_SIZE)
+    {
+        switch (logPolicy)
+        {
+        case LOG_DROP:
+            ring->dropped++;
+            return;
+        case LOG_OVERWRITE:
+            // on failure head is reloaded and the check runs again
+            if (__atomic_compare_exchange_n(&ring->head, &head, head + 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                ring->overwritten++;
+                head++;
+            }
+            break;
+        default:
+            sched_yield();
+            head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+            break;
+        }
+    }
 
     // try until it works
-    while (gettimeofday(&timestamp, 0) == -1);
-    formatTime(&ms, &us, &timestamp);
-    pthread_mutex_lock(&lock);
-    while (fprintf(logFile, "%d,%lu.%03lu,snd,%d\n", sock, ms, us, amount) <= 0);
-    pthread_mutex_unlock(&lock);
-}
\ No newline at end of file
+    while (clock_gettime(CLOCK_REALTIME, &timestamp) == -1);
+
+    record = &ring->records[tail & (LOG_RING_SIZE - 1)];
+    record->ns = (uint64_t)timestamp.tv_sec * 1000000000 + timestamp.tv_nsec;
+    record->sock = sock;
+    record->amount = amount;
+    record->event = event;
+
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                createLocalRing
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               struct log_ring *createLocalRing()
+--
+-- RETURNS:                 The ring of the calling thread.
+--
+-- NOTES:
+-- Allocates the ring of the calling thread and publishes it to the flusher. Only runs the first time
+-- a thread logs.
+--------------------------------------------------------------------------------------------------*/
+struct log_ring *createLocalRing()
+{
+    struct log_ring *ring;
+
+    if ((ring = aligned_alloc(64, sizeof(struct log_ring))) == NULL)
+    {
+        systemFatal("aligned_alloc");
+    }
+    memset(ring, 0, sizeof(struct log_ring));
+
+    if ((ring->records = calloc(LOG_RING_SIZE, sizeof(struct log_record))) == NULL
+        || (ring->batch = calloc(LOG_BATCH_SIZE, sizeof(struct log_record))) == NULL)
+    {
+        systemFatal("calloc");
+    }
+
+    ring->next = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&rings, &ring->next, ring, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    localRing = ring;
+    return ring;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                logFlusher
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void *logFlusher(void *arg)
+--                              void *arg: Unused.
+--
+-- RETURNS:                 NULL - unused.
+--
+-- NOTES:
+-- The main function of the flusher thread. Drains the rings until logging stops, sleeping for a
+-- millisecond whenever they are empty. Drains whatever is left before returning.
+--------------------------------------------------------------------------------------------------*/
+void *logFlusher(void *arg)
+{
+    const struct timespec idle = { .tv_sec = 0, .tv_nsec = 1000000 };
+
+    while (flusherRunning)
+    {
+        if (flushRings() == 0)
+        {
+            nanosleep(&idle, NULL);
+        }
+    }
+
+    while (flushRings() > 0);
+
+    fwrite(outBuffer, 1, outLength, logFile);
+    outLength = 0;
+
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                flushRings
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int flushRings()
+--
+-- RETURNS:                 The number of records written.
+--
+-- NOTES:
+-- Takes a batch from every ring and writes the batches merged by timestamp. A batch is copied out
+-- before the head is moved. If the head moved in the meantime the worker overwrote the oldest part
+-- of the batch, so the copy is taken again from the new head.
+--------------------------------------------------------------------------------------------------*/
+int flushRings()
+{
+    int written = 0;
+    struct log_ring *first = __atomic_load_n(&rings, __ATOMIC_ACQUIRE);
+
+    for (struct log_ring *ring = first; ring != NULL; ring = ring->next)
+    {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        uint64_t end;
+
+        ring->batchSize = 0;
+        ring->batchPos = 0;
+
+        while (head != tail)
+        {
+            end = tail - head > LOG_BATCH_SIZE ? head + LOG_BATCH_SIZE : tail;
+
+            for (uint64_t i = head; i < end; i++)
+            {
+                ring->batch[i - head] = ring->records[i & (LOG_RING_SIZE - 1)];
+            }
+
+            if (__atomic_compare_exchange_n(&ring->head, &head, end, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                ring->batchSize = end - head;
+                break;
+            }
+
+            // head now holds the new head, copy again from there
+            tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        }
+    }
+
+    // merge the batches by timestamp
+    while (true)
+    {
+        struct log_ring *next = NULL;
+
+        for (struct log_ring *ring = first; ring != NULL; ring = ring->next)
+        {
+            if (ring->batchPos < ring->batchSize
+                && (next == NULL || ring->batch[ring->batchPos].ns < next->batch[next->batchPos].ns))
+            {
+                next = ring;
+            }
+        }
+
+        if (next == NULL)
+        {
+            break;
+        }
+
+        writeRecord(&next->batch[next->batchPos++]);
+        written++;
+    }
+
+    return written;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                writeRecord
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void writeRecord(const struct log_record *record)
+--                              const struct log_record *record: The record to write.
+--
+-- NOTES:
+-- Appends the record to the output buffer, as a CSV line or as is for a binary log, and writes the
+-- buffer out once it is nearly full.
+--------------------------------------------------------------------------------------------------*/
+void writeRecord(const struct log_record *record)
+{
+    if (LOG_OUT_SIZE - outLength < 64)
+    {
+        fwrite(outBuffer, 1, outLength, logFile);
+        outLength = 0;
+    }
+
+    if (logFormat == LOG_FORMAT_BINARY)
+    {
+        memcpy(outBuffer + outLength, record, sizeof(struct log_record));
+        outLength += sizeof(struct log_record);
+    }
+    else
+    {
+        outLength += formatRecord(outBuffer + outLength, LOG_OUT_SIZE - outLength, record);
+    }
+}
@@ -2,18 +2,55 @@
 #define TOOLS_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <sys/time.h>
 
+#include "logfile.h"
+
+// what a worker does when its log ring is full
+#define LOG_BLOCK 0
+#define LOG_DROP 1
+#define LOG_OVERWRITE 2
+
+// records per ring, must be a power of two
+#define LOG_RING_SIZE (1 << 16)
+// records the flusher takes from one ring per pass
+#define LOG_BATCH_SIZE 8192
+
+struct log_ring
+{
+    // written by the owning worker only
+    _Alignas(64) uint64_t tail;
+    uint64_t dropped;
+    uint64_t overwritten;
+
+    // advanced by the flusher, and by the worker when overwriting
+    _Alignas(64) uint64_t head;
+
+    // owned by the flusher
+    _Alignas(64) struct log_record *records;
+    struct log_record *batch;
+    int batchSize;
+    int batchPos;
+    struct log_ring *next;
+};
+
 void systemFatal(const char *message);
 
 void formatTime(size_t *ms, size_t *us, const struct timeval *time);
 
-bool startLogging();
+bool startLogging(const int policy, const int format);
 void stopLogging();
 
 void logAcc(const int sock);
 void logRcv(const int sock, const int amount);
 void logSnd(const int sock, const int amount);
+void logEvent(const int sock, const int event, const int amount);
+
+struct log_ring *createLocalRing();
+void *logFlusher(void *arg);
+int flushRings();
+void writeRecord(const struct log_record *record);
 
-#endif // TOOLS_H
\ No newline at end of file
+#endif // TOOLS_H
@@ -0,0 +1,1376 @@
+/*---------------------------------------------------------------------------------------
+-- SOURCE FILE:            uring_svr.c
+--
+-- PROGRAM:                server.out
+--
+-- FUNCTIONS:
+--                         void runUring(const int listenSocket, const struct server_config *config)
+--                         void *uringWorker(void *args)
+--                         bool uringInit(struct uring *ring, const unsigned entries)
+--                         void uringDestroy(struct uring *ring)
+--                         struct io_uring_sqe *uringGetSqe(struct uring *ring)
+--                         int uringSubmitAndWait(struct uring *ring)
+--                         bool uringBuffersInit(struct uring *ring, struct uring_buffers *bufs, const int count, const int size)
+--                         void uringBuffersDestroy(struct uring *ring, struct uring_buffers *bufs)
+--                         void uringBuffersRecycle(struct uring_buffers *bufs, const int bid)
+--                         void uringArmAccept(struct uring *ring, const int listenSocket)
+--                         void uringArmDrain(struct uring *ring)
+--                         void uringCancelAccept(struct uring *ring)
+--                         void uringArmRecv(struct uring *ring, struct uring_conn *conn)
+--                         void uringQueueSends(struct uring *ring, struct uring_conn *conn)
+--                         bool uringWriteSegments(struct handler_conn *handlerConn, const struct iovec *iov, const int count,
+--                                                 const bool more)
+--                         void uringReleaseSegment(struct uring_buffers *bufs, struct uring_segment *segment)
+--                         void uringFailConn(struct uring_conn *conn)
+--                         void uringRefuseConn(struct uring_conn *conn)
+--                         void uringHandleRecv(struct uring *ring, struct uring_buffers *bufs, struct uring_conn *conn,
+--                                              struct io_uring_cqe *cqe, struct uring_conn **starved)
+--                         void uringHandleSend(struct uring *ring, struct uring_buffers *bufs, struct uring_conn *conn,
+--                                              struct io_uring_cqe *cqe)
+--                         void uringReleaseConn(struct uring_buffers *bufs, struct uring_conn *conn)
+--                         void uringLinkConn(struct uring_conn *conn)
+--                         bool uringDrainConns(const uint64_t start, const size_t total, const int timeout)
+--
+-- DATE:                   Oct 17, 2026
+--
+-- REVISIONS:              Oct 17, 2026 - Received buffers go to the protocol handler, its output is queued.
+--                         Oct 18, 2026 - Output the handler shares is sent without a copy.
+--                         Oct 18, 2026 - Drain instead of being cancelled.
+--
+-- DESIGNERS:              Benny Wang
+--
+-- PROGRAMMERS:            Benny Wang
+--
+-- NOTES:
+-- Contains all functions for running the server in io_uring mode.
+--
+-- Every worker owns a ring with one multishot accept armed on the listening socket. Each accepted
+-- connection gets one multishot recv that picks its buffers from a provided buffer ring, so data
+-- arrives without any readiness notification or recv call. Every received buffer is handed to the
+-- protocol handler, and the output it queued becomes pieces queued on the connection, sent with a
+-- chain of linked send SQEs, which keeps the output in order even when the socket is full. A piece
+-- that is part of the received buffer is sent from it, so the echo is never copied, and the buffer
+-- goes back to the buffer ring once no piece points into it any more. Any other piece is copied, the
+-- handler only keeps it unchanged until it returns.
+--
+-- All submissions and completions of one loop iteration cost a single io_uring_enter call.
+--
+-- Every worker also polls the drain eventfd of the server. Once it fires the worker cancels its
+-- accept, lets every connection go once its answer is out, shuts idle ones down a few at a time over
+-- the drain timeout like epoll does and returns when it has no connections left.
+--
+-- Since the echo is asynchronous the service time is measured per piece, from when the recv
+-- completion it answers is handled to when the send of its last byte completes.
+---------------------------------------------------------------------------------------*/
+#define _REENTRANT
+#define DCE_COMPAT
+
+#include "uring_svr.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "affinity.h"
+#include "control.h"
+#include "metrics.h"
+#include "stats.h"
+#include "tools.h"
+#include "net.h"
+
+#define URING_ENTRIES 4096
+#define URING_BUFFERS 4096
+#define URING_BUFFER_GROUP 0
+#define URING_MAX_CHAIN 16
+
+// the operation is kept in the low bits of user_data, connections are at least 8 byte aligned
+#define URING_OP_ACCEPT 1
+#define URING_OP_RECV 2
+#define URING_OP_SEND 3
+#define URING_OP_DRAIN 4
+#define URING_OP_CANCEL 5
+#define URING_OP_MASK 7
+
+static __thread struct uring_conn *localConns = NULL;
+static __thread size_t localCount = 0;
+static __thread bool localDraining = false;
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                runUring
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - The configured number of workers, each with its cpu.
+--                          Oct 17, 2026 - Wait for the server to be stopped or drained.
+--                          Oct 17, 2026 - Pass on the protocol handler.
+--                          Oct 18, 2026 - Let the workers drain.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void runUring(const int listenSocket, const struct server_config *config)
+--                              const int listenSocket: The listening socket.
+--                              const struct server_config *config: The server configuration.
+--
+-- NOTES:
+-- The main entry point for io_uring mode. Spawns the workers, each given the cpu it runs on, and waits
+-- for all of them to exit. Stopping the server cancels the workers, while draining it is up to the
+-- workers, which poll the drain eventfd and return when they are done.
+--------------------------------------------------------------------------------------------------*/
+void runUring(const int listenSocket, const struct server_config *config)
+{
+    struct uring_worker_arg *args;
+    pthread_t *workers;
+    int nWorkers = config->workers;
+
+    if ((workers = calloc(nWorkers, sizeof(pthread_t))) == NULL
+        || (args = calloc(nWorkers, sizeof(struct uring_worker_arg))) == NULL)
+    {
+        systemFatal("calloc");
+    }
+
+    for (int i = 0; i < nWorkers; i++)
+    {
+        args[i].cpu = config->workerCpus[i];
+        args[i].listenSocket = listenSocket;
+        args[i].bufferLength = config->bufferLength;
+        args[i].drainTimeout = config->drainTimeout;
+        args[i].handler = config->handler;
+
+        if (pthread_create(workers + i, NULL, uringWorker, (void *)(args + i)))
+        {
+            systemFatal("pthread_create");
+        }
+    }
+
+    if (awaitControl() == CONTROL_STOP)
+    {
+        for (int i = 0; i < nWorkers; i++)
+        {
+            pthread_cancel(workers[i]);
+        }
+    }
+
+    for (int i = 0; i < nWorkers; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+
+    free(workers);
+    free(args);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringWorker
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Pin to the cpu and allocate on its node.
+--                          Oct 17, 2026 - Start the protocol handler of every connection.
+--                          Oct 18, 2026 - Drain and return when the server drains.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void *uringWorker(void *args)
+--                              void *args: A uring_worker_arg struct.
+--
+-- RETURNS:                 NULL - unused.
+--
+-- NOTES:
+-- The main function of each worker thread for io_uring. Pins itself to its cpu, sets up the ring and
+-- the provided buffers on the node of that cpu, arms the multishot accept and then goes into a
+-- forever loop that submits all pending requests, waits for completions and handles them. The
+-- handler of the worker is started on every accepted connection, and one it refuses is closed once
+-- what it queued is out. Setting up each accepted connection and handling each batch of completions
+-- is timed into the worker's metrics. Once the drain eventfd fires the worker cancels its accept,
+-- drains its connections over the drain timeout and returns when none are left.
+--------------------------------------------------------------------------------------------------*/
+void *uringWorker(void *args)
+{
+    struct uring ring;
+    struct uring_buffers bufs;
+    struct uring_conn *starved = NULL;
+    uint64_t drainStart = 0;
+    size_t drainTotal = 0;
+
+    struct uring_worker_arg *argPtr = (struct uring_worker_arg *)args;
+
+    // before anything is allocated so that it all lands on the node of the cpu
+    if (!pinWorker(argPtr->cpu))
+    {
+        fprintf(stderr, "pinWorker: could not pin worker to cpu %d\n", argPtr->cpu);
+    }
+
+    if (!uringInit(&ring, URING_ENTRIES))
+    {
+        systemFatal("uringInit");
+    }
+
+    if (!uringBuffersInit(&ring, &bufs, URING_BUFFERS, argPtr->bufferLength))
+    {
+        systemFatal("uringBuffersInit");
+    }
+
+    uringArmAccept(&ring, argPtr->listenSocket);
+    uringArmDrain(&ring);
+
+    // claim a stats slot up front so that idle workers show up too
+    createLocalStats();
+
+    while (!localDraining || localCount > 0)
+    {
+        unsigned head;
+        unsigned tail;
+        unsigned short bufTail;
+        unsigned reaped;
+        uint64_t loopStart;
+        bool forced = false;
+
+        pthread_testcancel();
+
+        if (uringSubmitAndWait(&ring) == -1 && errno != ETIME && errno != EINTR)
+        {
+            systemFatal("io_uring_enter");
+        }
+        loopStart = metricsNow();
+
+        bufTail = bufs.tail;
+        head = *ring.cqHead;
+        tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+        reaped = tail - head;
+
+        for (; head != tail; head++)
+        {
+            struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cqMask];
+            struct uring_conn *conn = (struct uring_conn *)(cqe->user_data & ~(__u64)URING_OP_MASK);
+            uint64_t start;
+            int fd;
+
+            switch (cqe->user_data & URING_OP_MASK)
+            {
+            case URING_OP_ACCEPT:
+                if (!(cqe->flags & IORING_CQE_F_MORE) && !localDraining)
+                {
+                    uringArmAccept(&ring, argPtr->listenSocket);
+                }
+
+                if ((fd = cqe->res) < 0)
+                {
+                    // cancelled by a draining worker
+                    if (fd != -ECANCELED)
+                    {
+                        fprintf(stderr, "accept: %s\n", strerror(-fd));
+                        statsAdd(STAT_ERRORS, 1);
+                    }
+                    break;
+                }
+
+                start = metricsNow();
+                logAcc(fd);
+                statsAdd(STAT_ACCEPTS, 1);
+
+                if ((conn = calloc(1, sizeof(struct uring_conn))) == NULL)
+                {
+                    systemFatal("calloc");
+                }
+                conn->fd = fd;
+                conn->ring = &ring;
+                conn->bufs = &bufs;
+                conn->handlerConn.fd = fd;
+                conn->handlerConn.handler = argPtr->handler;
+                conn->handlerConn.write = uringWriteSegments;
+                conn->handlerConn.read = NULL;
+                uringLinkConn(conn);
+                if (!handlerAccept(&conn->handlerConn))
+                {
+                    // no recv was armed, so it closes once what was queued is sent
+                    conn->closing = true;
+                    conn->refused = true;
+                    if (conn->inflight == 0)
+                    {
+                        uringReleaseConn(&bufs, conn);
+                    }
+                    break;
+                }
+                uringArmRecv(&ring, conn);
+
+                metricsRecord(METRIC_ACCEPT, metricsNow() - start);
+                break;
+            case URING_OP_RECV:
+                uringHandleRecv(&ring, &bufs, conn, cqe, &starved);
+                break;
+            case URING_OP_SEND:
+                uringHandleSend(&ring, &bufs, conn, cqe);
+                break;
+            case URING_OP_DRAIN:
+                // leave the listener to the other workers or to the new server
+                uringCancelAccept(&ring);
+                localDraining = true;
+                drainStart = metricsNow();
+                drainTotal = localCount;
+                break;
+            }
+        }
+
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+
+        if (localDraining)
+        {
+            forced = uringDrainConns(drainStart, drainTotal, argPtr->drainTimeout);
+        }
+
+        // connections that ran out of buffers can receive again once some were returned, or see that
+        // they were shut down
+        if (starved != NULL && (bufTail != bufs.tail || forced))
+        {
+            while (starved != NULL)
+            {
+                struct uring_conn *conn = starved;
+                starved = conn->nextStarved;
+                uringArmRecv(&ring, conn);
+            }
+        }
+
+        // the wait also ends every time it times out, only count batches with completions
+        if (reaped > 0)
+        {
+            metricsRecord(METRIC_LOOP, metricsNow() - loopStart);
+            statsAdd(STAT_LOOPS, 1);
+        }
+    }
+
+    uringBuffersDestroy(&ring, &bufs);
+    uringDestroy(&ring);
+
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringInit
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool uringInit(struct uring *ring, const unsigned entries)
+--                              struct uring *ring: The ring to set up.
+--                              const unsigned entries: The number of submission queue entries.
+--
+-- RETURNS:                 True if the ring was created and mapped, false otherwise.
+--
+-- NOTES:
+-- Creates an io_uring instance and maps its submission queue, completion queue and sqe array. The
+-- completion queue is made four times bigger than the submission queue since multishot requests
+-- produce many completions per submission.
+--------------------------------------------------------------------------------------------------*/
+bool uringInit(struct uring *ring, const unsigned entries)
+{
+    struct io_uring_params params;
+    char *sq;
+    char *cq;
+
+    memset(ring, 0, sizeof(struct uring));
+    memset(&params, 0, sizeof(struct io_uring_params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+
+    if ((ring->fd = syscall(__NR_io_uring_setup, entries, &params)) == -1)
+    {
+        return false;
+    }
+
+    if (!(params.features & IORING_FEAT_EXT_ARG))
+    {
+        close(ring->fd);
+        errno = ENOSYS;
+        return false;
+    }
+
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (ring->cqRingSize > ring->sqRingSize)
+        {
+            ring->sqRingSize = ring->cqRingSize;
+        }
+        ring->cqRingSize = ring->sqRingSize;
+    }
+
+    ring->sqRingPtr = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sqRingPtr == MAP_FAILED)
+    {
+        close(ring->fd);
+        return false;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        ring->cqRingPtr = ring->sqRingPtr;
+    }
+    else
+    {
+        ring->cqRingPtr = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                               ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cqRingPtr == MAP_FAILED)
+        {
+            munmap(ring->sqRingPtr, ring->sqRingSize);
+            close(ring->fd);
+            return false;
+        }
+    }
+
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        uringDestroy(ring);
+        return false;
+    }
+
+    sq = ring->sqRingPtr;
+    ring->sqHead = (unsigned *)(sq + params.sq_off.head);
+    ring->sqTail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned *)(sq + params.sq_off.array);
+    ring->sqEntries = params.sq_entries;
+    ring->sqLocalTail = *ring->sqTail;
+
+    cq = ring->cqRingPtr;
+    ring->cqHead = (unsigned *)(cq + params.cq_off.head);
+    ring->cqTail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringDestroy
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void uringDestroy(struct uring *ring)
+--                              struct uring *ring: The ring to tear down.
+--
+-- NOTES:
+-- Unmaps the ring memory and closes the ring.
+--------------------------------------------------------------------------------------------------*/
+void uringDestroy(struct uring *ring)
+{
+    if (ring->sqes != NULL && ring->sqes != MAP_FAILED)
+    {
+        munmap(ring->sqes, ring->sqesSize);
+    }
+    if (ring->cqRingPtr != NULL && ring->cqRingPtr != ring->sqRingPtr)
+    {
+        munmap(ring->cqRingPtr, ring->cqRingSize);
+    }
+    munmap(ring->sqRingPtr, ring->sqRingSize);
+    close(ring->fd);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringGetSqe
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               struct io_uring_sqe *uringGetSqe(struct uring *ring)
+--                              struct uring *ring: The ring to take the entry from.
+--
+-- RETURNS:                 A zeroed submission queue entry.
+--
+-- NOTES:
+-- Reserves the next submission queue entry. If the queue is full the pending entries are submitted
+-- first to make room.
+--------------------------------------------------------------------------------------------------*/
+struct io_uring_sqe *uringGetSqe(struct uring *ring)
+{
+    struct io_uring_sqe *sqe;
+    unsigned index;
+
+    while (ring->sqLocalTail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) >= ring->sqEntries)
+    {
+        __atomic_store_n(ring->sqTail, ring->sqLocalTail, __ATOMIC_RELEASE);
+        if (syscall(__NR_io_uring_enter, ring->fd, ring->toSubmit, 0, 0, NULL, 0) == -1 && errno != EINTR)
+        {
+            systemFatal("io_uring_enter");
+        }
+        ring->toSubmit = ring->sqLocalTail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+    }
+
+    index = ring->sqLocalTail & *ring->sqMask;
+    sqe = &ring->sqes[index];
+    ring->sqArray[index] = index;
+    ring->sqLocalTail++;
+    ring->toSubmit++;
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    return sqe;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringSubmitAndWait
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               int uringSubmitAndWait(struct uring *ring)
+--                              struct uring *ring: The ring to submit.
+--
+-- RETURNS:                 The result of io_uring_enter.
+--
+-- NOTES:
+-- Submits every pending entry and waits for at least one completion in the same system call. The
+-- wait times out after half a second so that the worker can notice being cancelled.
+--------------------------------------------------------------------------------------------------*/
+int uringSubmitAndWait(struct uring *ring)
+{
+    int ret;
+    struct __kernel_timespec timeout = { .tv_sec = 0, .tv_nsec = 500000000 };
+    struct io_uring_getevents_arg arg;
+
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (__u64)(unsigned long)&timeout;
+
+    __atomic_store_n(ring->sqTail, ring->sqLocalTail, __ATOMIC_RELEASE);
+
+    ret = syscall(__NR_io_uring_enter, ring->fd, ring->toSubmit, 1,
+                  IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+
+    ring->toSubmit = ring->sqLocalTail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+
+    return ret;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringBuffersInit
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool uringBuffersInit(struct uring *ring, struct uring_buffers *bufs,
+--                                                const int count, const int size)
+--                              struct uring *ring: The ring to register the buffers with.
+--                              struct uring_buffers *bufs: The buffers to set up.
+--                              const int count: The number of buffers, must be a power of two.
+--                              const int size: The size of each buffer.
+--
+-- RETURNS:                 True if the buffers were registered, false otherwise.
+--
+-- NOTES:
+-- Allocates count buffers of size bytes, registers a provided buffer ring for them and hands every
+-- buffer to the kernel.
+--------------------------------------------------------------------------------------------------*/
+bool uringBuffersInit(struct uring *ring, struct uring_buffers *bufs, const int count, const int size)
+{
+    struct io_uring_buf_reg reg;
+
+    memset(bufs, 0, sizeof(struct uring_buffers));
+    bufs->count = count;
+    bufs->size = size;
+    bufs->ringSize = count * sizeof(struct io_uring_buf);
+
+    bufs->ring = mmap(NULL, bufs->ringSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bufs->ring == MAP_FAILED)
+    {
+        return false;
+    }
+
+    if ((bufs->base = calloc(count, size)) == NULL
+        || (bufs->refs = calloc(count, sizeof(int))) == NULL
+        || (bufs->receivedNs = calloc(count, sizeof(uint64_t))) == NULL)
+    {
+        return false;
+    }
+
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (__u64)(unsigned long)bufs->ring;
+    reg.ring_entries = count;
+    reg.bgid = URING_BUFFER_GROUP;
+
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        uringBuffersRecycle(bufs, i);
+    }
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringBuffersDestroy
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void uringBuffersDestroy(struct uring *ring, struct uring_buffers *bufs)
+--                              struct uring *ring: The ring the buffers are registered with.
+--                              struct uring_buffers *bufs: The buffers to free.
+--
+-- NOTES:
+-- Unregisters the provided buffer ring and frees the buffers.
+--------------------------------------------------------------------------------------------------*/
+void uringBuffersDestroy(struct uring *ring, struct uring_buffers *bufs)
+{
+    struct io_uring_buf_reg reg;
+
+    memset(&reg, 0, sizeof(reg));
+    reg.bgid = URING_BUFFER_GROUP;
+    syscall(__NR_io_uring_register, ring->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+
+    munmap(bufs->ring, bufs->ringSize);
+    free(bufs->base);
+    free(bufs->refs);
+    free(bufs->receivedNs);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringBuffersRecycle
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void uringBuffersRecycle(struct uring_buffers *bufs, const int bid)
+--                              struct uring_buffers *bufs: The buffers.
+--                              const int bid: The id of the buffer to give back.
+--
+-- NOTES:
+-- Hands buffer bid back to the kernel so that recv can pick it again.
+--------------------------------------------------------------------------------------------------*/
+void uringBuffersRecycle(struct uring_buffers *bufs, const int bid)
+{
+    struct io_uring_buf *buf = &bufs->ring->bufs[bufs->tail & (bufs->count - 1)];
+
+    buf->addr = (__u64)(unsigned long)(bufs->base + (size_t)bid * bufs->size);
+    buf->len = bufs->size;
+    buf->bid = bid;
+
+    bufs->tail++;
+    __atomic_store_n(&bufs->ring->tail, bufs->tail, __ATOMIC_RELEASE);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringArmAccept
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void uringArmAccept(struct uring *ring, const int listenSocket)
+--                              struct uring *ring: The ring.
+--                              const int listenSocket: The listening socket.
+--
+-- NOTES:
+-- Queues a multishot accept that posts one completion per new connection.
+--------------------------------------------------------------------------------------------------*/
+void uringArmAccept(struct uring *ring, const int listenSocket)
+{
+    struct io_uring_sqe *sqe = uringGetSqe(ring);
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenSocket;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = URING_OP_ACCEPT;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringArmDrain
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void uringArmDrain(struct uring *ring)
+--                              struct uring *ring: The ring.
+--
+-- NOTES:
+-- Queues a single poll of the drain eventfd of the server, which completes once the server drains.
+--------------------------------------------------------------------------------------------------*/
+void uringArmDrain(struct uring *ring)
+{
+    struct io_uring_sqe *sqe = uringGetSqe(ring);
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = drainFd();
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = URING_OP_DRAIN;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringCancelAccept
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void uringCancelAccept(struct uring *ring)
+--                              struct uring *ring: The ring.
+--
+-- NOTES:
+-- Queues the cancel of the multishot accept, which then completes with ECANCELED. Connections it
+-- accepted before are still served.
+--------------------------------------------------------------------------------------------------*/
+void uringCancelAccept(struct uring *ring)
+{
+    struct io_uring_sqe *sqe = uringGetSqe(ring);
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = URING_OP_ACCEPT;
+    sqe->user_data = URING_OP_CANCEL;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringArmRecv
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void uringArmRecv(struct uring *ring, struct uring_conn *conn)
+--                              struct uring *ring: The ring.
+--                              struct uring_conn *conn: The connection to receive on.
+--
+-- NOTES:
+-- Queues a multishot recv on the connection that selects its buffers from the provided buffer ring.
+--------------------------------------------------------------------------------------------------*/
+void uringArmRecv(struct uring *ring, struct uring_conn *conn)
+{
+    struct io_uring_sqe *sqe = uringGetSqe(ring);
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = (__u64)(unsigned long)conn | URING_OP_RECV;
+
+    conn->recvArmed = true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringQueueSends
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Send the queued pieces instead of the received buffers.
+--                          Oct 17, 2026 - Cork every send of the chain but the last.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void uringQueueSends(struct uring *ring, struct uring_conn *conn)
+--                              struct uring *ring: The ring.
+--                              struct uring_conn *conn: The connection to send to.
+--
+-- NOTES:
+-- Queues the pieces waiting on conn as one chain of linked sends. Only one chain is in flight per
+-- connection at a time so the output is always sent in the order it was queued. Every send but the
+-- last of the chain has MSG_MORE so the kernel does not push a segment per piece.
+--------------------------------------------------------------------------------------------------*/
+void uringQueueSends(struct uring *ring, struct uring_conn *conn)
+{
+    struct io_uring_sqe *sqe = NULL;
+
+    for (int i = 0; i < conn->segmentCount && conn->inflight < URING_MAX_CHAIN; i++)
+    {
+        struct uring_segment *segment = &conn->segments[(conn->segmentHead + i) % conn->segmentCap];
+
+        if (sqe != NULL)
+        {
+            sqe->flags |= IOSQE_IO_LINK;
+            sqe->msg_flags |= MSG_MORE;
+        }
+
+        sqe = uringGetSqe(ring);
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = conn->fd;
+        sqe->addr = (__u64)(unsigned long)(segment->data + segment->offset);
+        sqe->len = segment->length - segment->offset;
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        sqe->user_data = (__u64)(unsigned long)conn | URING_OP_SEND;
+
+        conn->inflight++;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringWriteSegments
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Hold back the sends while more output follows.
+--                          Oct 18, 2026 - Send shared output from where it is.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool uringWriteSegments(struct handler_conn *handlerConn, const struct iovec *iov,
+--                                                  const int count, const bool more)
+--                              struct handler_conn *handlerConn: The handler side of the connection.
+--                              const struct iovec *iov: The output the handler queued.
+--                              const int count: The number of pieces in iov.
+--                              const bool more: Whether the handler queues more after this.
+--
+-- RETURNS:                 False if a piece could not be queued, true otherwise.
+--
+-- NOTES:
+-- The write of uring connections. Queues every piece on the connection and starts sending them if
+-- nothing is in flight. A piece that points into a received buffer takes a reference to the buffer
+-- and is sent from it, so is a piece of output the handler shares. Any other piece is copied since
+-- the handler may change it once it returns.
+-- While more follows nothing is sent yet, so the whole output of a callback goes in one chain.
+--------------------------------------------------------------------------------------------------*/
+bool uringWriteSegments(struct handler_conn *handlerConn, const struct iovec *iov, const int count,
+                        const bool more)
+{
+    struct uring_conn *conn = (struct uring_conn *)((char *)handlerConn - offsetof(struct uring_conn, handlerConn));
+    struct uring_buffers *bufs = conn->bufs;
+    char *end = bufs->base + (size_t)bufs->count * bufs->size;
+
+    if (conn->segmentCount + count > conn->segmentCap)
+    {
+        int cap = conn->segmentCap ? conn->segmentCap : 16;
+        struct uring_segment *segments;
+
+        while (cap < conn->segmentCount + count)
+        {
+            cap *= 2;
+        }
+
+        if ((segments = malloc(cap * sizeof(struct uring_segment))) == NULL)
+        {
+            statsAdd(STAT_ERRORS, 1);
+            return false;
+        }
+
+        // unwrap the old queue to the front of the new one
+        for (int i = 0; i < conn->segmentCount; i++)
+        {
+            segments[i] = conn->segments[(conn->segmentHead + i) % conn->segmentCap];
+        }
+
+        free(conn->segments);
+        conn->segments = segments;
+        conn->segmentCap = cap;
+        conn->segmentHead = 0;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        struct uring_segment *segment
+            = &conn->segments[(conn->segmentHead + conn->segmentCount) % conn->segmentCap];
+        char *data = iov[i].iov_base;
+
+        segment->length = iov[i].iov_len;
+        segment->offset = 0;
+        if (data >= bufs->base && data < end)
+        {
+            segment->data = data;
+            segment->bid = (data - bufs->base) / bufs->size;
+            segment->receivedNs = bufs->receivedNs[segment->bid];
+            bufs->refs[segment->bid]++;
+        }
+        else if (handlerShared(data, iov[i].iov_len))
+        {
+            segment->data = data;
+            segment->bid = URING_SEGMENT_SHARED;
+            segment->receivedNs = metricsNow();
+        }
+        else
+        {
+            char *copy;
+
+            if ((copy = malloc(iov[i].iov_len)) == NULL)
+            {
+                statsAdd(STAT_ERRORS, 1);
+                return false;
+            }
+            memcpy(copy, data, iov[i].iov_len);
+            segment->data = copy;
+            segment->bid = URING_SEGMENT_COPY;
+            segment->receivedNs = metricsNow();
+        }
+        conn->segmentCount++;
+    }
+
+    if (conn->inflight == 0 && !more)
+    {
+        uringQueueSends(conn->ring, conn);
+    }
+
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringReleaseSegment
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 18, 2026 - Leave shared pieces alone.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void uringReleaseSegment(struct uring_buffers *bufs, struct uring_segment *segment)
+--                              struct uring_buffers *bufs: The buffers.
+--                              struct uring_segment *segment: A piece that was sent or is given up on.
+--
+-- NOTES:
+-- Frees a copied piece, or drops its reference to its buffer and recycles the buffer with the last.
+-- Shared pieces are left alone.
+--------------------------------------------------------------------------------------------------*/
+void uringReleaseSegment(struct uring_buffers *bufs, struct uring_segment *segment)
+{
+    if (segment->bid == URING_SEGMENT_COPY)
+    {
+        free((char *)segment->data);
+    }
+    else if (segment->bid != URING_SEGMENT_SHARED && --bufs->refs[segment->bid] == 0)
+    {
+        uringBuffersRecycle(bufs, segment->bid);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringFailConn
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void uringFailConn(struct uring_conn *conn)
+--                              struct uring_conn *conn: The connection to give up on.
+--
+-- NOTES:
+-- Shuts the connection down so that its recv ends and its sends fail, after which it is closed.
+--------------------------------------------------------------------------------------------------*/
+void uringFailConn(struct uring_conn *conn)
+{
+    if (!conn->failed)
+    {
+        conn->failed = true;
+        shutdown(conn->fd, SHUT_RDWR);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringRefuseConn
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void uringRefuseConn(struct uring_conn *conn)
+--                              struct uring_conn *conn: The connection the handler gave up.
+--
+-- NOTES:
+-- Shuts down only the reading side, so that the recv ends while the sends of a last answer the
+-- handler queued still go out. The connection is closed once they did.
+--------------------------------------------------------------------------------------------------*/
+void uringRefuseConn(struct uring_conn *conn)
+{
+    if (!conn->refused)
+    {
+        conn->refused = true;
+        shutdown(conn->fd, SHUT_RD);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringHandleRecv
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Pass the buffer to the protocol handler.
+--                          Oct 18, 2026 - Let a connection the handler gave up send its last answer.
+--                          Oct 18, 2026 - Stop reading once answered when draining.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void uringHandleRecv(struct uring *ring, struct uring_buffers *bufs,
+--                                               struct uring_conn *conn, struct io_uring_cqe *cqe,
+--                                               struct uring_conn **starved)
+--                              struct uring *ring: The ring.
+--                              struct uring_buffers *bufs: The buffers.
+--                              struct uring_conn *conn: The connection that received.
+--                              struct io_uring_cqe *cqe: The recv completion.
+--                              struct uring_conn **starved: The list of connections out of buffers.
+--
+-- NOTES:
+-- Logs the received data, stamps its buffer with the time and passes it to the protocol handler. The
+-- buffer is recycled right away unless the handler queued part of it to be sent, and a connection
+-- the handler gives up on stops reading, as does every connection of a draining worker. When the
+-- multishot recv ends, it is rearmed, parked on the
+-- starved list if the buffer ring was empty, or the connection starts closing if the peer hung up.
+--------------------------------------------------------------------------------------------------*/
+void uringHandleRecv(struct uring *ring, struct uring_buffers *bufs, struct uring_conn *conn,
+                     struct io_uring_cqe *cqe, struct uring_conn **starved)
+{
+    if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER))
+    {
+        int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+        logRcv(conn->fd, cqe->res);
+        statsAdd(STAT_BYTES_IN, cqe->res);
+        statsAdd(STAT_MESSAGES_IN, 1);
+
+        bufs->refs[bid] = 0;
+        bufs->receivedNs[bid] = metricsNow();
+        if (!conn->failed && !conn->refused
+            && !handlerData(&conn->handlerConn, bufs->base + (size_t)bid * bufs->size, cqe->res))
+        {
+            uringRefuseConn(conn);
+        }
+
+        // a draining worker lets a connection go once its answer is out
+        if (localDraining)
+        {
+            uringRefuseConn(conn);
+        }
+
+        if (bufs->refs[bid] == 0)
+        {
+            uringBuffersRecycle(bufs, bid);
+        }
+    }
+
+    if (cqe->flags & IORING_CQE_F_MORE)
+    {
+        return;
+    }
+
+    conn->recvArmed = false;
+
+    if (cqe->res == -ENOBUFS)
+    {
+        conn->nextStarved = *starved;
+        *starved = conn;
+    }
+    else if (cqe->res > 0)
+    {
+        uringArmRecv(ring, conn);
+    }
+    else
+    {
+        if (cqe->res < 0)
+        {
+            statsAdd(STAT_ERRORS, 1);
+        }
+
+        conn->closing = true;
+        if (conn->inflight == 0)
+        {
+            uringReleaseConn(bufs, conn);
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringHandleSend
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Send queued pieces and let the handler know once all are out.
+--                          Oct 18, 2026 - Finish sending before closing a connection that did not fail.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void uringHandleSend(struct uring *ring, struct uring_buffers *bufs,
+--                                               struct uring_conn *conn, struct io_uring_cqe *cqe)
+--                              struct uring *ring: The ring.
+--                              struct uring_buffers *bufs: The buffers.
+--                              struct uring_conn *conn: The connection that was written to.
+--                              struct io_uring_cqe *cqe: The send completion.
+--
+-- NOTES:
+-- Completions of a chain arrive in order, so a full send always belongs to the piece at the head of
+-- the queue which is then released and the time since what it answers was received recorded. A
+-- short send keeps the rest of its piece at the head and the remaining links come back cancelled,
+-- they are sent again with the next chain. Any other error shuts the connection down so that its
+-- recv ends and the connection closes. A closing connection that did not fail first sends every
+-- piece it has left. Once every piece is sent the handler may queue more.
+--------------------------------------------------------------------------------------------------*/
+void uringHandleSend(struct uring *ring, struct uring_buffers *bufs, struct uring_conn *conn,
+                     struct io_uring_cqe *cqe)
+{
+    conn->inflight--;
+
+    if (cqe->res > 0 && conn->segmentCount > 0)
+    {
+        struct uring_segment *segment = &conn->segments[conn->segmentHead];
+
+        logSnd(conn->fd, cqe->res);
+        statsAdd(STAT_BYTES_OUT, cqe->res);
+        statsAdd(STAT_MESSAGES_OUT, 1);
+
+        if (segment->offset + cqe->res < segment->length)
+        {
+            segment->offset += cqe->res;
+        }
+        else
+        {
+            metricsRecord(METRIC_SERVICE, metricsNow() - segment->receivedNs);
+            uringReleaseSegment(bufs, segment);
+            conn->segmentHead = (conn->segmentHead + 1) % conn->segmentCap;
+            conn->segmentCount--;
+        }
+    }
+    else if (cqe->res < 0 && cqe->res != -ECANCELED && !conn->failed)
+    {
+        statsAdd(STAT_ERRORS, 1);
+        uringFailConn(conn);
+    }
+
+    if (conn->inflight > 0)
+    {
+        return;
+    }
+
+    if (conn->closing && (conn->failed || conn->segmentCount == 0))
+    {
+        uringReleaseConn(bufs, conn);
+    }
+    else if (conn->failed)
+    {
+        while (conn->segmentCount > 0)
+        {
+            uringReleaseSegment(bufs, &conn->segments[conn->segmentHead]);
+            conn->segmentHead = (conn->segmentHead + 1) % conn->segmentCap;
+            conn->segmentCount--;
+        }
+    }
+    else if (conn->segmentCount > 0)
+    {
+        uringQueueSends(ring, conn);
+    }
+    else if (!conn->refused && !handlerWritable(&conn->handlerConn))
+    {
+        uringRefuseConn(conn);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringReleaseConn
+--
+-- DATE:                    Oct 17, 2026
+--
+-- REVISIONS:               Oct 17, 2026 - Release queued pieces and let the handler free its state.
+--                          Oct 18, 2026 - Unlink from the connections of the worker.
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void uringReleaseConn(struct uring_buffers *bufs, struct uring_conn *conn)
+--                              struct uring_buffers *bufs: The buffers.
+--                              struct uring_conn *conn: The connection to release.
+--
+-- NOTES:
+-- Releases any pieces still queued on the connection, lets the handler free its state, unlinks it
+-- from the connections of the worker, closes the connection and frees it. Must only be called once
+-- the recv has ended and no sends are in flight.
+--------------------------------------------------------------------------------------------------*/
+void uringReleaseConn(struct uring_buffers *bufs, struct uring_conn *conn)
+{
+    for (int i = 0; i < conn->segmentCount; i++)
+    {
+        uringReleaseSegment(bufs, &conn->segments[(conn->segmentHead + i) % conn->segmentCap]);
+    }
+
+    handlerClose(&conn->handlerConn);
+    free(conn->segments);
+
+    if (conn->prev != NULL)
+    {
+        conn->prev->next = conn->next;
+    }
+    else
+    {
+        localConns = conn->next;
+    }
+    if (conn->next != NULL)
+    {
+        conn->next->prev = conn->prev;
+    }
+    localCount--;
+
+    statsAdd(STAT_CLOSES, 1);
+    close(conn->fd);
+    free(conn);
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringLinkConn
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               void uringLinkConn(struct uring_conn *conn)
+--                              struct uring_conn *conn: A connection the calling worker accepted.
+--
+-- NOTES:
+-- Adds the connection to the connections of the calling worker, which it drains.
+--------------------------------------------------------------------------------------------------*/
+void uringLinkConn(struct uring_conn *conn)
+{
+    conn->prev = NULL;
+    conn->next = localConns;
+    if (localConns != NULL)
+    {
+        localConns->prev = conn;
+    }
+    localConns = conn;
+    localCount++;
+}
+
+/*--------------------------------------------------------------------------------------------------
+-- FUNCTION:                uringDrainConns
+--
+-- DATE:                    Oct 18, 2026
+--
+-- REVISIONS:               N/A
+--
+-- DESIGNER:                Benny Wang
+--
+-- PROGRAMMER:              Benny Wang
+--
+-- INTERFACE:               bool uringDrainConns(const uint64_t start, const size_t total, const int timeout)
+--                              const uint64_t start: When the worker started to drain, from metricsNow.
+--                              const size_t total: The connections it had then.
+--                              const int timeout: Seconds the drain may take.
+--
+-- RETURNS:                 True once the timeout has passed, false before.
+--
+-- NOTES:
+-- The uring side of drainConnections in epoll_svr.c. Shuts the reading side of idle connections of
+-- the calling worker down so that the share still open falls evenly from all of them to none over the
+-- timeout, and they close once their recv ends. Once the timeout has passed every connection is shut
+-- down for good, its output sent or not, and closes once its recv and sends have completed.
+--------------------------------------------------------------------------------------------------*/
+bool uringDrainConns(const uint64_t start, const size_t total, const int timeout)
+{
+    uint64_t elapsed = metricsNow() - start;
+    uint64_t span = (uint64_t)timeout * 1000000000;
+    size_t open = 0;
+    size_t keep;
+
+    if (elapsed >= span)
+    {
+        for (struct uring_conn *conn = localConns; conn != NULL; conn = conn->next)
+        {
+            uringFailConn(conn);
+        }
+        return true;
+    }
+
+    for (struct uring_conn *conn = localConns; conn != NULL; conn = conn->next)
+    {
+        if (!conn->refused && !conn->closing && !conn->failed)
+        {
+            open++;
+        }
+    }
+
+    keep = total - total * elapsed / span;
+    for (struct uring_conn *conn = localConns; conn != NULL && open > keep; conn = conn->next)
+    {
+        if (!conn->refused && !conn->closing && !conn->failed && conn->segmentCount == 0 && conn->inflight == 0)
+        {
+            uringRefuseConn(conn);
+            open--;
+        }
+    }
+
+    return false;
+}
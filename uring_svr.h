@@ -0,0 +1,133 @@
+#ifndef URING_SVR_H
+#define URING_SVR_H
+
+#include <linux/io_uring.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "handler.h"
+
+struct uring
+{
+    int fd;
+
+    // submission queue
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    struct io_uring_sqe *sqes;
+    unsigned sqEntries;
+    unsigned sqLocalTail;
+    unsigned toSubmit;
+
+    // completion queue
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_cqe *cqes;
+
+    void *sqRingPtr;
+    size_t sqRingSize;
+    void *cqRingPtr;
+    size_t cqRingSize;
+    size_t sqesSize;
+};
+
+struct uring_buffers
+{
+    struct io_uring_buf_ring *ring;
+    size_t ringSize;
+    char *base;
+    int count;
+    int size;
+    unsigned short tail;
+
+    // per buffer, how many pieces of output still point into it and when it was received
+    int *refs;
+    uint64_t *receivedNs;
+};
+
+// the bid of a piece of output that is a copy of its own, and of one the handler shares
+#define URING_SEGMENT_COPY -1
+#define URING_SEGMENT_SHARED -2
+
+// a piece of output waiting to be sent
+struct uring_segment
+{
+    const char *data;
+    int length;
+    // how much of it was sent already
+    int offset;
+    // the received buffer it points into, or one of the URING_SEGMENT_ values
+    int bid;
+    uint64_t receivedNs;
+};
+
+struct uring_conn
+{
+    int fd;
+    int inflight;
+    bool recvArmed;
+    bool closing;
+    bool failed;
+    // the handler gave the connection up, what it queued is still sent
+    bool refused;
+    // the output waiting to be sent, a ring of segmentCap pieces
+    struct uring_segment *segments;
+    int segmentCap;
+    int segmentHead;
+    int segmentCount;
+    struct uring_conn *nextStarved;
+    // the connections of the worker
+    struct uring_conn *next;
+    struct uring_conn *prev;
+    // what the protocol handler sees of the connection
+    struct handler_conn handlerConn;
+    struct uring *ring;
+    struct uring_buffers *bufs;
+};
+
+struct uring_worker_arg
+{
+    int cpu;
+    int listenSocket;
+    int bufferLength;
+    int drainTimeout;
+    const struct protocol_handler *handler;
+};
+
+void runUring(const int listenSocket, const struct server_config *config);
+
+void *uringWorker(void *args);
+
+bool uringInit(struct uring *ring, const unsigned entries);
+void uringDestroy(struct uring *ring);
+struct io_uring_sqe *uringGetSqe(struct uring *ring);
+int uringSubmitAndWait(struct uring *ring);
+
+bool uringBuffersInit(struct uring *ring, struct uring_buffers *bufs, const int count, const int size);
+void uringBuffersDestroy(struct uring *ring, struct uring_buffers *bufs);
+void uringBuffersRecycle(struct uring_buffers *bufs, const int bid);
+
+void uringArmAccept(struct uring *ring, const int listenSocket);
+void uringArmDrain(struct uring *ring);
+void uringCancelAccept(struct uring *ring);
+void uringArmRecv(struct uring *ring, struct uring_conn *conn);
+void uringQueueSends(struct uring *ring, struct uring_conn *conn);
+bool uringWriteSegments(struct handler_conn *handlerConn, const struct iovec *iov, const int count,
+                        const bool more);
+void uringReleaseSegment(struct uring_buffers *bufs, struct uring_segment *segment);
+void uringFailConn(struct uring_conn *conn);
+void uringRefuseConn(struct uring_conn *conn);
+void uringHandleRecv(struct uring *ring, struct uring_buffers *bufs, struct uring_conn *conn,
+                     struct io_uring_cqe *cqe, struct uring_conn **starved);
+void uringHandleSend(struct uring *ring, struct uring_buffers *bufs, struct uring_conn *conn,
+                     struct io_uring_cqe *cqe);
+void uringReleaseConn(struct uring_buffers *bufs, struct uring_conn *conn);
+void uringLinkConn(struct uring_conn *conn);
+bool uringDrainConns(const uint64_t start, const size_t total, const int timeout);
+
+#endif // URING_SVR_H